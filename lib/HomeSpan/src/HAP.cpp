@@ -40,6 +40,8 @@ void HAPClient::init()
 {
     size_t len;  // not used but required to read blobs from NVS
 
+    HKDF::init();  // pre-compute HMAC-SHA-512 states for HAP's fixed HKDF salts
+
     if (strlen(homeSpan.spanOTA.otaPwd) == 0) {                      // OTA password has not been specified in sketch
         if (!nvs_get_str(homeSpan.otaNVS, "OTADATA", NULL, &len)) {  // if found OTA data in NVS...
             nvs_get_str(homeSpan.otaNVS, "OTADATA", homeSpan.spanOTA.otaPwd, &len);  // ...retrieve data.
@@ -122,8 +124,61 @@ void HAPClient::init()
 
 //////////////////////////////////////
 
+void HAPClient::preGenerateKeys()
+{
+    if (nCurveKeys < MAX_CURVE_KEYS) {  // top off pool of Curve25519 keypairs used in pair-verify M1
+        crypto_box_keypair(curveKeys[nCurveKeys].publicKey, curveKeys[nCurveKeys].secretKey);
+        nCurveKeys++;
+        return;  // generate at most one key per call so poll() remains responsive
+    }
+
+    if (srpKeyBusy || nAdminControllers() ||
+        pairStatus != pairState_M1)  // SRP key is only needed when unpaired, and must not change once pair-setup starts
+        return;
+
+    if (srpKeyReady) {
+        if (srpNextVersion == srpKeyVersion)  // key is ready and still matches the current verification data
+            return;
+        srpKeyReady = false;  // otherwise setPairingCode() was called after the key was generated, so replace it
+    }
+
+    // The 3072-bit modular exponentiation in createKeys() takes several hundred milliseconds, which would stall
+    // poll() if run here.  It is instead run in a separate task at the same priority as the Arduino loop() (a lower
+    // priority would never run, since loop() does not block), so it is time-sliced with poll() rather than blocking it
+
+    if (srpNext == NULL)
+        srpNext = new SRP6A;
+
+    srpNextVersion = srpKeyVersion;
+    srpKeyBusy = true;
+    if (xTaskCreateUniversal(srpKeyTask, "srpKeyTaskHandle", 8192, srpNext, 1, NULL, 0) != pdPASS)
+        srpKeyBusy = false;
+}
+
+//////////////////////////////////////
+
+void HAPClient::srpKeyTask(void *args)
+{
+    SRP6A *srpNew = (SRP6A *)args;
+
+    TempBuffer<Verification> verifyData;  // retrieve verification data (should already be stored in NVS)
+    size_t len = verifyData.len();
+
+    if (!nvs_get_blob(homeSpan.srpNVS, "VERIFYDATA", verifyData, &len)) {
+        srpNew->createKeys(verifyData);  // generate b and compute B = k*v + g^b %N ahead of pair-setup M1
+        srpKeyReady = true;
+    }
+
+    srpKeyBusy = false;  // srpNext now belongs to poll() again
+    vTaskDelete(NULL);
+}
+
+//////////////////////////////////////
+
 void HAPClient::processRequest()
 {
+    HS_TRACE_SCOPE("request");
+
     int nBytes, messageSize;
 
     messageSize = client.available();
@@ -134,7 +189,8 @@ void HAPClient::processRequest()
         return;
     }
 
-    TempBuffer<uint8_t> httpBuf(messageSize + 1);  // leave room for null character added below
+    uint8_t *httpBuf = (uint8_t *)homeSpan.requestArena.alloc(messageSize + 1);  // leave room for null character
+                                                                                   // added below
 
     if (cPair) {  // expecting encrypted message
         LOG2("<<<< #### ");
@@ -168,10 +224,10 @@ void HAPClient::processRequest()
 
     httpBuf[nBytes] = '\0';  // add null character to enable string functions
 
-    char *body = (char *)httpBuf.get();  // char pointer to start of HTTP Body
+    char *body = (char *)httpBuf;  // char pointer to start of HTTP Body
     char *p;                             // char pointer used for searches
 
-    if (!(p = strstr((char *)httpBuf.get(), "\r\n\r\n"))) {
+    if (!(p = strstr((char *)httpBuf, "\r\n\r\n"))) {
         badRequestError();
         LOG0("\n*** ERROR:  Malformed HTTP request (can't find blank line indicating end of BODY)\n\n");
         return;
@@ -194,6 +250,8 @@ void HAPClient::processRequest()
     LOG2("%s\n", body);
     LOG2("\n------------ END BODY! ------------\n");
 
+    SpanMetrics::route = SpanMetrics::routeOf(body);
+
     if (!strncmp(body, "POST ", 5)) {  // this is a POST request
 
         if (cLen == 0) {
@@ -262,6 +320,23 @@ void HAPClient::processRequest()
                           homeSpan.webLog.statusURL.length()))  // GET STATUS - AN OPTIONAL, NON-HAP-R2 FEATURE
             getStatusURL(this, NULL, NULL);
 
+        else if (homeSpan.webLog.isEnabled &&
+                 !strncmp(body, homeSpan.webLog.metricsURL.c_str(),
+                          homeSpan.webLog.metricsURL.length()))  // GET METRICS - AN OPTIONAL, NON-HAP-R2 FEATURE
+            getMetricsURL();
+
+        else if (homeSpan.webLog.isEnabled && !cPair &&  // chunked log is only streamed over unencrypted connections
+                 !strncmp(body, homeSpan.webLog.logURL.c_str(), homeSpan.webLog.logURL.length()) &&
+                 strchr(" ?", body[homeSpan.webLog.logURL.length()]))  // GET LOG - AN OPTIONAL, NON-HAP-R2 FEATURE
+            getLogURL(body + homeSpan.webLog.logURL.length());
+
+#ifdef HS_TRACE
+        else if (homeSpan.webLog.isEnabled &&
+                 !strncmp(body, homeSpan.webLog.traceURL.c_str(),
+                          homeSpan.webLog.traceURL.length()))  // GET TRACE - AN OPTIONAL, NON-HAP-R2 FEATURE
+            getTraceURL();
+#endif
+
         else {
             notFoundError();
             LOG0("\n*** ERROR:  Bad GET request - URL not found\n\n");
@@ -334,13 +409,17 @@ int HAPClient::unauthorizedError()
 
 int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
 {
-    static SRP6A *srp = NULL;  // must persist across multiple calls to postPairSetupURL
-
-    HAPTLV iosTLV;
+    HAPTLVView iosTLV;
+    HAPTLVView iosSubTLV;
     HAPTLV responseTLV;
     HAPTLV subTLV;
 
-    iosTLV.unpack(content, len);
+    if (iosTLV.unpack(content, len) == -1) {  // parse TLV records in place (content is not copied)
+        LOG0("\n*** ERROR: Malformed TLV data\n\n");
+        badRequestError();  // return with 400 error, which closes connection
+        return (0);
+    }
+
     if (homeSpan.getLogLevel() > 1)
         iosTLV.print();
     LOG2("------------ END TLVS! ------------\n");
@@ -401,18 +480,24 @@ int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
             auto itPublicKey =
                 responseTLV.add(kTLVType_PublicKey, 384, NULL);  // create blank PublicKey TLV with space for 384 bytes
 
-            if (srp ==
-                NULL)  // create instance of SRP (if not already created) to persist until Pairing-Setup M5 completes
-                srp = new SRP6A;
-
             TempBuffer<Verification> verifyData;  // retrieve verification data (should already be stored in NVS)
             size_t len = verifyData.len();
             nvs_get_blob(homeSpan.srpNVS, "VERIFYDATA", verifyData, &len);
 
             responseTLV.add(kTLVType_Salt, 16, verifyData.get()->salt);  // write Salt from verification data into TLV
 
-            srp->createPublicKey(verifyData, *itPublicKey);  // create accessory Public Key from stored verification
-                                                             // data and write result into PublicKey TLV
+            if (srpKeyReady && srpNextVersion == srpKeyVersion) {  // use key pre-generated by srpKeyTask
+                delete srp;
+                srp = srpNext;  // srp persists until Pairing-Setup M5 completes
+                srpNext = NULL;
+                srpKeyReady = false;  // a pre-generated key is only ever sent once
+            } else {                  // no pre-generated key is available, so generate b and compute B now
+                if (srp == NULL)
+                    srp = new SRP6A;
+                srp->createKeys(verifyData);
+            }
+
+            srp->writePublicKey(*itPublicKey);  // write accessory Public Key into PublicKey TLV
 
             tlvRespond(responseTLV);    // send response to client
             pairStatus = pairState_M3;  // set next expected pair-state request from client
@@ -485,39 +570,49 @@ int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
             // creating iosDeviceX. The iosDeviceX HKDF calculations are separate and will be performed further below
             // with the SALT and INFO as specified in the HAP docs.
 
-            HKDF::create(temp.sessionKey, srp->K, 64, "Pair-Setup-Encrypt-Salt",
+            uint8_t sessionKey[32];  // Session Key used only in this step
+
+            HKDF::create(sessionKey, srp->K, 64, "Pair-Setup-Encrypt-Salt",
                          "Pair-Setup-Encrypt-Info");  // create SessionKey
 
             LOG2("------- DECRYPTING SUB-TLVS -------\n");
 
-            // use SessionKey to decrypt encryptedData TLV with padded nonce="PS-Msg05"
+            // use SessionKey to decrypt encryptedData TLV with padded nonce="PS-Msg05" (decrypted in place)
 
-            TempBuffer<uint8_t> decrypted(
-                itEncryptedData->getLen() -
-                crypto_aead_chacha20poly1305_IETF_ABYTES);  // temporary storage for decrypted data
+            unsigned long long decryptedLen;
 
             if (crypto_aead_chacha20poly1305_ietf_decrypt(
-                    decrypted, NULL, NULL, *itEncryptedData, itEncryptedData->getLen(), NULL, 0,
-                    (unsigned char *)"\x00\x00\x00\x00PS-Msg05", temp.sessionKey) == -1) {
+                    *itEncryptedData, &decryptedLen, NULL, *itEncryptedData, itEncryptedData->getLen(), NULL, 0,
+                    (unsigned char *)"\x00\x00\x00\x00PS-Msg05", sessionKey) == -1) {
                 LOG0("\n*** ERROR: Exchange-Request Authentication Failed\n\n");
                 responseTLV.add(kTLVType_Error, tagError_Authentication);  // set Error=Authentication
                 tlvRespond(responseTLV);                                   // send response to client
                 pairStatus = pairState_M1;                                 // reset pairStatus to first step of unpaired
+                sodium_memzero(sessionKey, sizeof(sessionKey));
+                return (0);
+            }
+
+            if (iosSubTLV.unpack(*itEncryptedData, decryptedLen) == -1) {  // parse decrypted TLV records in place
+                LOG0("\n*** ERROR: Malformed decrypted TLV data\n\n");
+                responseTLV.add(kTLVType_Error, tagError_Unknown);  // set Error=Unknown
+                tlvRespond(responseTLV);                            // send response to client
+                pairStatus = pairState_M1;                          // reset pairStatus to first step of unpaired
+                sodium_memzero(sessionKey, sizeof(sessionKey));
                 return (0);
             }
 
-            subTLV.unpack(decrypted, decrypted.len());  // unpack TLV
             if (homeSpan.getLogLevel() > 1)
-                subTLV.print();  // print decrypted TLV data
+                iosSubTLV.print();  // print decrypted TLV data
 
             LOG2("---------- END SUB-TLVS! ----------\n");
 
-            auto itIdentifier = subTLV.find(kTLVType_Identifier);
-            auto itSignature = subTLV.find(kTLVType_Signature);
-            auto itPublicKey = subTLV.find(kTLVType_PublicKey);
+            auto itIdentifier = iosSubTLV.find(kTLVType_Identifier);
+            auto itSignature = iosSubTLV.find(kTLVType_Signature);
+            auto itPublicKey = iosSubTLV.find(kTLVType_PublicKey);
 
-            if (subTLV.len(itIdentifier) != hap_controller_IDBYTES || subTLV.len(itSignature) != crypto_sign_BYTES ||
-                subTLV.len(itPublicKey) != crypto_sign_PUBLICKEYBYTES) {
+            if (iosSubTLV.len(itIdentifier) != hap_controller_IDBYTES ||
+                iosSubTLV.len(itSignature) != crypto_sign_BYTES ||
+                iosSubTLV.len(itPublicKey) != crypto_sign_PUBLICKEYBYTES) {
                 LOG0(
                     "\n*** ERROR: One or more of required 'Identifier,' 'PublicKey,' and 'Signature' TLV records for "
                     "this step is bad or missing\n\n");
@@ -526,6 +621,7 @@ int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
                     tagError_Unknown);  // set Error=Unknown (there is no specific error type for missing/bad TLV data)
                 tlvRespond(responseTLV);    // send response to client
                 pairStatus = pairState_M1;  // reset pairStatus to first step of unpaired
+                sodium_memzero(sessionKey, sizeof(sessionKey));
                 return (0);
             };
 
@@ -552,6 +648,7 @@ int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
                 responseTLV.add(kTLVType_Error, tagError_Authentication);  // set Error=Authentication
                 tlvRespond(responseTLV);                                   // send response to client
                 pairStatus = pairState_M1;                                 // reset pairStatus to first step of unpaired
+                sodium_memzero(sessionKey, sizeof(sessionKey));
                 return (0);
             }
 
@@ -570,13 +667,11 @@ int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
             TempBuffer<uint8_t> accessoryInfo(accessoryX, accessoryX.len(), accessory.ID, hap_accessory_IDBYTES,
                                               accessory.LTPK, crypto_sign_PUBLICKEYBYTES, NULL);
 
-            subTLV.clear();  // clear existing SUBTLV records
-
-            itSignature =
+            auto itAccSignature =
                 subTLV.add(kTLVType_Signature, 64, NULL);  // create blank Signature TLV with space for 64 bytes
 
             crypto_sign_detached(
-                *itSignature, NULL, accessoryInfo, accessoryInfo.len(),
+                *itAccSignature, NULL, accessoryInfo, accessoryInfo.len(),
                 accessory
                     .LTSK);  // produce signature of accessoryInfo using AccessoryLTSK (Ed25519 long-term secret key)
 
@@ -590,18 +685,21 @@ int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
             if (homeSpan.getLogLevel() > 1)
                 subTLV.print();
 
-            TempBuffer<uint8_t> subPack(subTLV.pack_size());  // create sub-TLV by packing Identifier, PublicKey and
-                                                              // Signature TLV records together
-            subTLV.pack(subPack);
+            size_t subPackLen = subTLV.pack_size();
 
-            // Encrypt the subTLV data using the same SRP Session Key as above with ChaCha20-Poly1305
-
-            itEncryptedData =
-                responseTLV.add(kTLVType_EncryptedData, subPack.len() + crypto_aead_chacha20poly1305_IETF_ABYTES,
+            auto itAccEncryptedData =
+                responseTLV.add(kTLVType_EncryptedData, subPackLen + crypto_aead_chacha20poly1305_IETF_ABYTES,
                                 NULL);  // create blank EncryptedData TLV with space for subTLV + Authentication Tag
 
-            crypto_aead_chacha20poly1305_ietf_encrypt(*itEncryptedData, NULL, subPack, subPack.len(), NULL, 0, NULL,
-                                                      (unsigned char *)"\x00\x00\x00\x00PS-Msg06", temp.sessionKey);
+            subTLV.pack(*itAccEncryptedData);  // pack Identifier, PublicKey and Signature TLV records directly into
+                                               // EncryptedData TLV
+
+            // Encrypt the subTLV data (in place) using the same SRP Session Key as above with ChaCha20-Poly1305
+
+            crypto_aead_chacha20poly1305_ietf_encrypt(*itAccEncryptedData, NULL, *itAccEncryptedData, subPackLen, NULL,
+                                                      0, NULL, (unsigned char *)"\x00\x00\x00\x00PS-Msg06",
+                                                      sessionKey);
+            sodium_memzero(sessionKey, sizeof(sessionKey));
 
             LOG2("---------- END SUB-TLVS! ----------\n");
 
@@ -633,11 +731,17 @@ int HAPClient::postPairSetupURL(uint8_t *content, size_t len)
 
 int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
 {
-    HAPTLV iosTLV;
+    HAPTLVView iosTLV;
+    HAPTLVView iosSubTLV;
     HAPTLV responseTLV;
     HAPTLV subTLV;
 
-    iosTLV.unpack(content, len);
+    if (iosTLV.unpack(content, len) == -1) {  // parse TLV records in place (content is not copied)
+        LOG0("\n*** ERROR: Malformed TLV data\n\n");
+        badRequestError();  // return with 400 error, which closes connection
+        return (0);
+    }
+
     if (homeSpan.getLogLevel() > 1)
         iosTLV.print();
     LOG2("------------ END TLVS! ------------\n");
@@ -683,18 +787,44 @@ int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
                 return (0);
             }
 
+            auto itMethod = iosTLV.find(kTLVType_Method);
+            auto itSessionID = iosTLV.find(kTLVType_SessionID);
+            auto itResumeData = iosTLV.find(kTLVType_EncryptedData);
+
+            if (iosTLV.len(itMethod) == 1 && itMethod->getVal() == pairMethod_Resume &&
+                iosTLV.len(itSessionID) == hap_session_IDBYTES && iosTLV.len(itResumeData) > 0 &&
+                pairResume(*itPublicKey, *itSessionID, *itResumeData, itResumeData->getLen()))
+                return (1);  // session resumed; otherwise fall through to a full pair-verify (HAP requirement)
+
+            if (!acquireTemp()) {  // pool is busy and heap is exhausted
+                LOG0("\n*** ERROR: Can't allocate memory for Pair-Verify\n\n");
+                responseTLV.add(kTLVType_State, pairState_M2);   // set State=<M2>
+                responseTLV.add(kTLVType_Error, tagError_Busy);  // set Error=Busy
+                tlvRespond(responseTLV);                         // send response to client
+                return (0);
+            }
+
             TempBuffer<uint8_t> secretCurveKey(crypto_box_SECRETKEYBYTES);  // temporary space - used only in this block
-            crypto_box_keypair(temp.publicCurveKey,
-                               secretCurveKey);  // generate Accessory's random Curve25519 Public/Secret Key Pair
 
-            memcpy(temp.iosCurveKey, *itPublicKey,
+            if (nCurveKeys > 0) {  // use a pre-generated Curve25519 Public/Secret Key Pair if one is available
+                nCurveKeys--;
+                memcpy(temp->publicCurveKey, curveKeys[nCurveKeys].publicKey, crypto_box_PUBLICKEYBYTES);
+                memcpy(secretCurveKey, curveKeys[nCurveKeys].secretKey, crypto_box_SECRETKEYBYTES);
+                sodium_memzero(&curveKeys[nCurveKeys], sizeof(curveKeyPair_t));  // each keypair is only used once
+            } else {
+                crypto_box_keypair(temp->publicCurveKey,
+                                   secretCurveKey);  // generate Accessory's random Curve25519 Public/Secret Key Pair
+            }
+
+            memcpy(temp->iosCurveKey, *itPublicKey,
                    crypto_box_PUBLICKEYBYTES);  // save Controller's Curve25519 Public Key
 
             // concatenate Accessory's Curve25519 Public Key, Accessory's Pairing ID, and Controller's Curve25519 Public
             // Key into accessoryInfo
 
-            TempBuffer<uint8_t> accessoryInfo(temp.publicCurveKey, crypto_box_PUBLICKEYBYTES, accessory.ID,
-                                              hap_accessory_IDBYTES, temp.iosCurveKey, crypto_box_PUBLICKEYBYTES, NULL);
+            TempBuffer<uint8_t> accessoryInfo(temp->publicCurveKey, crypto_box_PUBLICKEYBYTES, accessory.ID,
+                                              hap_accessory_IDBYTES, temp->iosCurveKey, crypto_box_PUBLICKEYBYTES,
+                                              NULL);
 
             subTLV.add(kTLVType_Identifier, hap_accessory_IDBYTES,
                        accessory.ID);  // set Identifier subTLV record as Accessory's Pairing ID
@@ -708,38 +838,51 @@ int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
             if (homeSpan.getLogLevel() > 1)
                 subTLV.print();
 
-            TempBuffer<uint8_t> subPack(
-                subTLV.pack_size());  // create sub-TLV by packing Identifier and Signature TLV records together
-            subTLV.pack(subPack);
+            size_t subPackLen = subTLV.pack_size();
 
             crypto_scalarmult_curve25519(
-                temp.sharedCurveKey, secretCurveKey,
-                temp.iosCurveKey);  // generate Shared-Secret Curve25519 Key from Accessory's Curve25519 Secret Key and
+                temp->sharedCurveKey, secretCurveKey,
+                temp->iosCurveKey);  // generate Shared-Secret Curve25519 Key from Accessory's Curve25519 Secret Key and
                                     // Controller's Curve25519 Public Key
 
-            HKDF::create(temp.sessionKey, temp.sharedCurveKey, crypto_box_PUBLICKEYBYTES, "Pair-Verify-Encrypt-Salt",
+            HKDF::create(temp->sessionKey, temp->sharedCurveKey, crypto_box_PUBLICKEYBYTES, "Pair-Verify-Encrypt-Salt",
                          "Pair-Verify-Encrypt-Info");  // create Session Curve25519 Key from Shared-Secret Curve25519
                                                        // Key using HKDF-SHA-512
 
             auto itEncryptedData =
-                responseTLV.add(kTLVType_EncryptedData, subPack.len() + crypto_aead_chacha20poly1305_IETF_ABYTES,
+                responseTLV.add(kTLVType_EncryptedData, subPackLen + crypto_aead_chacha20poly1305_IETF_ABYTES,
                                 NULL);  // create blank EncryptedData subTLV
+            subTLV.pack(*itEncryptedData);  // pack Identifier and Signature TLV records directly into EncryptedData TLV
             crypto_aead_chacha20poly1305_ietf_encrypt(
-                *itEncryptedData, NULL, subPack, subPack.len(), NULL, 0, NULL,
+                *itEncryptedData, NULL, *itEncryptedData, subPackLen, NULL, 0, NULL,
                 (unsigned char *)"\x00\x00\x00\x00PV-Msg02",
-                temp.sessionKey);  // encrypt data with Session Curve25519 Key and padded nonce="PV-Msg02"
+                temp->sessionKey);  // encrypt data with Session Curve25519 Key and padded nonce="PV-Msg02"
 
             LOG2("---------- END SUB-TLVS! ----------\n");
 
             responseTLV.add(kTLVType_State, pairState_M2);  // set State=<M2>
             responseTLV.add(kTLVType_PublicKey, crypto_box_PUBLICKEYBYTES,
-                            temp.publicCurveKey);  // set PublicKey to Accessory's Curve25519 Public Key
+                            temp->publicCurveKey);  // set PublicKey to Accessory's Curve25519 Public Key
 
             tlvRespond(responseTLV);  // send response to client
         } break;
 
         case pairState_M3: {  // 'Verify Finish Request'
 
+            struct releaseOnExit
+            {
+                HAPClient *hc;
+                ~releaseOnExit() { hc->releaseTemp(); }
+            } release{this};  // pair-verify temporaries are wiped and returned to pool however this step ends
+
+            if (!temp) {  // no pair-verify in progress for this connection (or it was reclaimed after timing out)
+                LOG0("\n*** ERROR: Pair-Verify <M3> received without a preceding <M1>\n\n");
+                responseTLV.add(kTLVType_State, pairState_M4);             // set State=<M4>
+                responseTLV.add(kTLVType_Error, tagError_Authentication);  // set Error=Authentication
+                tlvRespond(responseTLV);                                   // send response to client
+                return (0);
+            }
+
             auto itEncryptedData = iosTLV.find(kTLVType_EncryptedData);
 
             if (iosTLV.len(itEncryptedData) <= 0) {
@@ -755,15 +898,13 @@ int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
             LOG2("------- DECRYPTING SUB-TLVS -------\n");
 
             // use Session Curve25519 Key (from previous step) to decrypt encrypytedData TLV with padded
-            // nonce="PV-Msg03"
+            // nonce="PV-Msg03" (decrypted in place)
 
-            TempBuffer<uint8_t> decrypted(
-                (*itEncryptedData).getLen() -
-                crypto_aead_chacha20poly1305_IETF_ABYTES);  // temporary storage for decrypted data
+            unsigned long long decryptedLen;
 
             if (crypto_aead_chacha20poly1305_ietf_decrypt(
-                    decrypted, NULL, NULL, *itEncryptedData, itEncryptedData->getLen(), NULL, 0,
-                    (unsigned char *)"\x00\x00\x00\x00PV-Msg03", temp.sessionKey) == -1) {
+                    *itEncryptedData, &decryptedLen, NULL, *itEncryptedData, itEncryptedData->getLen(), NULL, 0,
+                    (unsigned char *)"\x00\x00\x00\x00PV-Msg03", temp->sessionKey) == -1) {
                 LOG0("\n*** ERROR: Verify Authentication Failed\n\n");
                 responseTLV.add(kTLVType_State, pairState_M4);             // set State=<M4>
                 responseTLV.add(kTLVType_Error, tagError_Authentication);  // set Error=Authentication
@@ -771,16 +912,24 @@ int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
                 return (0);
             }
 
-            subTLV.unpack(decrypted, decrypted.len());  // unpack TLV
+            if (iosSubTLV.unpack(*itEncryptedData, decryptedLen) == -1) {  // parse decrypted TLV records in place
+                LOG0("\n*** ERROR: Malformed decrypted TLV data\n\n");
+                responseTLV.add(kTLVType_State, pairState_M4);      // set State=<M4>
+                responseTLV.add(kTLVType_Error, tagError_Unknown);  // set Error=Unknown
+                tlvRespond(responseTLV);                            // send response to client
+                return (0);
+            }
+
             if (homeSpan.getLogLevel() > 1)
-                subTLV.print();  // print decrypted TLV data
+                iosSubTLV.print();  // print decrypted TLV data
 
             LOG2("---------- END SUB-TLVS! ----------\n");
 
-            auto itIdentifier = subTLV.find(kTLVType_Identifier);
-            auto itSignature = subTLV.find(kTLVType_Signature);
+            auto itIdentifier = iosSubTLV.find(kTLVType_Identifier);
+            auto itSignature = iosSubTLV.find(kTLVType_Signature);
 
-            if (subTLV.len(itIdentifier) != hap_controller_IDBYTES || subTLV.len(itSignature) != crypto_sign_BYTES) {
+            if (iosSubTLV.len(itIdentifier) != hap_controller_IDBYTES ||
+                iosSubTLV.len(itSignature) != crypto_sign_BYTES) {
                 LOG0(
                     "\n*** ERROR: One or more of required 'Identifier,' and 'Signature' TLV records for this step is "
                     "bad or missing\n\n");
@@ -811,8 +960,8 @@ int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
             // concatenate Controller's Curve25519 Public Key (from previous step), Controller's Pairing ID, and
             // Accessory's Curve25519 Public Key (from previous step) into iosDeviceInfo
 
-            TempBuffer<uint8_t> iosDeviceInfo(temp.iosCurveKey, crypto_box_PUBLICKEYBYTES, tPair->ID,
-                                              hap_controller_IDBYTES, temp.publicCurveKey, crypto_box_PUBLICKEYBYTES,
+            TempBuffer<uint8_t> iosDeviceInfo(temp->iosCurveKey, crypto_box_PUBLICKEYBYTES, tPair->ID,
+                                              hap_controller_IDBYTES, temp->publicCurveKey, crypto_box_PUBLICKEYBYTES,
                                               NULL);
 
             if (crypto_sign_verify_detached(*itSignature, iosDeviceInfo, iosDeviceInfo.len(), tPair->LTPK) !=
@@ -830,16 +979,20 @@ int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
             cPair = tPair;  // save Controller for this connection slot - connection is now verified and should be
                             // encrypted going forward
 
-            HKDF::create(a2cKey, temp.sharedCurveKey, 32, "Control-Salt",
-                         "Control-Read-Encryption-Key");  // create AccessoryToControllerKey from (previously-saved)
-                                                          // Shared-Secret Curve25519 Key (HAP Section 6.5.2)
-            HKDF::create(c2aKey, temp.sharedCurveKey, 32, "Control-Salt",
-                         "Control-Write-Encryption-Key");  // create ControllerToAccessoryKey from (previously-saved)
-                                                           // Shared-Secret Curve25519 Key (HAP Section 6.5.2)
+            HKDF::createPair(a2cKey, "Control-Read-Encryption-Key", c2aKey, "Control-Write-Encryption-Key",
+                             temp->sharedCurveKey, 32,
+                             "Control-Salt");  // create AccessoryToControllerKey and ControllerToAccessoryKey from
+                                               // (previously-saved) Shared-Secret Curve25519 Key (HAP Section 6.5.2)
 
             a2cNonce.zero();  // reset Nonces for this session to zero
             c2aNonce.zero();
 
+            uint8_t sessionID[32];  // HKDF always creates 32 bytes, but only the first 8 are used for the Session ID
+
+            HKDF::create(sessionID, temp->sharedCurveKey, 32, "Pair-Verify-ResumeSessionID-Salt",
+                         "Pair-Verify-ResumeSessionID-Info");  // derive Session ID that Controller can use to resume
+            PairResume::save(sessionID, temp->sharedCurveKey, tPair->ID);  // cache session for later pair-resume
+
             LOG2("\n*** SESSION VERIFICATION COMPLETE *** \n");
         } break;
 
@@ -851,6 +1004,70 @@ int HAPClient::postPairVerifyURL(uint8_t *content, size_t len)
 
 //////////////////////////////////////
 
+boolean HAPClient::pairResume(uint8_t *iosCurveKey, uint8_t *sessionID, uint8_t *encData, size_t encLen)
+{
+    PairResume::session_t *session = PairResume::find(sessionID);
+    Controller *tPair;
+
+    if (!session || !(tPair = findController(session->controllerID))) {
+        LOG2("\n*** Pair-Resume Session ID not found.  Reverting to full Pair-Verify...\n");
+        return (false);
+    }
+
+    uint8_t newSessionID[hap_session_IDBYTES];
+    uint8_t responseTag[crypto_aead_chacha20poly1305_IETF_ABYTES];
+    uint8_t sharedSecret[32];  // new Shared-Secret for the resumed session
+
+    if (!PairResume::resume(session, iosCurveKey, encData, encLen, newSessionID, responseTag, sharedSecret)) {
+        LOG2("\n*** Pair-Resume Authentication Failed.  Reverting to full Pair-Verify...\n");
+        return (false);
+    }
+
+    LOG2("\n*** Resuming session with Controller ID: ");
+    charPrintRow(tPair->ID, hap_controller_IDBYTES, 2);
+    LOG2("...\n");
+
+    HAPTLV responseTLV;
+
+    responseTLV.add(kTLVType_State, pairState_M2);                              // set State=<M2>
+    responseTLV.add(kTLVType_Method, pairMethod_Resume);                        // set Method=Resume
+    responseTLV.add(kTLVType_SessionID, hap_session_IDBYTES, newSessionID);     // set SessionID to new Session ID
+    responseTLV.add(kTLVType_EncryptedData, sizeof(responseTag), responseTag);  // set EncryptedData to Auth Tag
+
+    tlvRespond(responseTLV);  // send response to client (unencrypted since cPair=NULL)
+
+    cPair = tPair;  // save Controller for this connection slot - connection is now verified and should be encrypted
+                    // going forward
+
+    HKDF::createPair(a2cKey, "Control-Read-Encryption-Key", c2aKey, "Control-Write-Encryption-Key",
+                     sharedSecret, 32,
+                     "Control-Salt");  // create AccessoryToControllerKey and ControllerToAccessoryKey from new Secret
+
+    a2cNonce.zero();  // reset Nonces for this session to zero
+    c2aNonce.zero();
+
+    sodium_memzero(sharedSecret, sizeof(sharedSecret));
+
+    LOG2("\n*** SESSION RESUME COMPLETE *** \n");
+    return (true);
+}
+
+//////////////////////////////////////
+
+boolean HAPClient::acquireTemp()
+{
+    return (Utils::PairVerifyPool<HAPClient>::acquire(this, millis()));
+}
+
+//////////////////////////////////////
+
+void HAPClient::releaseTemp()
+{
+    Utils::PairVerifyPool<HAPClient>::release(this);
+}
+
+//////////////////////////////////////
+
 int HAPClient::postPairingsURL(uint8_t *content, size_t len)
 {
     if (!cPair) {  // unverified, unencrypted session
@@ -858,10 +1075,15 @@ int HAPClient::postPairingsURL(uint8_t *content, size_t len)
         return (0);
     }
 
-    HAPTLV iosTLV;
+    HAPTLVView iosTLV;
     HAPTLV responseTLV;
 
-    iosTLV.unpack(content, len);
+    if (iosTLV.unpack(content, len) == -1) {  // parse TLV records in place (content is not copied)
+        LOG0("\n*** ERROR: Malformed TLV data\n\n");
+        badRequestError();  // return with 400 error, which closes connection
+        return (0);
+    }
+
     if (homeSpan.getLogLevel() > 1)
         iosTLV.print();
     LOG2("------------ END TLVS! ------------\n");
@@ -1024,54 +1246,62 @@ int HAPClient::getCharacteristicsURL(char *urlBuf)
 
     LOG1("In Get Characteristics #%d (%s)...\n", clientNumber, client.remoteIP().toString().c_str());
 
-    int len = strlen(urlBuf);  // determine number of IDs specified by counting commas in URL
-    int numIDs = 1;
-    for (int i = 0; i < len; i++)
-        if (urlBuf[i] == ',')
-            numIDs++;
-
-    TempBuffer<char *> ids(numIDs);  // reserve space for number of IDs found
-    int flags =
-        GET_VALUE | GET_AID;  // flags indicating which characteristic fields to include in response (HAP Table 6-13)
-    numIDs = 0;               // reset number of IDs found
-
     char *lastSpace = strchr(urlBuf, ' ');
     if (lastSpace)
         lastSpace[0] = '\0';
 
-    char *p1;
-    while (char *t1 = strtok_r(urlBuf, "&", &p1)) {  // parse request into major tokens
-        urlBuf = NULL;
-
-        if (!strcmp(t1, "meta=1")) {
-            flags |= GET_META;
-        } else if (!strcmp(t1, "perms=1")) {
-            flags |= GET_PERMS;
-        } else if (!strcmp(t1, "type=1")) {
-            flags |= GET_TYPE;
-        } else if (!strcmp(t1, "ev=1")) {
-            flags |= GET_EV;
-        } else if (!strncmp(t1, "id=", 3)) {
-            t1 += 3;
-            char *p2;
-            while (char *t2 = strtok_r(t1, ",", &p2)) {  // parse IDs
-                t1 = NULL;
-                ids[numIDs++] = t2;
+    SpanQueryPlan *plan = homeSpan.findQueryPlan(urlBuf);  // Home App tends to repeat the same queries when polling
+
+    if (!plan) {                   // no cached plan for this query - parse URL and create one
+        int len = strlen(urlBuf);  // determine number of IDs specified by counting commas in URL
+        int numIDs = 1;
+        for (int i = 0; i < len; i++)
+            if (urlBuf[i] == ',')
+                numIDs++;
+
+        char *query = (char *)homeSpan.requestArena.alloc(len + 1);  // save copy of query string, since strtok_r()
+        memcpy(query, urlBuf, len + 1);                               // below modifies urlBuf
+
+        char **ids = (char **)homeSpan.requestArena.alloc(numIDs * sizeof(char *));  // reserve space for IDs found
+        int flags = GET_VALUE | GET_AID;  // flags indicating which characteristic fields to include in response (HAP
+                                          // Table 6-13)
+        numIDs = 0;                       // reset number of IDs found
+
+        char *p1;
+        while (char *t1 = strtok_r(urlBuf, "&", &p1)) {  // parse request into major tokens
+            urlBuf = NULL;
+
+            if (!strcmp(t1, "meta=1")) {
+                flags |= GET_META;
+            } else if (!strcmp(t1, "perms=1")) {
+                flags |= GET_PERMS;
+            } else if (!strcmp(t1, "type=1")) {
+                flags |= GET_TYPE;
+            } else if (!strcmp(t1, "ev=1")) {
+                flags |= GET_EV;
+            } else if (!strncmp(t1, "id=", 3)) {
+                t1 += 3;
+                char *p2;
+                while (char *t2 = strtok_r(t1, ",", &p2)) {  // parse IDs
+                    t1 = NULL;
+                    ids[numIDs++] = t2;
+                }
             }
-        }
-    }  // parse URL
+        }  // parse URL
 
-    if (!numIDs)  // could not find any IDs
-        return (0);
+        if (!numIDs)  // could not find any IDs
+            return (0);
 
-    boolean statusFlag = homeSpan.printfAttributes(ids, numIDs, flags);  // get statusFlag returned to use below
-    size_t nBytes = hapOut.getSize();
-    hapOut.flush();
+        plan = homeSpan.createQueryPlan(query, ids, numIDs, flags);
+    }
+
+    homeSpan.checkReads(plan);       // refresh any expired values that have read callbacks
+    homeSpan.renderQueryPlan(plan);  // re-uses previously rendered body if none of the requested values changed
 
     hapOut.setLogLevel(2).setHapClient(this);
-    hapOut << "HTTP/1.1 " << (!statusFlag ? "200 OK" : "207 Multi-Status")
-           << "\r\nContent-Type: application/hap+json\r\nContent-Length: " << nBytes << "\r\n\r\n";
-    homeSpan.printfAttributes(ids, numIDs, flags);
+    hapOut << "HTTP/1.1 " << (!(plan->flags & GET_STATUS) ? "200 OK" : "207 Multi-Status")
+           << "\r\nContent-Type: application/hap+json\r\nContent-Length: " << plan->body.size() << "\r\n\r\n";
+    hapOut.write(plan->body.data(), plan->body.size());
     hapOut.flush();
 
     LOG2("\n-------- SENT ENCRYPTED! --------\n");
@@ -1094,7 +1324,7 @@ int HAPClient::putCharacteristicsURL(char *json)
     if (n == 0)                                   // if no objects found, return
         return (0);
 
-    SpanBuf pObj[n];                                  // reserve space for objects
+    SpanBuf *pObj = homeSpan.requestArena.allocArray<SpanBuf>(n);  // reserve space for objects
     if (!homeSpan.updateCharacteristics(json, pObj))  // perform update
         return (0);  // return if failed to update (error message will have been printed in update)
 
@@ -1285,6 +1515,7 @@ void HAPClient::getStatusURL(HAPClient *hapClient, void (*callBack)(const char *
     hapOut << "<tr><td>HomeKit Status:</td><td>" << (HAPClient::nAdminControllers() ? "PAIRED" : "NOT PAIRED")
            << "</td></tr>\n";
     hapOut << "<tr><td>Max Log Entries:</td><td>" << homeSpan.webLog.maxEntries << "</td></tr>\n";
+    hapOut << "<tr><td>Change Sequence:</td><td>" << homeSpan.getChangeSeq() << "</td></tr>\n";
 
     if (homeSpan.weblogCallback) {
         String usrString;
@@ -1295,30 +1526,51 @@ void HAPClient::getStatusURL(HAPClient *hapClient, void (*callBack)(const char *
     hapOut << "</table>\n";
     hapOut << "<p></p>";
 
+    if (SpanStalls::nStalls > 0) {
+        hapOut << "<table class=tab3><tr><th>Stall</th><th>Up Time</th><th>Phase</th><th>Duration (ms)</th></tr>\n";
+
+        for (int i = 0; i < SpanStalls::nStalls; i++) {
+            seconds = SpanStalls::stalls[i].upTime / 1000;
+            secs = seconds % 60;
+            mins = (seconds /= 60) % 60;
+            hours = (seconds /= 60) % 24;
+            days = (seconds /= 24);
+            sprintf(uptime, "%d:%02d:%02d:%02d", days, hours, mins, secs);
+
+            char duration[16];
+            sprintf(duration, "%.1f", SpanStalls::stalls[i].duration / 1000.0);
+
+            hapOut << "<tr><td>" << i + 1 << "</td><td>" << uptime << "</td><td>"
+                   << SpanStalls::phaseNames[SpanStalls::stalls[i].phase] << "</td><td>" << duration << "</td></tr>\n";
+        }
+        hapOut << "</table>\n";
+        hapOut << "<p></p>";
+    }
+
     if (homeSpan.webLog.maxEntries > 0) {
         hapOut << "<table class=tab2><tr><th>Entry</th><th>Up Time</th><th>Log "
                   "Time</th><th>Client</th><th>Message</th></tr>\n";
-        int lastIndex = homeSpan.webLog.nEntries - homeSpan.webLog.maxEntries;
-        if (lastIndex < 0)
-            lastIndex = 0;
-
-        for (int i = homeSpan.webLog.nEntries - 1; i >= lastIndex; i--) {
-            int index = i % homeSpan.webLog.maxEntries;
-            seconds = homeSpan.webLog.log[index].upTime / 1e6;
+        uint32_t oldestSeq, newestSeq;
+        homeSpan.webLog.getRange(oldestSeq, newestSeq);
+        SpanWebLog::cursor_t cursor(newestSeq);  // start from newest entry
+        SpanWebLog::entry_t entry;
+        char message[MAX_WEBLOG_MESSAGE];
+        char clientIP[16];
+
+        while (homeSpan.webLog.readEntry(cursor, entry, message, sizeof(message))) {
+            seconds = entry.upTime;
             secs = seconds % 60;
             mins = (seconds /= 60) % 60;
             hours = (seconds /= 60) % 24;
             days = (seconds /= 24);
             sprintf(uptime, "%d:%02d:%02d:%02d", days, hours, mins, secs);
 
-            if (homeSpan.webLog.log[index].clockTime.tm_year > 0)
-                strftime(clocktime, sizeof(clocktime), "%c", &homeSpan.webLog.log[index].clockTime);
-            else
-                sprintf(clocktime, "Unknown");
+            sprintf(clientIP, "%d.%d.%d.%d", entry.clientIP & 0xFF, (entry.clientIP >> 8) & 0xFF,
+                    (entry.clientIP >> 16) & 0xFF, entry.clientIP >> 24);
 
-            hapOut << "<tr><td>" << i + 1 << "</td><td>" << uptime << "</td><td>" << clocktime << "</td><td>"
-                   << homeSpan.webLog.log[index].clientIP.c_str() << "</td><td>" << homeSpan.webLog.log[index].message
-                   << "</td></tr>\n";
+            hapOut << "<tr><td>" << entry.seq << "</td><td>" << uptime << "</td><td>"
+                   << (entry.clockTime[0] ? entry.clockTime : "Unknown") << "</td><td>" << clientIP << "</td><td>"
+                   << message << "</td></tr>\n";
         }
         hapOut << "</table>\n";
     }
@@ -1335,11 +1587,168 @@ void HAPClient::getStatusURL(HAPClient *hapClient, void (*callBack)(const char *
 
 //////////////////////////////////////
 
+int HAPClient::getMetricsURL()
+{
+    LOG2("\n>>>>>>>>>> %s >>>>>>>>>>\n", client.remoteIP().toString().c_str());
+
+    multi_heap_info_t heapInternal;
+    heap_caps_get_info(&heapInternal, MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+
+    hapOut.setHapClient(this).setLogLevel(2);
+    hapOut << "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n\r\n";
+
+    SpanMetrics::print(hapOut);
+
+    hapOut << "# TYPE homespan_connections gauge\nhomespan_connections " << homeSpan.hapList.size() << "\n";
+    hapOut << "# TYPE homespan_heap_free_bytes gauge\nhomespan_heap_free_bytes " << heapInternal.total_free_bytes
+           << "\n";
+    hapOut << "# TYPE homespan_heap_largest_free_block_bytes gauge\nhomespan_heap_largest_free_block_bytes "
+           << heapInternal.largest_free_block << "\n";
+    hapOut << "# TYPE homespan_heap_minimum_free_bytes gauge\nhomespan_heap_minimum_free_bytes "
+           << heapInternal.minimum_free_bytes << "\n";
+    hapOut << "# TYPE homespan_uptime_seconds counter\nhomespan_uptime_seconds "
+           << (uint32_t)(esp_timer_get_time() / 1000000) << "\n";
+    hapOut.flush();
+
+    client.stop();
+    delay(1);
+    LOG2("------------ SENT! --------------\n");
+
+    return (1);
+}
+
+//////////////////////////////////////
+
+int HAPClient::getLogURL(const char *query)
+{
+    LOG2("\n>>>>>>>>>> %s >>>>>>>>>>\n", client.remoteIP().toString().c_str());
+
+    uint32_t since = 0;  // return entries with sequence numbers greater than since
+    const char *end = strchr(query, ' ');
+    const char *param = strstr(query, "since=");
+    if (*query == '?' && param && (!end || param < end))
+        since = strtoul(param + 6, NULL, 10);
+
+    uint32_t oldestSeq, newestSeq;
+    homeSpan.webLog.getRange(oldestSeq, newestSeq);
+
+    multi_heap_info_t heapInternal;
+    heap_caps_get_info(&heapInternal, MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
+
+    hapOut.setHapClient(this).setLogLevel(2);
+    hapOut << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n";
+    hapOut.flush();
+
+    hapOut.setHapClient(this).setLogLevel(2).setChunked();  // summary is sent in same chunk as first batch of entries
+    hapOut << "{\"uptime\":" << (uint32_t)(esp_timer_get_time() / 1000000) << ",\"rssi\":" << (int)WiFi.RSSI()
+           << ",\"heap\":" << heapInternal.total_free_bytes
+           << ",\"paired\":" << (nAdminControllers() ? "true" : "false") << ",\"oldest\":" << oldestSeq
+           << ",\"newest\":" << newestSeq << ",\"entries\":[";
+
+    if (since + 1 < oldestSeq)  // requested entries are no longer in log - start with oldest
+        since = oldestSeq - 1;
+
+    logCursor = SpanWebLog::cursor_t(since + 1);
+    logEnd = newestSeq;  // entries added after this request are left for the next request
+    logSent = 0;
+
+    streamLog();  // sends first batch (and finishes response right away if there is nothing new)
+    return (1);
+}
+
+//////////////////////////////////////
+
+void HAPClient::streamLog()
+{
+    SpanWebLog::entry_t entry;
+    char message[MAX_WEBLOG_MESSAGE];
+    char clientIP[16];
+    int n = 0;
+
+    if (cPair) {  // connection was verified part-way through stream - chunked response can no longer be completed
+        LOG0("\n*** ERROR:  Web Log stream interrupted by Pair-Verify - closing connection\n\n");
+        client.stop();
+        logEnd = 0;
+        return;
+    }
+
+    hapOut.setHapClient(this).setLogLevel(2).setChunked();
+
+    // entries evicted since the last batch are skipped (the client sees the gap in seq), so the stream always runs
+    // to logEnd
+
+    while (n < LOG_STREAM_BATCH && homeSpan.webLog.readNewer(logCursor, logEnd, entry, message, sizeof(message))) {
+        sprintf(clientIP, "%d.%d.%d.%d", entry.clientIP & 0xFF, (entry.clientIP >> 8) & 0xFF,
+                (entry.clientIP >> 16) & 0xFF, entry.clientIP >> 24);
+
+        hapOut << (logSent++ ? "," : "") << "{\"seq\":" << entry.seq << ",\"uptime\":" << entry.upTime
+               << ",\"time\":\"" << entry.clockTime << "\",\"client\":\"" << clientIP << "\",\"msg\":\"";
+
+        for (char *c = message; *c; c++) {  // escape message as a JSON string
+            if (*c == '"' || *c == '\\') {
+                hapOut << '\\' << *c;
+            } else if ((uint8_t)*c < 0x20) {
+                char esc[8];
+                sprintf(esc, "\\u%04X", *c);
+                hapOut << esc;
+            } else {
+                hapOut << *c;
+            }
+        }
+
+        hapOut << "\"}";
+        n++;
+    }
+
+    boolean done = (n < LOG_STREAM_BATCH || logCursor.seq > logEnd);  // finished
+
+    if (done)
+        hapOut << "]}";
+
+    hapOut.flush();
+
+    if (!done)
+        return;
+
+    client.write("0\r\n\r\n", 5);  // last chunk (written directly, since connection is never encrypted while streaming)
+    client.stop();
+    logEnd = 0;
+    delay(1);
+    LOG2("------------ SENT %d LOG ENTRIES! --------------\n", logSent);
+}
+
+//////////////////////////////////////
+
+#ifdef HS_TRACE
+
+int HAPClient::getTraceURL()
+{
+    LOG2("\n>>>>>>>>>> %s >>>>>>>>>>\n", client.remoteIP().toString().c_str());
+
+    hapOut.setHapClient(this).setLogLevel(2);
+    hapOut << "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n\r\n";
+    SpanTrace::print(hapOut);
+    hapOut.flush();
+
+    client.stop();
+    delay(1);
+    LOG2("------------ SENT! --------------\n");
+
+    return (1);
+}
+
+#endif
+
+//////////////////////////////////////
+
 void HAPClient::checkNotifications()
 {
+    if (homeSpan.batchDepth)  // hold Notifications until batch is committed so subscribers see all changes together
+        return;
+
     if (!homeSpan.Notifications.empty()) {  // if there are Notifications to process
         eventNotify(&homeSpan.Notifications[0], homeSpan.Notifications.size());  // transmit EVENT Notifications
-        homeSpan.Notifications.clear();                                          // clear Notifications vector
+        homeSpan.clearNotifications();                                           // clear Notifications vector
     }
 }
 
@@ -1363,6 +1772,8 @@ void HAPClient::checkTimedWrites()
 
 void HAPClient::eventNotify(SpanBuf *pObj, int nObj, HAPClient *ignore)
 {
+    HS_TRACE_SCOPE("notify");
+
     for (auto it = homeSpan.hapList.begin(); it != homeSpan.hapList.end(); ++it) {  // loop over all connection slots
         if (&(*it) != ignore) {  // if NOT flagged to be ignored (in cases where it is the client making a PUT request)
 
@@ -1380,6 +1791,7 @@ void HAPClient::eventNotify(SpanBuf *pObj, int nObj, HAPClient *ignore)
                        << "\r\n\r\n";
                 homeSpan.printfNotify(pObj, nObj, &(*it));
                 hapOut.flush();
+                SpanMetrics::eventsSent++;
 
                 LOG2("\n-------- SENT ENCRYPTED! --------\n");
             }
@@ -1390,11 +1802,9 @@ void HAPClient::eventNotify(SpanBuf *pObj, int nObj, HAPClient *ignore)
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
 
-void HAPClient::tlvRespond(TLV8 &tlv8)
+void HAPClient::tlvRespond(TLV8Writer &tlv8)
 {
-    tlv8.osprint(hapOut);
-    size_t nBytes = hapOut.getSize();
-    hapOut.flush();
+    size_t nBytes = tlv8.pack_size();  // packed size is tracked as records are added, so no need to render it first
 
     char *body;
     asprintf(&body, "HTTP/1.1 200 OK\r\nContent-Type: application/pairing+tlv8\r\nContent-Length: %d\r\n\r\n",
@@ -1423,6 +1833,8 @@ void HAPClient::tlvRespond(TLV8 &tlv8)
 
 int HAPClient::receiveEncrypted(uint8_t *httpBuf, int messageSize)
 {
+    HS_TRACE_SCOPE("decrypt");
+
     uint8_t aad[2];
     int nBytes = 0;
 
@@ -1430,7 +1842,7 @@ int HAPClient::receiveEncrypted(uint8_t *httpBuf, int messageSize)
 
         int n = aad[0] + aad[1] * 256;  // compute number of bytes expected in message after decoding
 
-        if (nBytes + n > messageSize) {  // exceeded maximum number of bytes allowed in plaintext message
+        if (nBytes + n + 16 > messageSize) {  // frame (with its 16-byte tag) would not fit in remaining buffer
             LOG0(
                 "\n\n*** ERROR:  Decrypted message of %d bytes exceeded maximum expected message length of %d "
                 "bytes\n\n",
@@ -1438,16 +1850,15 @@ int HAPClient::receiveEncrypted(uint8_t *httpBuf, int messageSize)
             return (0);
         }
 
-        TempBuffer<uint8_t> tBuf(n + 16);  // expected number of total bytes = n bytes in encoded message + 16 bytes for
-                                           // appended authentication tag
+        uint8_t *frame = httpBuf + nBytes;  // frame is read and decrypted in place, directly into httpBuf
 
-        if (client.read(tBuf, tBuf.len()) != tBuf.len()) {
+        if (client.read(frame, n + 16) != n + 16) {  // n bytes in encoded message + 16 bytes for authentication tag
             LOG0("\n\n*** ERROR: Malformed encrypted message frame\n\n");
             return (0);
         }
 
-        if (crypto_aead_chacha20poly1305_ietf_decrypt(httpBuf + nBytes, NULL, NULL, tBuf, tBuf.len(), aad, 2,
-                                                      c2aNonce.get(), c2aKey) == -1) {
+        if (crypto_aead_chacha20poly1305_ietf_decrypt(frame, NULL, NULL, frame, n + 16, aad, 2, c2aNonce.get(),
+                                                      c2aKey) == -1) {
             LOG0("\n\n*** ERROR: Can't Decrypt Message\n\n");
             return (0);
         }
@@ -1455,6 +1866,8 @@ int HAPClient::receiveEncrypted(uint8_t *httpBuf, int messageSize)
         c2aNonce.inc();
 
         nBytes += n;  // increment total number of bytes in plaintext message
+        SpanMetrics::framesDecrypted++;
+        SpanMetrics::bytesDecrypted += n;
 
     }  // while
 
@@ -1471,7 +1884,7 @@ void HAPClient::hexPrintColumn(const uint8_t *buf, int n, int minLogLevel)
         return;
 
     for (int i = 0; i < n; i++)
-        Serial.printf("%d) %02X\n", i, buf[i]);
+        SpanLog::printf("%d) %02X\n", i, buf[i]);
 }
 
 //////////////////////////////////////
@@ -1481,8 +1894,7 @@ void HAPClient::hexPrintRow(const uint8_t *buf, int n, int minLogLevel)
     if (homeSpan.logLevel < minLogLevel)
         return;
 
-    for (int i = 0; i < n; i++)
-        Serial.printf("%02X", buf[i]);
+    SpanLog::hexWrite(buf, n);
 }
 
 //////////////////////////////////////
@@ -1492,8 +1904,7 @@ void HAPClient::charPrintRow(const uint8_t *buf, int n, int minLogLevel)
     if (homeSpan.logLevel < minLogLevel)
         return;
 
-    for (int i = 0; i < n; i++)
-        Serial.printf("%c", buf[i]);
+    SpanLog::write((const char *)buf, n);
 }
 
 //////////////////////////////////////
@@ -1592,6 +2003,8 @@ void HAPClient::removeController(uint8_t *id)
 
 void HAPClient::tearDown(uint8_t *id)
 {
+    PairResume::clear(id);  // sessions verified by a removed Controller can no longer be resumed
+
     for (HAPClient &hc : homeSpan.hapList) {
         if (id == NULL || (hc.cPair && !memcmp(id, hc.cPair->ID, hap_controller_IDBYTES))) {
             LOG1("*** Terminating Client #%d\n", hc.clientNumber);
@@ -1608,16 +2021,16 @@ void HAPClient::printControllers(int minLogLevel)
         return;
 
     if (controllerList.empty()) {
-        Serial.printf("No Paired Controllers\n");
+        SpanLog::print("No Paired Controllers\n");
         return;
     }
 
     for (auto it = controllerList.begin(); it != controllerList.end(); it++) {
-        Serial.printf("Paired Controller: ");
+        SpanLog::print("Paired Controller: ");
         charPrintRow((*it).ID, hap_controller_IDBYTES);
-        Serial.printf("%s  LTPK: ", (*it).admin ? "   (admin)" : " (regular)");
+        SpanLog::printf("%s  LTPK: ", (*it).admin ? "   (admin)" : " (regular)");
         hexPrintRow((*it).LTPK, crypto_sign_PUBLICKEYBYTES);
-        Serial.printf("\n");
+        SpanLog::print("\n");
     }
 }
 
@@ -1676,15 +2089,14 @@ void Nonce::inc()
 
 HapOut::HapStreamBuffer::HapStreamBuffer()
 {
-    // note - must require all memory allocation to be pulled from INTERNAL heap only
+    // note - must require all memory allocation to be pulled from INTERNAL heap only (enforced by placement policy for
+    // HS_MEM_NETWORK and HS_MEM_CRYPTO tags)
 
-    const uint32_t caps = MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL;
-
-    buffer = (char *)heap_caps_malloc(bufSize + 1, caps);  // add 1 for adding null terminator when printing text
-    encBuf =
-        (uint8_t *)heap_caps_malloc(bufSize + 18, caps);  // 2-byte AAD + encrypted data + 16-byte authentication tag
-    hash = (uint8_t *)heap_caps_malloc(48, caps);         // space for SHA-384 hash output
-    ctx = (mbedtls_sha512_context *)heap_caps_malloc(sizeof(mbedtls_sha512_context), caps);  // space for hash context
+    buffer = (char *)hs_malloc(bufSize + 1, HS_MEM_NETWORK);  // add 1 for adding null terminator when printing text
+    encBuf = (uint8_t *)hs_malloc(bufSize + 18,
+                                  HS_MEM_NETWORK);  // 2-byte AAD + encrypted data + 16-byte authentication tag
+    hash = (uint8_t *)hs_malloc(48, HS_MEM_CRYPTO);  // space for SHA-384 hash output
+    ctx = (mbedtls_sha512_context *)hs_malloc(sizeof(mbedtls_sha512_context), HS_MEM_CRYPTO);  // space for hash context
 
     mbedtls_sha512_init(ctx);           // initialize context
     mbedtls_sha512_starts_ret(ctx, 1);  // start SHA-384 hash (note second argument=1)
@@ -1697,10 +2109,10 @@ HapOut::HapStreamBuffer::HapStreamBuffer()
 HapOut::HapStreamBuffer::~HapStreamBuffer()
 {
     sync();
-    free(buffer);
-    free(encBuf);
-    free(hash);
-    free(ctx);
+    hs_free(buffer, HS_MEM_NETWORK);
+    hs_free(encBuf, HS_MEM_NETWORK);
+    hs_free(hash, HS_MEM_CRYPTO);
+    hs_free(ctx, HS_MEM_CRYPTO);
 }
 
 //////////////////////////////////////
@@ -1721,21 +2133,34 @@ void HapOut::HapStreamBuffer::flushBuffer()
         if (enablePrettyPrint)  // if pretty print needed, use formatted method
             printFormatted(buffer, num, 2);
         else  // if not, just print
-            Serial.print(buffer);
+            SpanLog::write(buffer, num);
     }
 
     if (hapClient != NULL) {
-        if (!hapClient->cPair) {                   // if not encrypted
-            hapClient->client.write(buffer, num);  // transmit data buffer
+        if (!hapClient->cPair) {  // if not encrypted
+            HS_TRACE_SCOPE("write");
+            if (chunked && num > 0) {  // frame data as an HTTP chunk (an empty chunk would terminate the response)
+                char chunkHeader[8];
+                hapClient->client.write(chunkHeader, sprintf(chunkHeader, "%X\r\n", num));
+                hapClient->client.write(buffer, num);
+                hapClient->client.write("\r\n", 2);
+            } else if (!chunked) {
+                hapClient->client.write(buffer, num);  // transmit data buffer
+            }
 
         } else {  // if encrypted
 
+            HS_TRACE_BEGIN(encrypt, "encrypt");
             encBuf[0] = num % 256;  // store number of bytes that encrypts this frame (AAD bytes)
             encBuf[1] = num / 256;
             crypto_aead_chacha20poly1305_ietf_encrypt(
                 encBuf + 2, NULL, (uint8_t *)buffer, num, encBuf, 2, NULL, hapClient->a2cNonce.get(),
                 hapClient->a2cKey);  // encrypt buffer with AAD prepended and authentication tag appended
+            HS_TRACE_END(encrypt);
+            SpanMetrics::framesEncrypted++;
+            SpanMetrics::bytesEncrypted += num;
 
+            HS_TRACE_SCOPE("write");
             hapClient->client.write(encBuf, num + 18);  // transmit encrypted frame
             hapClient->a2cNonce.inc();                  // increment nonce
         }
@@ -1769,6 +2194,7 @@ int HapOut::HapStreamBuffer::sync()
     logLevel = 255;
     hapClient = NULL;
     enablePrettyPrint = false;
+    chunked = false;
     byteCount = 0;
     indent = 0;
 
@@ -1788,35 +2214,51 @@ int HapOut::HapStreamBuffer::sync()
 
 void HapOut::HapStreamBuffer::printFormatted(char *buf, size_t nChars, size_t nsp)
 {
+    char out[128];  // formatted output is collected into chunks before being queued to the log task
+    size_t n = 0;
+
+    auto put = [&](char c) {
+        if (n == sizeof(out)) {
+            SpanLog::write(out, n);
+            n = 0;
+        }
+        out[n++] = c;
+    };
+
+    auto newLine = [&]() {
+        put('\n');
+        for (int j = 0; j < indent; j++)
+            put(' ');
+    };
+
     for (int i = 0; i < nChars; i++) {
         switch (buf[i]) {
             case '{':
             case '[':
-                Serial.printf("%c\n", buf[i]);
+                put(buf[i]);
                 indent += nsp;
-                for (int j = 0; j < indent; j++)
-                    Serial.printf(" ");
+                newLine();
                 break;
 
             case '}':
             case ']':
-                Serial.printf("\n");
                 indent -= nsp;
-                for (int j = 0; j < indent; j++)
-                    Serial.printf(" ");
-                Serial.printf("%c", buf[i]);
+                newLine();
+                put(buf[i]);
                 break;
 
             case ',':
-                Serial.printf("%c\n", buf[i]);
-                for (int j = 0; j < indent; j++)
-                    Serial.printf(" ");
+                put(buf[i]);
+                newLine();
                 break;
 
             default:
-                Serial.printf("%c", buf[i]);
+                put(buf[i]);
         }
     }
+
+    if (n > 0)
+        SpanLog::write(out, n);
 }
 
 /////////////////////////////////////////////////////////////////////////////////
@@ -1825,5 +2267,15 @@ void HapOut::HapStreamBuffer::printFormatted(char *buf, size_t nChars, size_t ns
 // instantiate all static HAP Client structures and data
 
 pairState HAPClient::pairStatus;
+HAPClient::curveKeyPair_t HAPClient::curveKeys[MAX_CURVE_KEYS];
+int HAPClient::nCurveKeys = 0;
+SRP6A *HAPClient::srp = NULL;
+SRP6A *HAPClient::srpNext = NULL;
+volatile boolean HAPClient::srpKeyBusy = false;
+volatile boolean HAPClient::srpKeyReady = false;
+uint32_t HAPClient::srpKeyVersion = 0;
+uint32_t HAPClient::srpNextVersion = 0;
+HAPClient::tempKeys_t HAPClient::tempPool[MAX_PAIR_VERIFY];
+uint32_t HAPClient::tempFallbacks = 0;
 Accessory HAPClient::accessory;
 list<Controller, Mallocator<Controller>> HAPClient::controllerList;
@@ -34,6 +34,7 @@
 #include "HAPConstants.h"
 #include "HKDF.h"
 #include "SRP.h"
+#include "Resume.h"
 
 const TLV8_names HAP_Names[] = {{kTLVType_Separator, "SEPARATOR"},
                                 {kTLVType_State, "STATE"},
@@ -45,10 +46,8 @@ const TLV8_names HAP_Names[] = {{kTLVType_Separator, "SEPARATOR"},
                                 {kTLVType_EncryptedData, "ENC.DATA"},
                                 {kTLVType_Signature, "SIGNATURE"},
                                 {kTLVType_Identifier, "IDENTIFIER"},
-                                {kTLVType_Permissions, "PERMISSION"}};
-
-#define hap_controller_IDBYTES 36
-#define hap_accessory_IDBYTES 17
+                                {kTLVType_Permissions, "PERMISSION"},
+                                {kTLVType_SessionID, "SESSION.ID"}};
 
 /////////////////////////////////////////////////
 // NONCE Structure (HAP used last 64 of 96 bits)
@@ -112,21 +111,40 @@ struct HAPClient
     static const int MAX_HTTP = 8096;        // max number of bytes allowed for HTTP message
     static const int MAX_CONTROLLERS = 16;   // maximum number of paired controllers (HAP requires at least 16)
     static const int MAX_ACCESSORIES = 150;  // maximum number of allowed Accessories (HAP limit=150)
+    static const int MAX_CURVE_KEYS = 2;     // number of pre-generated Curve25519 keypairs kept ready for pair-verify
 
     static pairState pairStatus;  // tracks pair-setup status
     static Accessory accessory;   // Accessory ID and Ed25519 public and secret keys - permanently stored
     static list<Controller, Mallocator<Controller>>
         controllerList;  // linked-list of Paired Controller IDs and ED25519 long-term public keys - permanently stored
 
-    // individual structures and data defined for each Hap Client connection
+    // Ephemeral key material generated ahead of time (during idle polling) so that M2 responses of pair-setup and
+    // pair-verify only need to perform the calculations that depend on data sent by the controller
 
-    WiFiClient client;         // handle to client
-    int clientNumber;          // client number
-    Controller *cPair = NULL;  // pointer to info on current, session-verified Paired Controller (NULL=un-verified, and
-                               // therefore un-encrypted, connection)
+    struct curveKeyPair_t
+    {
+        uint8_t publicKey[crypto_box_PUBLICKEYBYTES];  // pre-generated Curve25519 Public Key
+        uint8_t secretKey[crypto_box_SECRETKEYBYTES];  // pre-generated Curve25519 Secret Key
+    };
+
+    static curveKeyPair_t curveKeys[MAX_CURVE_KEYS];  // pool of pre-generated Curve25519 keypairs (each used only once)
+    static int nCurveKeys;                            // number of keypairs currently available in pool
+    static SRP6A *srp;                    // SRP-6A structure - persists across pair-setup steps
+    static SRP6A *srpNext;                // SRP-6A structure holding a pre-generated b and B (filled in by srpKeyTask)
+    static volatile boolean srpKeyBusy;   // true while srpKeyTask is computing B (srpNext belongs to that task)
+    static volatile boolean srpKeyReady;  // true if srpNext holds a b and B that has not yet been sent to a controller
+    static uint32_t srpKeyVersion;        // incremented whenever the verification data changes
+    static uint32_t srpNextVersion;       // value of srpKeyVersion when srpNext was generated
 
     // These temporary Curve25519 keys are generated in the first call to pair-verify and used in the second call to
-    // pair-verify so must persist for a short period
+    // pair-verify so must persist for a short period.  Rather than embedding them in every connection, they are
+    // checked out of a small shared pool when pair-verify starts and wiped as soon as it finishes.  Pair-verify
+    // exchanges beyond the size of the pool (e.g. every Controller reconnecting at once) use heap-allocated
+    // temporaries instead (see Utils::PairVerifyPool)
+
+    static const int MAX_PAIR_VERIFY = 2;               // number of pair-verify exchanges that share the fixed pool
+    static const uint32_t PAIR_VERIFY_TIMEOUT = 10000;  // time (in ms) after which an unfinished pair-verify can be
+                                                        // reclaimed by another connection
 
     struct tempKeys_t
     {
@@ -135,7 +153,29 @@ struct HAPClient
                                                             // Secret Key and Controller's Public Key
         uint8_t sessionKey[crypto_box_PUBLICKEYBYTES];      // Session Key Curve25519 (derived with various HKDF calls)
         uint8_t iosCurveKey[crypto_box_PUBLICKEYBYTES];     // Controller's Curve25519 Public Key
-    } temp;
+        HAPClient *owner = NULL;                            // connection using these keys (NULL if slot is free)
+        uint32_t startTime;                                 // millis() time when pair-verify started
+    };
+
+    static tempKeys_t tempPool[MAX_PAIR_VERIFY];  // shared pool of pair-verify temporaries
+    static uint32_t tempFallbacks;                // number of pair-verify temporaries allocated from the heap
+
+    // individual structures and data defined for each Hap Client connection
+
+    WiFiClient client;         // handle to client
+    int clientNumber;          // client number
+    Controller *cPair = NULL;  // pointer to info on current, session-verified Paired Controller (NULL=un-verified, and
+                               // therefore un-encrypted, connection)
+
+    tempKeys_t *temp = NULL;  // pair-verify temporaries from tempPool or heap (NULL if no pair-verify in progress)
+
+    // Web Log entries requested with GET <status-url>/log are streamed a few at a time in each call to pollTask()
+
+    static const int LOG_STREAM_BATCH = 8;  // number of Web Log entries streamed to a client in each pollTask() cycle
+
+    SpanWebLog::cursor_t logCursor{0};  // next Web Log entry to stream
+    uint32_t logEnd = 0;                // sequence number of last Web Log entry to stream (0 if not streaming)
+    uint32_t logSent = 0;               // number of Web Log entries streamed so far
 
     // CurveKey and CurveKey Nonces are created once each new session is verified in /pair-verify.  Keys persist for as
     // long as connection is open
@@ -149,6 +189,8 @@ struct HAPClient
 
     // define member methods
 
+    ~HAPClient() { releaseTemp(); }
+
     void processRequest();                                // process HAP request
     int postPairSetupURL(uint8_t *content, size_t len);   // POST /pair-setup (HAP Section 5.6)
     int postPairVerifyURL(uint8_t *content, size_t len);  // POST /pair-verify (HAP Section 5.7)
@@ -157,9 +199,20 @@ struct HAPClient
     int getCharacteristicsURL(char *urlBuf);              // GET /characteristics (HAP Section 6.7.4)
     int putCharacteristicsURL(char *json);                // PUT /characteristics (HAP Section 6.7.2)
     int putPrepareURL(char *json);                        // PUT /prepare (HAP Section 6.7.2.4)
+    int getMetricsURL();  // GET <status-url>/metrics (an optional, non-HAP feature)
+    int getLogURL(const char *query);  // GET <status-url>/log?since=<seq> (an optional, non-HAP feature)
+    void streamLog();                  // streams next batch of Web Log entries requested with getLogURL()
+#ifdef HS_TRACE
+    int getTraceURL();  // GET <status-url>/trace (an optional, non-HAP feature)
+#endif
+    boolean pairResume(uint8_t *iosCurveKey, uint8_t *sessionID, uint8_t *encData,
+                       size_t encLen);  // attempts to resume a cached session (returns true if resumed)
 
-    void tlvRespond(TLV8 &tlv8);  // respond to client with HTTP OK header and all defined TLV data records
-    int receiveEncrypted(uint8_t *httpBuf, int messageSize);  // decrypt HTTP request (HAP Section 6.5)
+    void tlvRespond(TLV8Writer &tlv8);  // respond to client with HTTP OK header and all defined TLV data records
+    int receiveEncrypted(uint8_t *httpBuf, int messageSize);  // decrypt HTTP request in place (HAP Section 6.5)
+
+    boolean acquireTemp();  // checks out pair-verify temporaries from tempPool or heap; returns false if out of memory
+    void releaseTemp();     // wipes pair-verify temporaries and returns them to tempPool or heap
 
     int notFoundError();      // return 404 error
     int badRequestError();    // return 400 error
@@ -167,7 +220,9 @@ struct HAPClient
 
     // define static methods
 
-    static void init();  // initialize HAP after start-up
+    static void init();                  // initialize HAP after start-up
+    static void preGenerateKeys();       // generates one Curve25519 keypair or starts srpKeyTask (called when idle)
+    static void srpKeyTask(void *args);  // computes SRP public key into srpNext in the background
 
     static void hexPrintColumn(const uint8_t *buf,
                                int n,
@@ -208,10 +263,16 @@ struct HAPClient
                              void (*)(const char *, void *),
                              void *);  // GET / status (an optional, non-HAP feature)
 
-    class HAPTLV : public TLV8
-    {  // dedicated class for HAP TLV8 records
+    class HAPTLV : public TLV8Writer
+    {  // dedicated class for building HAP TLV8 records
+      public:
+        HAPTLV() : TLV8Writer(HAP_Names, 12) {}
+    };
+
+    class HAPTLVView : public TLV8View
+    {  // dedicated class for parsing received HAP TLV8 records in place
       public:
-        HAPTLV() : TLV8(HAP_Names, 11) {}
+        HAPTLVView() : TLV8View(HAP_Names, 12) {}
     };
 };
 
@@ -229,6 +290,7 @@ class HapOut : public std::ostream
         HAPClient *hapClient = NULL;
         int logLevel = 255;  // default is NOT to print anything
         boolean enablePrettyPrint = false;
+        boolean chunked = false;  // send each flushed buffer as an HTTP chunk (unencrypted connections only)
         size_t byteCount = 0;
         size_t indent = 0;
         uint8_t *hash;
@@ -267,6 +329,11 @@ class HapOut : public std::ostream
         hapBuffer.logLevel = 0;
         return (*this);
     }
+    HapOut &setChunked()
+    {
+        hapBuffer.chunked = true;
+        return (*this);
+    }
     HapOut &setCallback(void (*f)(const char *, void *))
     {
         hapBuffer.callBack = f;
@@ -27,6 +27,12 @@
 
 #pragma once
 
+// Sizes of HAP pairing identifiers
+
+#define hap_controller_IDBYTES 36
+#define hap_accessory_IDBYTES 17
+#define hap_session_IDBYTES 8
+
 // HAP TLV Types (HAP Table 5-6)
 
 typedef enum
@@ -45,10 +51,24 @@ typedef enum
     kTLVType_Permissions = 0x0B,
     kTLVType_FragmentData = 0x0C,
     kTLVType_FragmentLast = 0x0D,
+    kTLVType_SessionID = 0x0E,
     kTLVType_Flags = 0x13,
     kTLVType_Separator = 0xFF
 } kTLVType;
 
+// HAP Pairing Methods (HAP Table 5-3)
+
+typedef enum
+{
+    pairMethod_Setup = 0x00,
+    pairMethod_SetupAuth = 0x01,
+    pairMethod_Verify = 0x02,
+    pairMethod_AddPairing = 0x03,
+    pairMethod_RemovePairing = 0x04,
+    pairMethod_ListPairings = 0x05,
+    pairMethod_Resume = 0x06
+} pairMethod;
+
 // HAP Error Codes (HAP Table 5-5)
 
 typedef enum
@@ -25,183 +25,200 @@
  *
  ********************************************************************************/
 
-#include <mbedtls/hkdf.h>
+#include <mbedtls/sha512.h>
 #include <mbedtls/platform_util.h>
 
 #include "HKDF.h"
 
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
-// Wrapper function to call mbedtls_hkdf, below, with
-// HAP-specific parameters and assumptions
+// HMAC-SHA-512 and HKDF-SHA-512 built directly on the SHA-512 primitives
+// so that the key schedule of each HMAC key (the SHA-512 states after
+// absorbing key^ipad and key^opad) can be computed once and cloned
 
-int HKDF::create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, const char *salt, const char *info)
+struct hmacState_t
 {
-    return (mbedtls_hkdf(mbedtls_md_info_from_type(MBEDTLS_MD_SHA512), (uint8_t *)salt, (size_t)strlen(salt), inputKey,
-                         (size_t)inputLen, (uint8_t *)info, (size_t)strlen(info), outputKey, 32));
-}
+    mbedtls_sha512_context inner;  // SHA-512 state after absorbing (key XOR ipad)
+    mbedtls_sha512_context outer;  // SHA-512 state after absorbing (key XOR opad)
+};
 
-/////////////////////////////////////////////////////////////////////////////////
-/////////////////////////////////////////////////////////////////////////////////
-// CODE FOR HKDF IS MISSING FROM THE MBEDTLS LIBRARY INCLUDED WITH THE
-// ARDUINO-ESP32 LIBRARY.  THE CODE BELOW IS SOURCE DIRECTLY FROM THE MBEDTLS
-// GITHUB.  SEE THE MBEDTLS GITHUB SITE FOR LICENSING TERMS:
-//
-//  https://github.com/ARMmbed/mbedtls/blob/development/LICENSE
-//
-//
-
-int mbedtls_hkdf(const mbedtls_md_info_t *md,
-                 const unsigned char *salt,
-                 size_t salt_len,
-                 const unsigned char *ikm,
-                 size_t ikm_len,
-                 const unsigned char *info,
-                 size_t info_len,
-                 unsigned char *okm,
-                 size_t okm_len)
-{
-    int ret;
-    unsigned char prk[MBEDTLS_MD_MAX_SIZE];
+static const char *const fixedSalts[] = {"Pair-Setup-Encrypt-Salt",          "Pair-Setup-Controller-Sign-Salt",
+                                         "Pair-Setup-Accessory-Sign-Salt",   "Pair-Verify-Encrypt-Salt",
+                                         "Pair-Verify-ResumeSessionID-Salt", "Control-Salt"};
+
+static const int nFixedSalts = sizeof(fixedSalts) / sizeof(fixedSalts[0]);
+
+static hmacState_t saltStates[nFixedSalts];  // pre-computed key schedules for each of the fixed salts
+static boolean saltStatesReady = false;
 
-    ret = mbedtls_hkdf_extract(md, salt, salt_len, ikm, ikm_len, prk);
+//////////////////////////////////////
 
-    if (ret == 0) {
-        ret = mbedtls_hkdf_expand(md, prk, mbedtls_md_get_size(md), info, info_len, okm, okm_len);
+static void hmacStart(hmacState_t *hs, const uint8_t *key, size_t keyLen)
+{
+    uint8_t pad[128];  // SHA-512 block size
+    uint8_t keyHash[64];
+
+    if (keyLen > sizeof(pad)) {  // keys longer than block size are first hashed (RFC 2104)
+        mbedtls_sha512_ret(key, keyLen, keyHash, 0);
+        key = keyHash;
+        keyLen = sizeof(keyHash);
     }
 
-    mbedtls_platform_zeroize(prk, sizeof(prk));
+    mbedtls_sha512_init(&hs->inner);
+    mbedtls_sha512_init(&hs->outer);
 
-    return (ret);
+    memset(pad, 0x36, sizeof(pad));
+    for (size_t i = 0; i < keyLen; i++)
+        pad[i] ^= key[i];
+    mbedtls_sha512_starts_ret(&hs->inner, 0);
+    mbedtls_sha512_update_ret(&hs->inner, pad, sizeof(pad));
+
+    memset(pad, 0x5C, sizeof(pad));
+    for (size_t i = 0; i < keyLen; i++)
+        pad[i] ^= key[i];
+    mbedtls_sha512_starts_ret(&hs->outer, 0);
+    mbedtls_sha512_update_ret(&hs->outer, pad, sizeof(pad));
+
+    mbedtls_platform_zeroize(pad, sizeof(pad));
+    mbedtls_platform_zeroize(keyHash, sizeof(keyHash));
 }
 
-int mbedtls_hkdf_extract(const mbedtls_md_info_t *md,
-                         const unsigned char *salt,
-                         size_t salt_len,
-                         const unsigned char *ikm,
-                         size_t ikm_len,
-                         unsigned char *prk)
+//////////////////////////////////////
+
+static void hmacFree(hmacState_t *hs)
 {
-    unsigned char null_salt[MBEDTLS_MD_MAX_SIZE] = {'\0'};
+    mbedtls_sha512_free(&hs->inner);
+    mbedtls_sha512_free(&hs->outer);
+}
 
-    if (salt == NULL) {
-        size_t hash_len;
+//////////////////////////////////////
 
-        if (salt_len != 0) {
-            return MBEDTLS_ERR_HKDF_BAD_INPUT_DATA;
-        }
+// computes 64-byte HMAC of data1 | data2 (data2 is optional) by cloning the pre-computed inner and outer states
 
-        hash_len = mbedtls_md_get_size(md);
+static void hmacFinish(const hmacState_t *hs,
+                       const uint8_t *data1,
+                       size_t len1,
+                       const uint8_t *data2,
+                       size_t len2,
+                       uint8_t *mac)
+{
+    mbedtls_sha512_context ctx;
+    uint8_t innerHash[64];
 
-        if (hash_len == 0) {
-            return MBEDTLS_ERR_HKDF_BAD_INPUT_DATA;
-        }
+    mbedtls_sha512_init(&ctx);
 
-        salt = null_salt;
-        salt_len = hash_len;
-    }
+    mbedtls_sha512_clone(&ctx, &hs->inner);
+    mbedtls_sha512_update_ret(&ctx, data1, len1);
+    if (len2)
+        mbedtls_sha512_update_ret(&ctx, data2, len2);
+    mbedtls_sha512_finish_ret(&ctx, innerHash);
 
-    return (mbedtls_md_hmac(md, salt, salt_len, ikm, ikm_len, prk));
+    mbedtls_sha512_clone(&ctx, &hs->outer);
+    mbedtls_sha512_update_ret(&ctx, innerHash, sizeof(innerHash));
+    mbedtls_sha512_finish_ret(&ctx, mac);
+
+    mbedtls_sha512_free(&ctx);
+    mbedtls_platform_zeroize(innerHash, sizeof(innerHash));
 }
 
-int mbedtls_hkdf_expand(const mbedtls_md_info_t *md,
-                        const unsigned char *prk,
-                        size_t prk_len,
-                        const unsigned char *info,
-                        size_t info_len,
-                        unsigned char *okm,
-                        size_t okm_len)
+//////////////////////////////////////
+
+// HKDF-Extract followed by HKDF-Expand of one or two 32-byte keys.  Since only 32 bytes are needed, each expansion is
+// the first half of T(1) = HMAC(PRK, info | 0x01), and the PRK key schedule is computed once for both keys
+
+static void derive(const hmacState_t *saltState,
+                   uint8_t *inputKey,
+                   int inputLen,
+                   uint8_t *outputKey1,
+                   const char *info1,
+                   uint8_t *outputKey2,
+                   const char *info2)
 {
-    size_t hash_len;
-    size_t where = 0;
-    size_t n;
-    size_t t_len = 0;
-    size_t i;
-    int ret = 0;
-    mbedtls_md_context_t ctx;
-    unsigned char t[MBEDTLS_MD_MAX_SIZE];
-
-    if (okm == NULL) {
-        return (MBEDTLS_ERR_HKDF_BAD_INPUT_DATA);
-    }
+    uint8_t prk[64];
+    uint8_t t[64];
+    const uint8_t counter = 1;
+    hmacState_t prkState;
 
-    hash_len = mbedtls_md_get_size(md);
+    hmacFinish(saltState, inputKey, inputLen, NULL, 0, prk);  // PRK = HMAC(salt, inputKey)
+    hmacStart(&prkState, prk, sizeof(prk));
 
-    if (prk_len < hash_len || hash_len == 0) {
-        return (MBEDTLS_ERR_HKDF_BAD_INPUT_DATA);
-    }
+    hmacFinish(&prkState, (const uint8_t *)info1, strlen(info1), &counter, 1, t);
+    memcpy(outputKey1, t, 32);
 
-    if (info == NULL) {
-        info = (const unsigned char *)"";
-        info_len = 0;
+    if (outputKey2) {
+        hmacFinish(&prkState, (const uint8_t *)info2, strlen(info2), &counter, 1, t);
+        memcpy(outputKey2, t, 32);
     }
 
-    n = okm_len / hash_len;
+    hmacFree(&prkState);
+    mbedtls_platform_zeroize(prk, sizeof(prk));
+    mbedtls_platform_zeroize(t, sizeof(t));
+}
 
-    if (okm_len % hash_len != 0) {
-        n++;
-    }
+//////////////////////////////////////
 
-    /*
-     * Per RFC 5869 Section 2.3, okm_len must not exceed
-     * 255 times the hash length
-     */
-    if (n > 255) {
-        return (MBEDTLS_ERR_HKDF_BAD_INPUT_DATA);
+static const hmacState_t *findSalt(const char *salt)
+{
+    HKDF::init();
+
+    for (int i = 0; i < nFixedSalts; i++) {
+        if (!strcmp(salt, fixedSalts[i]))
+            return (saltStates + i);
     }
 
-    mbedtls_md_init(&ctx);
+    return (NULL);
+}
 
-    if ((ret = mbedtls_md_setup(&ctx, md, 1)) != 0) {
-        goto exit;
-    }
+/////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////////
 
-    memset(t, 0, hash_len);
-
-    /*
-     * Compute T = T(1) | T(2) | T(3) | ... | T(N)
-     * Where T(N) is defined in RFC 5869 Section 2.3
-     */
-    for (i = 1; i <= n; i++) {
-        size_t num_to_copy;
-        unsigned char c = i & 0xff;
-
-        ret = mbedtls_md_hmac_starts(&ctx, prk, prk_len);
-        if (ret != 0) {
-            goto exit;
-        }
-
-        ret = mbedtls_md_hmac_update(&ctx, t, t_len);
-        if (ret != 0) {
-            goto exit;
-        }
-
-        ret = mbedtls_md_hmac_update(&ctx, info, info_len);
-        if (ret != 0) {
-            goto exit;
-        }
-
-        /* The constant concatenated to the end of each T(n) is a single octet.
-         * */
-        ret = mbedtls_md_hmac_update(&ctx, &c, 1);
-        if (ret != 0) {
-            goto exit;
-        }
-
-        ret = mbedtls_md_hmac_finish(&ctx, t);
-        if (ret != 0) {
-            goto exit;
-        }
-
-        num_to_copy = i != n ? hash_len : okm_len - where;
-        memcpy(okm + where, t, num_to_copy);
-        where += hash_len;
-        t_len = hash_len;
+void HKDF::init()
+{
+    if (saltStatesReady)
+        return;
+
+    for (int i = 0; i < nFixedSalts; i++)
+        hmacStart(saltStates + i, (const uint8_t *)fixedSalts[i], strlen(fixedSalts[i]));
+
+    saltStatesReady = true;
+}
+
+//////////////////////////////////////
+
+int HKDF::create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, const char *salt, const char *info)
+{
+    return (createPair(outputKey, info, NULL, NULL, inputKey, inputLen, salt));
+}
+
+//////////////////////////////////////
+
+int HKDF::create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, const uint8_t *salt, size_t saltLen,
+                 const char *info)
+{
+    hmacState_t saltState;  // binary salts are not fixed, so key schedule must be computed each time
+
+    hmacStart(&saltState, salt, saltLen);
+    derive(&saltState, inputKey, inputLen, outputKey, info, NULL, NULL);
+    hmacFree(&saltState);
+    return (0);
+}
+
+//////////////////////////////////////
+
+int HKDF::createPair(uint8_t *outputKey1, const char *info1, uint8_t *outputKey2, const char *info2,
+                     uint8_t *inputKey, int inputLen, const char *salt)
+{
+    const hmacState_t *fixedState = findSalt(salt);
+
+    if (fixedState) {
+        derive(fixedState, inputKey, inputLen, outputKey1, info1, outputKey2, info2);
+        return (0);
     }
 
-exit:
-    mbedtls_md_free(&ctx);
-    mbedtls_platform_zeroize(t, sizeof(t));
+    hmacState_t saltState;  // salt is not one of HAP's fixed salts, so key schedule must be computed here
 
-    return (ret);
+    hmacStart(&saltState, (const uint8_t *)salt, strlen(salt));
+    derive(&saltState, inputKey, inputLen, outputKey1, info1, outputKey2, info2);
+    hmacFree(&saltState);
+    return (0);
 }
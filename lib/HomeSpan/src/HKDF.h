@@ -32,15 +32,35 @@
 /////////////////////////////////////////////////
 // HKDF-SHA-512 Structure
 //
-// This is a wrapper around mbedtls_hkdf, which is NOT
-// included in the normal Arduino-ESP32 library.
-// Code was instead sourced directly from MBED GitHub and
-// incorporated under hkdf.cpp, with a wrapper to always
-// use SHA-512 with 32 bytes of output as required by HAP.
+// HKDF (RFC 5869) is NOT included in the mbedtls library
+// of Arduino-ESP32, so it is implemented in HKDF.cpp
+// directly on the SHA-512 primitives, always producing
+// 32 bytes of output as required by HAP.
+//
+// Since HAP always uses the same handful of constant salts,
+// the HMAC-SHA-512 key schedule (the SHA-512 states after
+// absorbing the inner and outer padded salt) is computed once
+// for each of these salts in init() and re-used thereafter.
 
 namespace HKDF {
 
+// pre-computes the HMAC-SHA-512 states for HAP's fixed salts (called once at start-up)
+void init();
+
 // output of HKDF is always a 32-byte key derived from an input key, a salt string, and an info string
 int create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, const char *salt, const char *info);
 
+// same as above, but with a binary salt of specified length (used by pair-resume, where salt = PublicKey | SessionID)
+int create(uint8_t *outputKey, uint8_t *inputKey, int inputLen, const uint8_t *salt, size_t saltLen, const char *info);
+
+// derives two 32-byte keys from the same input key and salt string in a single pass, differing only by their info
+// strings (e.g. the read and write Control keys), which shares the HKDF-Extract step and the resulting key schedule
+int createPair(uint8_t *outputKey1,
+               const char *info1,
+               uint8_t *outputKey2,
+               const char *info2,
+               uint8_t *inputKey,
+               int inputLen,
+               const char *salt);
+
 };  // namespace HKDF
@@ -80,6 +80,8 @@ void Span::begin(Category catID, const char *_displayName, const char *_hostName
 {
     loopTaskHandle = xTaskGetCurrentTaskHandle();  // a roundabout way of getting the current task handle
 
+    SpanLog::begin(DEFAULT_LOG_BUFFER_SIZE);  // start deferring LOG1() and LOG2() messages to the log task
+
     asprintf(&displayName, "%s", _displayName);
     asprintf(&hostNameBase, "%s", _hostNameBase);
     asprintf(&modelName, "%s", _modelName);
@@ -93,6 +95,9 @@ void Span::begin(Category catID, const char *_displayName, const char *_hostName
 
     hapServer = new WiFiServer(tcpPortNum);  // create HAP WIFI SERVER
 
+    if (updateQueueSize)
+        updateQueue.begin<SpanCharacteristic::asyncUpdate_t>(updateQueueSize);
+
     size_t len;
 
     if (strlen(network.wifiData.ssid)) {  // if setWifiCredentials was already called
@@ -187,6 +192,8 @@ void Span::poll()
 
 void Span::pollTask()
 {
+    uint32_t pollStart = micros();  // for poll-loop metrics
+
     if (!strlen(category)) {
         LOG0(
             "\n** FATAL ERROR: Cannot start homeSpan polling without an initial call to homeSpan.begin()!\n** PROGRAM "
@@ -227,10 +234,14 @@ void Span::pollTask()
 
     }  // isInitialized
 
+    SpanStalls::start();
+
     if (strlen(network.wifiData.ssid) > 0) {
         checkConnect();
     }
 
+    SpanStalls::mark(SpanStalls::CONNECT);
+
     char cBuf[65] = "?";
 
     if (!serialInputDisabled && Serial.available()) {
@@ -238,6 +249,8 @@ void Span::pollTask()
         processSerialCommand(cBuf);
     }
 
+    SpanStalls::mark(SpanStalls::SERIAL_CMD);
+
     if (hapServer->hasClient()) {
         auto it = hapList.emplace(hapList.begin());  // create new HAPClient connection
         it->client = hapServer->available();
@@ -252,16 +265,25 @@ void Span::pollTask()
         LOG2("\n");
     }
 
+    SpanStalls::mark(SpanStalls::ACCEPT);
+
+    boolean clientsIdle = true;  // set to false if any client sends a request during this poll
+
     currentClient = hapList.begin();
     while (currentClient != hapList.end()) {
         if (currentClient->client.connected()) {      // if the client is connected
             if (currentClient->client.available()) {  // if client has data available
-                homeSpan.lastClientIP =
-                    currentClient->client.remoteIP().toString();  // store IP Address for web logging
-                currentClient->processRequest();                  // PROCESS HAP REQUEST
-                homeSpan.lastClientIP = "0.0.0.0";                // reset stored IP address to show "0.0.0.0" if
-                                                                  // homeSpan.getClientIP() is used in any other context
+                clientsIdle = false;
+                homeSpan.lastClientIP = currentClient->client.remoteIP();  // store IP Address for web logging
+                SpanMetrics::route = SpanMetrics::OTHER;  // set by processRequest() once request is parsed
+                uint32_t requestStart = micros();         // for request latency metrics
+                currentClient->processRequest();          // PROCESS HAP REQUEST
+                SpanMetrics::requests[SpanMetrics::route].add(micros() - requestStart);
+                requestArena.reset();       // release all buffers used by request
+                homeSpan.lastClientIP = 0;  // reset stored IP address to show "0.0.0.0" in any other context
             }
+            if (currentClient->logEnd)  // continue streaming Web Log entries requested with <status-url>/log
+                currentClient->streamLog();
             currentClient++;
         } else {
             LOG1("** Client #%d DISCONNECTED (%lu sec)\n", currentClient->clientNumber, millis() / 1000);
@@ -270,20 +292,42 @@ void Span::pollTask()
         }
     }
 
+    SpanStalls::mark(SpanStalls::REQUESTS);
+
+    if (clientsIdle)
+        HAPClient::preGenerateKeys();  // use idle time to prepare ephemeral keys for the next pair-setup/pair-verify
+
+    SpanStalls::mark(SpanStalls::KEYGEN);
+
     snapTime = millis();  // snap the current time for use in ALL loop routines
 
-    for (auto it = Loops.begin(); it != Loops.end(); it++)
-        (*it)->loop();  // call loop() for all Services with over-ridden loop() methods
+    freeRetiredValues();  // strings returned by getString() in other tasks remain valid for one pass of pollTask()
+    checkUpdates();       // apply any updates queued by other tasks or ISRs
+    checkWrites();        // call update() for Services with coalesced writes that are due
+
+    SpanStalls::mark(SpanStalls::UPDATES);
+
+    runLoops();  // call loop() for all Services with over-ridden loop() methods that are due
+    SpanStalls::mark(SpanStalls::LOOPS);
+
+    checkReads();  // refresh expired values of subscribed Characteristics that have read callbacks
+    SpanStalls::mark(SpanStalls::READS);
 
     for (auto it = PushButtons.begin(); it != PushButtons.end(); it++)
         (*it)->check();  // check for SpanButton presses
 
+    SpanStalls::mark(SpanStalls::BUTTONS);
+
     HAPClient::checkNotifications();
     HAPClient::checkTimedWrites();
 
+    SpanStalls::mark(SpanStalls::NOTIFY);
+
     if (spanOTA.enabled)
         ArduinoOTA.handle();
 
+    SpanStalls::mark(SpanStalls::OTA);
+
     if (controlButton && controlButton->primed())
         STATUS_UPDATE(start(LED_ALERT), HS_ENTERING_CONFIG_MODE)
 
@@ -307,6 +351,10 @@ void Span::pollTask()
         nvs_commit(wifiNVS);
     }
 
+    SpanStalls::mark(SpanStalls::CONTROL);
+
+    SpanMetrics::pollTime.add(micros() - pollStart);
+
 }  // poll
 
 //////////////////////////////////////
@@ -604,7 +652,7 @@ void Span::processSerialCommand(const char *c)
                     HAPClient::charPrintRow((*it).cPair->getID(), 36);
                     LOG0("%s\n", (*it).cPair->isAdmin() ? "   (admin)\n" : " (regular)\n");
                 } else {
-                    LOG0("  (unverified)\n");
+                    LOG0("  (unverified%s)\n", (*it).temp ? ", pair-verify in progress" : "");
                 }
             }
 
@@ -791,6 +839,14 @@ void Span::processSerialCommand(const char *c)
             LOG0("\n*** Log Level set to %d\n\n", level);
         } break;
 
+        case 'b': {
+            SpanStalls::print();
+            if (!strcmp(c + 1 + strspn(c + 1, " "), "clear")) {
+                SpanStalls::reset();
+                LOG0("Table of longest stalls cleared\n\n");
+            }
+        } break;
+
         case 'm': {
             multi_heap_info_t heapAll;
             multi_heap_info_t heapInternal;
@@ -800,6 +856,7 @@ void Span::processSerialCommand(const char *c)
             heap_caps_get_info(&heapInternal, MALLOC_CAP_DEFAULT | MALLOC_CAP_INTERNAL);
             heap_caps_get_info(&heapPSRAM, MALLOC_CAP_DEFAULT | MALLOC_CAP_SPIRAM);
 
+            SpanLog::flush();  // table below is printed synchronously
             Serial.printf("\n            Allocated      Free   Largest       Low\n");
             Serial.printf("            --------- --------- --------- ---------\n");
             Serial.printf("Total Heap: %9d %9d %9d %9d\n", heapAll.total_allocated_bytes, heapAll.total_free_bytes,
@@ -810,6 +867,21 @@ void Span::processSerialCommand(const char *c)
             Serial.printf("     PSRAM: %9d %9d %9d %9d\n\n", heapPSRAM.total_allocated_bytes,
                           heapPSRAM.total_free_bytes, heapPSRAM.largest_free_block, heapPSRAM.minimum_free_bytes);
 
+            if (heapInternal.total_free_bytes)  // fragmentation = share of free internal heap not in largest block
+                LOG0("Internal Heap Fragmentation: %d%%\n",
+                     100 - (int)(100ULL * heapInternal.largest_free_block / heapInternal.total_free_bytes));
+            LOG0("Client Slots: %d of %d used, %d heap fallbacks\n", ClientAllocator::pool::used(),
+                 ClientAllocator::pool::capacity(), ClientAllocator::pool::fallbacks);
+            LOG0("Request Arena: %d bytes, %d high-water, %d overflows\n", requestArena.getCapacity(),
+                 requestArena.getHighWater(), requestArena.getOverflows());
+
+            LOG0("HAP Connections: %d open, %d bytes per connection\n", hapList.size(), sizeof(HAPClient));
+            LOG0("Pair-Verify Pool: %d of %d slots in use, %d heap fallbacks, %d bytes per slot\n\n",
+                 Utils::PairVerifyPool<HAPClient>::used(), HAPClient::MAX_PAIR_VERIFY, HAPClient::tempFallbacks,
+                 sizeof(HAPClient::tempKeys_t));
+
+            hs_memReport();
+
             if (getAutoPollTask())
                 LOG0("Lowest stack level: %d bytes (%s)\n", uxTaskGetStackHighWaterMark(getAutoPollTask()),
                      pcTaskGetName(getAutoPollTask()));
@@ -821,6 +893,16 @@ void Span::processSerialCommand(const char *c)
                  nvs_stats.total_entries - 126);
         } break;
 
+#ifdef HS_TRACE
+        case 'T': {
+            LOG0("\n*** Stage Trace (Chrome trace JSON) ***\n\n");
+            hapOut.setLogLevel(0);  // print to Serial only
+            SpanTrace::print(hapOut);
+            hapOut.flush();
+            LOG0("\n\n*** End Trace ***\n\n");
+        } break;
+#endif
+
         case 'i': {
             LOG0("\n*** HomeSpan Info ***\n\n");
 
@@ -1144,6 +1226,11 @@ void Span::processSerialCommand(const char *c)
             LOG0("  i - print summary information about the HAP Database\n");
             LOG0("  d - print the full HAP Accessory Attributes Database in JSON format\n");
             LOG0("  m - print free heap memory\n");
+            LOG0("  b - print longest blocking phases of pollTask()\n");
+            LOG0("  b clear - print and then clear table of longest blocking phases\n");
+#ifdef HS_TRACE
+            LOG0("  T - print stage trace as Chrome trace JSON\n");
+#endif
             LOG0("\n");
             LOG0("  W - configure WiFi Credentials and restart\n");
             LOG0("  X - delete WiFi Credentials and restart\n");
@@ -1318,6 +1405,7 @@ Span &Span::setPairingCode(const char *s, boolean progCall)
                           verifyData);  // create random salt and compute verification code from specified Setup Code
     nvs_set_blob(srpNVS, "VERIFYDATA", verifyData, verifyData.len());  // update data
     nvs_commit(srpNVS);                                                // commit to NVS
+    HAPClient::srpKeyVersion++;  // any pre-generated SRP key was based on the prior verification data
 
     if (!progCall)
         LOG0("New Code Saved!\nSetup Payload for Optional QR Code: %s\n\n",
@@ -1368,6 +1456,7 @@ boolean Span::deleteAccessory(uint32_t n)
         return (false);
 
     delete *it;
+    clearQueryPlans();
     return (true);
 }
 
@@ -1422,6 +1511,8 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj)
     int cFound = 0;
     boolean twFail = false;
 
+    HS_TRACE_BEGIN(parse, "parse");
+
     while (char *t1 = strtok_r(buf, "{", &p1)) {  // parse 'buf' and extract objects into 'pObj' unless NULL
         buf = NULL;
         char *p2;
@@ -1481,8 +1572,14 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj)
 
     }  // parse objects
 
+    HS_TRACE_END(parse);
+
     snapTime = millis();  // timestamp for this series of updates, assigned to each characteristic in loadUpdate()
 
+    beginBatch();  // defer NVS commit until all objects have been updated
+
+    HS_TRACE_BEGIN(find, "find");
+
     for (int i = 0; i < nObj;
          i++) {  // PASS 1: loop over all objects, identify characteristics, and initialize update for those found
 
@@ -1504,13 +1601,43 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj)
 
     }  // first pass
 
+    HS_TRACE_END(find);
+
     for (int i = 0; i < nObj; i++) {              // PASS 2: loop again over all objects
         if (pObj[i].status == StatusCode::TBD) {  // if object status still TBD
 
+            SpanService *svc = pObj[i].characteristic->service;
+
+            boolean coalesce = svc->writeWindow.enabled();
+            for (int j = i; j < nObj && coalesce; j++) {
+                if (pObj[j].characteristic && pObj[j].characteristic->service == svc && pObj[j].wr)
+                    coalesce = false;  // write-response requires update() to be called right away
+            }
+
+            if (coalesce) {  // acknowledge writes now, but hold update() until write-coalescing window closes
+                for (int j = i; j < nObj; j++) {
+                    if (pObj[j].characteristic && pObj[j].characteristic->service == svc &&
+                        pObj[j].status == StatusCode::TBD) {
+                        pObj[j].status = StatusCode::OK;
+                        Utils::HeldWrites<SpanCharacteristic>::hold(pObj[j].characteristic);
+                        SpanMetrics::writesCoalesced++;
+                        LOG1("Coalescing aid=%u iid=%u\n", pObj[j].characteristic->aid, pObj[j].characteristic->iid);
+                    }
+                }
+                if (svc->writeWindow.hold(snapTime))  // start window with first write
+                    PendingWrites.push_back(svc);
+                continue;
+            }
+
+            if (svc->writeWindow.isPending())  // update() also processes any earlier writes still held in window
+                releaseWrites(svc);
+
+            HS_TRACE_BEGIN(update, "update");
             StatusCode status = pObj[i].characteristic->service->update()
                                     ? StatusCode::OK
                                     : StatusCode::Unable;  // update service and save statusCode as OK or Unable
                                                            // depending on whether return is true or false
+            HS_TRACE_END(update);
 
             for (int j = i; j < nObj; j++) {  // loop over this object plus any remaining objects to update values and
                                               // save status for any other characteristics in this service
@@ -1520,22 +1647,8 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj)
                                                         // updated
                     pObj[j].status = status;            // save statusCode for this object
                     LOG1("Updating aid=%u iid=%u", pObj[j].characteristic->aid, pObj[j].characteristic->iid);
-                    if (status == StatusCode::OK) {  // if status is okay
-                        pObj[j].characteristic->uvSet(
-                            pObj[j].characteristic->value,
-                            pObj[j].characteristic->newValue);  // update characteristic value with new value
-                        if (pObj[j].characteristic->nvsKey) {   // if storage key found
-                            if (pObj[j].characteristic->format < FORMAT::STRING)
-                                nvs_set_u64(
-                                    charNVS, pObj[j].characteristic->nvsKey,
-                                    pObj[j].characteristic->value.UINT64);  // store data as uint64_t regardless of
-                                                                            // actual type (it will be read correctly
-                                                                            // when access through uvGet())
-                            else
-                                nvs_set_str(charNVS, pObj[j].characteristic->nvsKey,
-                                            pObj[j].characteristic->value.STRING);  // store data
-                            nvs_commit(charNVS);
-                        }
+                    if (status == StatusCode::OK) {                // if status is okay
+                        pObj[j].characteristic->commitNewValue();  // update characteristic value with new value
                         LOG1(" (okay)\n");
                     } else {  // if status not okay
                         pObj[j].characteristic->uvSet(
@@ -1547,14 +1660,90 @@ int Span::updateCharacteristics(char *buf, SpanBuf *pObj)
                 }
             }
 
+            if (svc->writeWindow.isPending()) {  // commit or revert earlier writes released above
+                finishWrites(svc, status == StatusCode::OK);
+                PendingWrites.erase(std::find(PendingWrites.begin(), PendingWrites.end(), svc));
+            }
+
         }  // object had TBD status
     }  // loop over all objects
 
+    commitBatch();
+
     return (1);
 }
 
 ///////////////////////////////
 
+void Span::commitCharNVS()
+{
+    if (batchDepth) {
+        batchCommitNVS = true;  // defer until outermost batch is committed
+    } else {
+        HS_TRACE_SCOPE("nvs");
+        nvs_commit(charNVS);
+        SpanMetrics::nvsCommits++;
+    }
+}
+
+///////////////////////////////
+
+void Span::checkUpdates()
+{
+    if (!updateQueue)
+        return;
+
+    SpanCharacteristic::asyncUpdate_t update;
+
+    beginBatch();  // combine all queued updates into a single NVS commit
+
+    while (updateQueue.receive(update))
+        update.characteristic->setValQueued(update.value, update.notify, update.fromPin);
+
+    commitBatch();
+}
+
+///////////////////////////////
+
+void Span::freeRetiredValues()
+{
+    for (auto old : retiredValues)
+        hs_free(old, HS_MEM_VALUES);
+    retiredValues.clear();
+}
+
+///////////////////////////////
+
+Span &Span::beginBatch()
+{
+    batchDepth++;
+    return (*this);
+}
+
+///////////////////////////////
+
+Span &Span::commitBatch()
+{
+    if (!batchDepth) {
+        LOG0("\n*** WARNING:  commitBatch() called without a matching beginBatch().  Ignoring request.\n\n");
+        return (*this);
+    }
+
+    if (--batchDepth)  // still inside an outer batch
+        return (*this);
+
+    if (batchCommitNVS) {  // single NVS commit for all values stored during batch
+        HS_TRACE_SCOPE("nvs");
+        nvs_commit(charNVS);
+        SpanMetrics::nvsCommits++;
+        batchCommitNVS = false;
+    }
+
+    return (*this);
+}
+
+///////////////////////////////
+
 void Span::clearNotify(HAPClient *hc)
 {
     for (auto const &acc : Accessories)
@@ -1565,6 +1754,16 @@ void Span::clearNotify(HAPClient *hc)
 
 ///////////////////////////////
 
+void Span::clearNotifications()
+{
+    for (auto nb = Notifications.begin(); nb != Notifications.end(); nb++)
+        nb->characteristic->notifyPending = false;  // allow Characteristic to be queued again
+
+    Notifications.clear();
+}
+
+///////////////////////////////
+
 void Span::printfNotify(SpanBuf *pObj, int nObj, HAPClient *hc)
 {
     boolean notifyFlag = false;
@@ -1600,8 +1799,10 @@ void Span::printfAttributes(SpanBuf *pObj, int nObj)
 
     for (int i = 0; i < nObj; i++) {
         hapOut << "{\"aid\":" << pObj[i].aid << ",\"iid\":" << pObj[i].iid << ",\"status\":" << (int)pObj[i].status;
-        if (pObj[i].status == StatusCode::OK && pObj[i].wr && pObj[i].characteristic)
-            hapOut << ",\"value\":" << pObj[i].characteristic->uvPrint(pObj[i].characteristic->value).c_str();
+        if (pObj[i].status == StatusCode::OK && pObj[i].wr && pObj[i].characteristic) {
+            SpanCharacteristic::UVal v = pObj[i].characteristic->snapValue();
+            hapOut << ",\"value\":" << pObj[i].characteristic->uvPrint(v).c_str();
+        }
         hapOut << "}";
         if (i + 1 < nObj)
             hapOut << ",";
@@ -1612,53 +1813,166 @@ void Span::printfAttributes(SpanBuf *pObj, int nObj)
 
 ///////////////////////////////
 
-boolean Span::printfAttributes(char **ids, int numIDs, int flags)
+static uint32_t queryHash(const char *query)
+{
+    uint32_t hash = 2166136261;  // FNV-1a offset basis
+    while (*query) {
+        hash ^= (uint8_t)(*query++);
+        hash *= 16777619;  // FNV-1a prime
+    }
+    return (hash);
+}
+
+///////////////////////////////
+
+SpanQueryPlan *Span::findQueryPlan(const char *query)
 {
-    uint32_t aid;
-    uint32_t iid;
+    if (!queryCacheSize)  // cache disabled
+        return (NULL);
+
+    uint32_t hash = queryHash(query);
+
+    for (auto plan = queryPlans.begin(); plan != queryPlans.end(); plan++) {
+        if (plan->hash == hash && !strcmp(plan->query.data(), query)) {  // confirm match on full query string
+            plan->lastUsed = ++queryClock;
+            return (&(*plan));
+        }
+    }
+
+    return (NULL);
+}
+
+///////////////////////////////
+
+SpanQueryPlan *Span::createQueryPlan(const char *query, char **ids, int numIDs, int flags)
+{
+    SpanQueryPlan *plan;
+
+    if (queryPlans.size() < (queryCacheSize ? queryCacheSize : 1)) {  // room for a new plan (always keep one slot)
+        queryPlans.emplace_back();
+        plan = &queryPlans.back();
+    } else {  // else re-use least-recently-used plan
+        plan = &queryPlans.front();
+        for (auto p = queryPlans.begin(); p != queryPlans.end(); p++)
+            if (p->lastUsed < plan->lastUsed)
+                plan = &(*p);
+    }
 
-    SpanCharacteristic *Characteristics[numIDs];
-    StatusCode status[numIDs];
+    plan->hash = queryHash(query);
+    plan->query.assign(query, query + strlen(query) + 1);
+    plan->lastUsed = ++queryClock;
+    plan->bodyValid = false;
+    plan->items.resize(numIDs);
 
-    for (int i = 0; i < numIDs; i++) {  // PASS 1: loop over all ids requested to check status codes - only errors are
-                                        // if characteristic not found, or not readable
-        sscanf(ids[i], "%u.%u", &aid, &iid);  // parse aid and iid
-        Characteristics[i] = find(aid, iid);  // find matching chararacteristic
+    for (int i = 0; i < numIDs; i++) {  // loop over all ids requested to resolve Characteristics and status codes -
+                                        // only errors are if characteristic not found, or not readable
+        SpanQueryPlan::item_t *item = &plan->items[i];
+        item->aid = 0;
+        item->iid = 0;
+        sscanf(ids[i], "%u.%u", &item->aid, &item->iid);   // parse aid and iid
+        item->characteristic = find(item->aid, item->iid);  // find matching chararacteristic
 
-        if (Characteristics[i]) {                         // if found
-            if (Characteristics[i]->perms & PERMS::PR) {  // if permissions allow reading
-                status[i] = StatusCode::OK;  // always set status to OK (since no actual reading of device is needed)
+        if (item->characteristic) {                         // if found
+            if (item->characteristic->perms & PERMS::PR) {  // if permissions allow reading
+                item->status = StatusCode::OK;  // always set status to OK (since no actual reading of device is needed)
             } else {
-                Characteristics[i] = NULL;  // set to NULL to trigger not-found in Pass 2 below
-                status[i] = StatusCode::WriteOnly;
+                item->characteristic = NULL;  // set to NULL to trigger not-found when printing
+                item->status = StatusCode::WriteOnly;
                 flags |= GET_STATUS;  // update flags to require status attribute for all characteristics
             }
         } else {
-            status[i] = StatusCode::UnknownResource;
+            item->status = StatusCode::UnknownResource;
             flags |= GET_STATUS;  // update flags to require status attribute for all characteristics
         }
     }
 
-    hapOut << "{\"characteristics\":[";
+    plan->flags = flags;
+    return (plan);
+}
 
-    for (int i = 0; i < numIDs; i++) {  // PASS 2: loop over all ids requested and create JSON for each (either all
-                                        // with, or all without, a status attribute based on final flags setting)
+///////////////////////////////
 
-        if (Characteristics[i])  // if found
-            Characteristics[i]->printfAttributes(
-                flags);  // get JSON attributes for characteristic (may or may not include status=0 attribute)
-        else {           // else create JSON status attribute based on requested aid/iid
-            sscanf(ids[i], "%u.%u", &aid, &iid);
-            hapOut << "{\"iid\":" << iid << ",\"aid\":" << aid << ",\"status\":" << (int)status[i] << "}";
-        }
+void Span::clearQueryPlans()
+{
+    queryPlans.clear();
+    queryPlans.shrink_to_fit();
+}
 
-        if (i + 1 < numIDs)
+///////////////////////////////
+
+boolean Span::printfAttributes(SpanQueryPlan *plan)
+{
+    hapOut << "{\"characteristics\":[";
+
+    for (auto item = plan->items.begin(); item != plan->items.end(); item++) {  // loop over all ids in plan and create
+                                                                                // JSON for each (either all with, or
+                                                                                // all without, a status attribute)
+        if (item != plan->items.begin())
             hapOut << ",";
+
+        if (item->characteristic)  // if found
+            item->characteristic->printfAttributes(
+                plan->flags);  // get JSON attributes for characteristic (may or may not include status=0 attribute)
+        else                   // else create JSON status attribute based on requested aid/iid
+            hapOut << "{\"iid\":" << item->iid << ",\"aid\":" << item->aid << ",\"status\":" << (int)item->status
+                   << "}";
     }
 
     hapOut << "]}";
 
-    return (flags & GET_STATUS);
+    return (plan->flags & GET_STATUS);
+}
+
+///////////////////////////////
+
+void Span::renderQueryPlan(SpanQueryPlan *plan)
+{
+    HS_TRACE_SCOPE("render");
+
+    if (plan->bodyValid) {
+        if (plan->bodySeq == changeSeq)  // nothing has changed anywhere since body was rendered
+            return;
+
+        auto item = plan->items.begin();
+        while (item != plan->items.end() &&
+               (!item->characteristic || item->characteristic->changeSeq <= plan->bodySeq))
+            item++;
+
+        if (item == plan->items.end()) {  // none of the Characteristics in this plan changed
+            plan->bodySeq = changeSeq;
+            return;
+        }
+    }
+
+    plan->body.clear();
+
+    hapOut.setCallback([](const char *buf, void *arg) {
+        if (buf) {
+            auto body = (decltype(SpanQueryPlan::body) *)arg;
+            body->insert(body->end(), buf, buf + strlen(buf));
+        }
+    });
+    hapOut.setCallbackUserData(&plan->body);
+    printfAttributes(plan);
+    hapOut.flush();
+
+    // body can only be re-used for plain value reads, since ev depends on the client and metadata (e.g. ranges) can
+    // change without a new value being set
+    plan->bodySeq = changeSeq;
+    plan->bodyValid = !(plan->flags & (GET_EV | GET_META | GET_PERMS | GET_TYPE | GET_DESC));
+}
+
+///////////////////////////////
+
+int Span::getChanges(uint32_t since, void (*f)(SpanCharacteristic *, void *), void *user_data)
+{
+    int n = 0;
+
+    for (SpanCharacteristic *chr = lastChanged; chr && chr->changeSeq > since; chr = chr->nextChanged, n++)
+        if (f)
+            f(chr, user_data);
+
+    return (n);
 }
 
 ///////////////////////////////
@@ -1689,6 +2003,8 @@ Span &Span::resetIID(uint32_t newIID)
 
 boolean Span::updateDatabase(boolean updateMDNS)
 {
+    clearQueryPlans();  // cached query plans may reference Characteristics that no longer exist, or miss new ones
+
     printfAttributes(GET_META | GET_PERMS | GET_TYPE |
                      GET_DESC);  // stream attributes database, which automtically produces a SHA-384 hash
     hapOut.flush();
@@ -1720,18 +2036,131 @@ boolean Span::updateDatabase(boolean updateMDNS)
             "\n*** WARNING: NVS is running low on space.  Try erasing with 'E'.  If that fails, increase size of NVS "
             "partition or reduce NVS usage.\n\n");
 
+    scheduleLoops();
+
+    return (changed);
+}
+
+///////////////////////////////
+
+void Span::scheduleLoops()
+{
     Loops.clear();
+    LoopTimers.clear();
 
     for (auto acc = Accessories.begin(); acc != Accessories.end();
          acc++) {  // identify all services with over-ridden loop() methods
         for (auto svc = (*acc)->Services.begin(); svc != (*acc)->Services.end(); svc++) {
             if ((void (*)())((*svc)->*(&SpanService::loop)) !=
-                (void (*)())(&SpanService::loop))  // save pointers to services in Loops vector
-                homeSpan.Loops.push_back((*svc));
+                (void (*)())(&SpanService::loop)) {  // save pointers to services in Loops or LoopTimers vector
+                if ((*svc)->loopPeriod)
+                    LoopTimers.push_back((*svc));
+                else
+                    Loops.push_back((*svc));
+            }
         }
     }
 
-    return (changed);
+    std::make_heap(LoopTimers.begin(), LoopTimers.end(), Utils::LoopHeap<SpanService>::after);
+    loopsChanged = false;
+}
+
+///////////////////////////////
+
+void Span::runLoops()
+{
+    if (loopsChanged)  // a loop period was changed since last poll
+        scheduleLoops();
+
+    for (auto it = Loops.begin(); it != Loops.end(); it++)
+        (*it)->loop();  // call loop() for all Services that loop on every poll
+
+    Utils::LoopHeap<SpanService>::runDue(LoopTimers, snapTime, [this](SpanService *svc) {
+        svc->loop();
+        return (!loopsChanged);  // stop if loop() changed a loop period - heap will be rebuilt on next poll
+    });
+}
+
+///////////////////////////////
+
+void Span::checkWrites()
+{
+    if (PendingWrites.empty())
+        return;
+
+    beginBatch();  // combine NVS commits for all Services updated below
+
+    auto it = PendingWrites.begin();
+    while (it != PendingWrites.end()) {
+        SpanService *svc = *it;
+
+        if (!svc->writeWindow.due(snapTime)) {  // window is still open
+            it++;
+            continue;
+        }
+
+        releaseWrites(svc);
+
+        if (Utils::HeldWrites<SpanCharacteristic>::changed(svc->Characteristics)) {
+            LOG1("Updating coalesced writes for aid=%u iid=%u\n", svc->accessory->aid, svc->iid);
+            finishWrites(svc, svc->update());
+        } else {
+            LOG1("Skipping update() for aid=%u iid=%u (values unchanged)\n", svc->accessory->aid, svc->iid);
+            Utils::HeldWrites<SpanCharacteristic>::discard(svc->Characteristics);
+            svc->writeWindow.finish();
+        }
+
+        it = PendingWrites.erase(it);
+    }
+
+    commitBatch();
+}
+
+///////////////////////////////
+
+void Span::finishWrites(SpanService *svc, boolean ok)
+{
+    Utils::HeldWrites<SpanCharacteristic>::finish(svc->Characteristics, ok);
+    svc->writeWindow.finish();
+}
+
+///////////////////////////////
+
+void Span::releaseWrites(SpanService *svc)
+{
+    Utils::HeldWrites<SpanCharacteristic>::release(svc->Characteristics);
+}
+
+///////////////////////////////
+
+void Span::checkReads()
+{
+    Utils::ReadRefresh<SpanCharacteristic>::subscribed(ReadCallbacks, millis());  // only if a Controller subscribed
+}
+
+///////////////////////////////
+
+void Span::checkReads(SpanQueryPlan *plan)
+{
+    if (ReadCallbacks.empty())
+        return;
+
+    Utils::ReadRefresh<SpanCharacteristic>::requested(
+        plan->items, [](const SpanQueryPlan::item_t &item) { return (item.characteristic); }, millis());
+}
+
+///////////////////////////////
+
+unsigned long Span::timeToNextLoop()
+{
+    if (!Loops.empty() || loopsChanged)
+        return (0);
+
+    if (LoopTimers.empty())
+        return (ULONG_MAX);
+
+    long dt = LoopTimers.front()->nextLoop - millis();
+    return (dt > 0 ? dt : 0);
 }
 
 ///////////////////////////////
@@ -1845,6 +2274,17 @@ SpanService::~SpanService()
         LOG1("Deleted Loop Entry\n");
     }
 
+    if (writeWindow.isPending())  // remove from PendingWrites vector
+        homeSpan.PendingWrites.erase(std::find(homeSpan.PendingWrites.begin(), homeSpan.PendingWrites.end(), this));
+
+    for (svc = homeSpan.LoopTimers.begin(); svc != homeSpan.LoopTimers.end() && (*svc) != this; svc++)
+        ;                                    // search for entry in LoopTimers heap...
+    if (svc != homeSpan.LoopTimers.end()) {  // ...if it exists, erase it and restore heap order
+        homeSpan.LoopTimers.erase(svc);
+        std::make_heap(homeSpan.LoopTimers.begin(), homeSpan.LoopTimers.end(), Utils::LoopHeap<SpanService>::after);
+        LOG1("Deleted Loop Timer Entry\n");
+    }
+
     auto pb = homeSpan.PushButtons
                   .begin();  // loop through PushButton vector and delete ALL PushButtons associated with this Service
     while (pb != homeSpan.PushButtons.end()) {
@@ -1861,6 +2301,24 @@ SpanService::~SpanService()
 
 ///////////////////////////////
 
+SpanService *SpanService::setLoopPeriod(uint32_t period)
+{
+    loopPeriod = period;
+    nextLoop = millis();  // first call to loop() is due on next poll
+    homeSpan.loopsChanged = true;
+    return (this);
+}
+
+///////////////////////////////
+
+SpanService *SpanService::setWriteCoalescing(uint32_t window)
+{
+    writeWindow.setLength(window);
+    return (this);
+}
+
+///////////////////////////////
+
 SpanService *SpanService::setPrimary()
 {
     primary = true;
@@ -1947,19 +2405,52 @@ SpanCharacteristic::SpanCharacteristic(HapChar *hapChar, boolean isCustom)
 
 SpanCharacteristic::~SpanCharacteristic()
 {
+    homeSpan.clearQueryPlans();  // cached query plans may hold a pointer to this Characteristic
+
+    if (homeSpan.updateQueue) {  // discard (without applying) queued updates holding a pointer to this Characteristic
+        int lost = homeSpan.updateQueue.purge<asyncUpdate_t>([this](const asyncUpdate_t &u) {
+            return (u.characteristic == this);
+        });
+        if (lost)
+            LOG0("\n*** ERROR:  %d queued updates of other Characteristics lost on deleting Characteristic\n\n", lost);
+    }
+
+    if (prevChanged)  // remove from Span change list
+        prevChanged->nextChanged = nextChanged;
+    else if (homeSpan.lastChanged == this)
+        homeSpan.lastChanged = nextChanged;
+    if (nextChanged)
+        nextChanged->prevChanged = prevChanged;
+
+    if (readCallback)  // remove from ReadCallbacks vector
+        setReadCallback(NULL);
+
+    if (pinBinding) {  // stop toggle interrupts before pin binding is freed
+        pinBinding->end();
+        hs_free(pinBinding, HS_MEM_VALUES);
+    }
+
+    if (notifyPending) {  // remove from Notifications vector
+        auto nb = homeSpan.Notifications.begin();
+        while (nb->characteristic != this)
+            nb++;
+        homeSpan.Notifications.erase(nb);
+    }
+
     auto chr = service->Characteristics.begin();  // find Characteristic in containing Service vector and erase entry
     while ((*chr) != this)
         chr++;
     service->Characteristics.erase(chr);
 
-    free(desc);
-    free(unit);
-    free(validValues);
+    hs_free(desc, HS_MEM_METADATA);
+    hs_free(unit, HS_MEM_METADATA);
+    hs_free(validValues, HS_MEM_METADATA);
     free(nvsKey);
 
     if (format >= FORMAT::STRING) {
-        free(value.STRING);
-        free(newValue.STRING);
+        hs_free(value.STRING, HS_MEM_VALUES);
+        hs_free(newValue.STRING, HS_MEM_VALUES);
+        hs_free(heldValue.STRING, HS_MEM_VALUES);
     }
 
     LOG1("Deleted Characteristic AID=%u IID=%u\n", aid, iid);
@@ -2009,7 +2500,7 @@ void SpanCharacteristic::uvSet(UVal &dest, UVal &src)
 
 void SpanCharacteristic::uvSet(UVal &u, STRING_t val)
 {
-    u.STRING = (char *)HS_REALLOC(u.STRING, strlen(val) + 1);
+    u.STRING = (char *)hs_realloc(u.STRING, strlen(val) + 1, HS_MEM_VALUES);
     strcpy(u.STRING, val);
 }
 
@@ -2022,13 +2513,12 @@ void SpanCharacteristic::uvSet(UVal &u, DATA_t data)
         mbedtls_base64_encode(
             NULL, 0, &olen, NULL,
             data.second);  // get length of string buffer needed (mbedtls includes the trailing null in this size)
-        value.STRING = (char *)HS_REALLOC(value.STRING, olen);  // allocate sufficient size for storing value
-        mbedtls_base64_encode((uint8_t *)value.STRING, olen, &olen, data.first,
+        u.STRING = (char *)hs_realloc(u.STRING, olen, HS_MEM_VALUES);  // allocate sufficient size for storing value
+        mbedtls_base64_encode((uint8_t *)u.STRING, olen, &olen, data.first,
                               data.second);  // encode data into string buf
     } else {
-        value.STRING =
-            (char *)HS_REALLOC(value.STRING, 1);  // allocate sufficient size for just trailing null character
-        *value.STRING = '\0';
+        u.STRING = (char *)hs_realloc(u.STRING, 1, HS_MEM_VALUES);  // allocate size for just trailing null
+        *u.STRING = '\0';
     }
 }
 
@@ -2045,10 +2535,10 @@ void SpanCharacteristic::uvSet(UVal &u, TLV_ENC_t tlv)
         mbedtls_base64_encode(
             NULL, 0, &nChars, NULL,
             nBytes);  // get length of string buffer needed (mbedtls includes the trailing null in this size)
-        u.STRING = (char *)HS_REALLOC(u.STRING, nChars);  // allocate sufficient size for storing value
-        TempBuffer<uint8_t> tBuf(bufSize);                // create fixed-size buffer to store packed TLV bytes
-        tlv.pack_init();                                  // initialize TLV packing
-        uint8_t *p = (uint8_t *)u.STRING;                 // set pointer to beginning of value
+        u.STRING = (char *)hs_realloc(u.STRING, nChars, HS_MEM_VALUES);  // allocate sufficient size for value
+        TempBuffer<uint8_t> tBuf(bufSize);  // create fixed-size buffer to store packed TLV bytes
+        tlv.pack_init();                    // initialize TLV packing
+        uint8_t *p = (uint8_t *)u.STRING;   // set pointer to beginning of value
         while ((nBytes = tlv.pack(tBuf, bufSize)) >
                0) {       // pack the next set of TLV bytes, up to a maximum of bufSize, into tBuf
             size_t olen;  // number of characters written (excludes null character)
@@ -2057,7 +2547,7 @@ void SpanCharacteristic::uvSet(UVal &u, TLV_ENC_t tlv)
             nChars -= olen;                                         // subtract number of characters remaining
         }
     } else {
-        u.STRING = (char *)HS_REALLOC(u.STRING, 1);  // allocate sufficient size for just trailing null character
+        u.STRING = (char *)hs_realloc(u.STRING, 1, HS_MEM_VALUES);  // allocate size for just trailing null
         *u.STRING = '\0';
     }
 }
@@ -2077,7 +2567,9 @@ char *SpanCharacteristic::getStringGeneric(UVal &val)
 void SpanCharacteristic::setString(const char *val, boolean notify)
 {
     setValCheck();
-    uvSet(value, val);
+    UVal u;
+    uvSet(u, val);
+    storeValue(u);
     setValFinish(notify);
 }
 
@@ -2111,7 +2603,9 @@ size_t SpanCharacteristic::getDataGeneric(uint8_t *data, size_t len, UVal &val)
 void SpanCharacteristic::setData(const uint8_t *data, size_t len, boolean notify)
 {
     setValCheck();
-    uvSet(value, {data, len});
+    UVal u;
+    uvSet(u, {data, len});
+    storeValue(u);
     setValFinish(notify);
 }
 
@@ -2163,7 +2657,9 @@ size_t SpanCharacteristic::getTLVGeneric(TLV8 &tlv, UVal &val)
 void SpanCharacteristic::setTLV(const TLV8 &tlv, boolean notify)
 {
     setValCheck();
-    uvSet(value, tlv);
+    UVal u;
+    uvSet(u, tlv);
+    storeValue(u);
     setValFinish(notify);
 }
 
@@ -2171,6 +2667,18 @@ void SpanCharacteristic::setTLV(const TLV8 &tlv, boolean notify)
 
 void SpanCharacteristic::setValCheck()
 {
+    TaskHandle_t pollingTask = homeSpan.pollTaskHandle ? homeSpan.pollTaskHandle : homeSpan.loopTaskHandle;
+
+    if (pollingTask && xTaskGetCurrentTaskHandle() != pollingTask) {  // only pollTask() may change values directly
+        LOG0(
+            "\nFATAL ERROR!  Can't set value of Characteristic::%s from a task other than the one calling poll() - use "
+            "setValAsync() instead ***\n",
+            hapName);
+        LOG0("\n=== PROGRAM HALTED ===");
+        while (1)
+            ;
+    }
+
     if (updateFlag == 1)
         LOG0(
             "\n*** WARNING:  Attempt to set value of Characteristic::%s within update() while it is being "
@@ -2183,22 +2691,17 @@ void SpanCharacteristic::setValCheck()
 void SpanCharacteristic::setValFinish(boolean notify)
 {
     uvSet(newValue, value);
+    markChanged();
     updateTime = homeSpan.snapTime;
 
     if (notify) {
-        if ((perms & EV) && (updateFlag != 2)) {  // only broadcast notification if EV permission is set AND update is
-                                                  // NOT being done in context of write-response
-            SpanBuf sb;                           // create SpanBuf object
-            sb.characteristic = this;             // set characteristic
-            sb.status = StatusCode::OK;           // set status
-            char dummy[] = "";
-            sb.val = dummy;  // set dummy "val" so that printfNotify knows to consider this "update"
-            homeSpan.Notifications.push_back(sb);  // store SpanBuf in Notifications vector
-        }
+        if ((perms & EV) && (updateFlag != 2))  // only broadcast notification if EV permission is set AND update is
+                                                // NOT being done in context of write-response
+            queueNotify();
 
         if (nvsKey) {
             nvs_set_str(homeSpan.charNVS, nvsKey, value.STRING);  // store data
-            nvs_commit(homeSpan.charNVS);
+            homeSpan.commitCharNVS();
         }
     }
 }
@@ -2217,10 +2720,11 @@ void SpanCharacteristic::printfAttributes(int flags)
         hapOut << ",\"type\":\"" << type << "\"";
 
     if ((perms & PR) && (flags & GET_VALUE)) {
+        UVal v = writeHeld ? heldValue : snapValue();  // report write held in coalescing window
         if (perms & NV && !(flags & GET_NV))
             hapOut << ",\"value\":null";
         else
-            hapOut << ",\"value\":" << uvPrint(value).c_str();
+            hapOut << ",\"value\":" << uvPrint(v).c_str();
     }
 
     if (flags & GET_META) {
@@ -2392,6 +2896,175 @@ unsigned long SpanCharacteristic::timeVal()
 
 ///////////////////////////////
 
+void SpanCharacteristic::setValQueued(UVal &val, boolean notify, boolean fromPin)
+{
+    setValCheck();
+
+    UVal u;
+    uvSet(u, val);
+    storeValue(u, fromPin && pinBinding);
+    uvSet(newValue, value);
+    markChanged();
+
+    updateTime = homeSpan.snapTime;
+
+    if (notify) {
+        if (updateFlag != 2)  // do not broadcast EV if update is being done in context of write-response
+            queueNotify();
+
+        if (nvsKey) {
+            nvs_set_u64(homeSpan.charNVS, nvsKey, value.UINT64);  // store data as uint64_t regardless of actual type
+            homeSpan.commitCharNVS();
+        }
+    }
+}
+
+///////////////////////////////
+
+void SpanCharacteristic::revertNewValue()
+{
+    uvSet(newValue, value);  // write was already acknowledged, so restore original value and notify Controllers
+    markChanged();
+    if (perms & PERMS::EV)
+        queueNotify();
+}
+
+///////////////////////////////
+
+void SpanCharacteristic::storeValue(UVal &u, boolean fromPin)
+{
+    char *old = NULL;
+
+    valueLock.writeBegin(&homeSpan.valueMux);  // readers in other tasks never wait on this lock
+
+    if (format >= FORMAT::STRING) {  // swap in new string, and retire old string rather than freeing it in place
+        old = value.STRING;
+        value.STRING = u.STRING;
+    } else {
+        if (fromPin)  // queued by toggle pin edge - use output state, which reflects any later edges or stored values
+            uvSet(value, (int)pinBinding->state);
+        else
+            value = u;
+        if (pinBinding)  // drive bound output pin while holding valueMux, which toggle ISR also takes on either core
+            pinBinding->drive(uvGet<int>(value) != 0);
+    }
+
+    valueLock.writeEnd(&homeSpan.valueMux);
+
+    if (old)
+        homeSpan.retiredValues.push_back(old);
+}
+
+///////////////////////////////
+
+SpanCharacteristic::UVal SpanCharacteristic::snapValue()
+{
+    return (valueLock.read(value));
+}
+
+///////////////////////////////
+
+void SpanCharacteristic::commitNewValue()
+{
+    UVal u;
+    uvSet(u, newValue);
+    storeValue(u);
+    markChanged();
+
+    if (nvsKey) {  // if storage key found
+        if (format < FORMAT::STRING)
+            nvs_set_u64(homeSpan.charNVS, nvsKey, value.UINT64);  // store data as uint64_t regardless of actual type
+                                                                   // (it will be read correctly when access through
+                                                                   // uvGet())
+        else
+            nvs_set_str(homeSpan.charNVS, nvsKey, value.STRING);  // store data
+        homeSpan.commitCharNVS();
+    }
+}
+
+///////////////////////////////
+
+boolean SpanCharacteristic::uvEqual(UVal &a, UVal &b)
+{
+    switch (format) {
+        case FORMAT::BOOL:
+            return (a.BOOL == b.BOOL);
+        case FORMAT::INT:
+            return (a.INT == b.INT);
+        case FORMAT::UINT8:
+            return (a.UINT8 == b.UINT8);
+        case FORMAT::UINT16:
+            return (a.UINT16 == b.UINT16);
+        case FORMAT::UINT32:
+            return (a.UINT32 == b.UINT32);
+        case FORMAT::UINT64:
+            return (a.UINT64 == b.UINT64);
+        case FORMAT::FLOAT:
+            return (a.FLOAT == b.FLOAT);
+        case FORMAT::STRING:
+        case FORMAT::DATA:
+        case FORMAT::TLV_ENC:
+            return (a.STRING && b.STRING && !strcmp(a.STRING, b.STRING));
+    }  // switch
+    return (false);  // included to prevent compiler warnings
+}
+
+///////////////////////////////
+
+void IRAM_ATTR SpanCharacteristic::togglePinISR(void *arg)
+{
+    pinBinding_t *pb = (pinBinding_t *)arg;
+
+    if (!pb->edge() || !homeSpan.updateQueue)  // edge was a bounce, or there is no queue to update value from pin
+        return;
+
+    asyncUpdate_t update;  // queue update (and EVENT notification) for pollTask(), which reads value from output pin
+    update.characteristic = pb->chr;
+    update.notify = true;
+    update.fromPin = true;
+
+    homeSpan.updateQueue.sendFromISR(update);
+}
+
+///////////////////////////////
+
+void SpanCharacteristic::queueNotify()
+{
+    if (notifyPending)  // Characteristic is already in Notifications vector, which will pick up its latest value
+        return;
+
+    SpanBuf sb;                  // create SpanBuf object
+    sb.characteristic = this;    // set characteristic
+    sb.status = StatusCode::OK;  // set status
+    char dummy[] = "";
+    sb.val = dummy;  // set dummy "val" so that printfNotify knows to consider this "update"
+    homeSpan.Notifications.push_back(sb);  // store SpanBuf in Notifications vector
+    notifyPending = true;
+}
+
+///////////////////////////////
+
+void SpanCharacteristic::markChanged()
+{
+    changeSeq = ++homeSpan.changeSeq;
+
+    if (homeSpan.lastChanged == this)  // already at front of list
+        return;
+
+    if (prevChanged)  // unlink from current position in list (if in list)
+        prevChanged->nextChanged = nextChanged;
+    if (nextChanged)
+        nextChanged->prevChanged = prevChanged;
+
+    prevChanged = NULL;  // re-link at front of list
+    nextChanged = homeSpan.lastChanged;
+    if (nextChanged)
+        nextChanged->prevChanged = this;
+    homeSpan.lastChanged = this;
+}
+
+///////////////////////////////
+
 boolean SpanCharacteristic::updated()
 {
     return (updateFlag > 0);
@@ -2409,8 +3082,10 @@ uint32_t SpanCharacteristic::getIID()
 SpanCharacteristic *SpanCharacteristic::setPerms(uint8_t perms)
 {
     perms &= 0x7F;
-    if (perms > 0)
+    if (perms > 0) {
         this->perms = perms;
+        homeSpan.clearQueryPlans();  // cached query plans depend on whether Characteristic is readable
+    }
     return (this);
 }
 
@@ -2432,7 +3107,7 @@ SpanCharacteristic *SpanCharacteristic::removePerms(uint8_t dPerms)
 
 SpanCharacteristic *SpanCharacteristic::setDescription(const char *c)
 {
-    desc = (char *)HS_REALLOC(desc, strlen(c) + 1);
+    desc = (char *)hs_realloc(desc, strlen(c) + 1, HS_MEM_METADATA);
     strcpy(desc, c);
     return (this);
 }
@@ -2441,13 +3116,61 @@ SpanCharacteristic *SpanCharacteristic::setDescription(const char *c)
 
 SpanCharacteristic *SpanCharacteristic::setUnit(const char *c)
 {
-    unit = (char *)HS_REALLOC(unit, strlen(c) + 1);
+    unit = (char *)hs_realloc(unit, strlen(c) + 1, HS_MEM_METADATA);
     strcpy(unit, c);
     return (this);
 }
 
 ///////////////////////////////
 
+SpanCharacteristic *SpanCharacteristic::bindPin(uint8_t outPin, int togglePin, uint16_t toggleTime)
+{
+    if (format >= FORMAT::STRING) {
+        LOG0("\n*** WARNING:  Can't bind Characteristic::%s to a pin since it is not numeric.  Ignoring request.\n\n",
+             hapName);
+        return (this);
+    }
+
+    if (pinBinding) {
+        LOG0("\n*** WARNING:  Characteristic::%s is already bound to pin %d.  Ignoring request.\n\n", hapName,
+             pinBinding->outPin);
+        return (this);
+    }
+
+    pinBinding = (pinBinding_t *)hs_malloc(sizeof(pinBinding_t), HS_MEM_VALUES);  // read by ISR - keep in internal RAM
+    if (pinBinding == NULL) {
+        Serial.printf("\n\n*** FATAL ERROR: Requested allocation of %d bytes failed.  Program Halting.\n\n",
+                      sizeof(pinBinding_t));
+        while (1) {}
+    }
+
+    pinBinding->chr = this;
+    pinBinding->begin(outPin, togglePin, toggleTime, getVal() != 0, &homeSpan.valueMux, togglePinISR,
+                      pinBinding);  // start output pin at current (possibly restored) value
+
+    return (this);
+}
+
+///////////////////////////////
+
+SpanCharacteristic *SpanCharacteristic::setReadCallback(void (*f)(SpanCharacteristic *), uint32_t ttl)
+{
+    auto chr = homeSpan.ReadCallbacks.begin();
+    while (chr != homeSpan.ReadCallbacks.end() && (*chr) != this)
+        chr++;
+
+    if (f && chr == homeSpan.ReadCallbacks.end())  // add to ReadCallbacks vector
+        homeSpan.ReadCallbacks.push_back(this);
+    else if (!f && chr != homeSpan.ReadCallbacks.end())  // remove from ReadCallbacks vector
+        homeSpan.ReadCallbacks.erase(chr);
+
+    readCallback = f;
+    readTimer.set(ttl);  // force refresh on next read
+    return (this);
+}
+
+///////////////////////////////
+
 SpanCharacteristic *SpanCharacteristic::setValidValues(int n, ...)
 {
     String s = "[";
@@ -2477,7 +3200,7 @@ SpanCharacteristic *SpanCharacteristic::setValidValues(int n, ...)
     va_end(vl);
     s += "]";
 
-    validValues = (char *)HS_REALLOC(validValues, strlen(s.c_str()) + 1);
+    validValues = (char *)hs_realloc(validValues, strlen(s.c_str()) + 1, HS_MEM_METADATA);
     strcpy(validValues, s.c_str());
 
     return (this);
@@ -2576,9 +3299,27 @@ void SpanWebLog::init(uint16_t maxEntries, const char *serv, const char *tz, con
     timeZone = tz;
     if (url) {
         statusURL = "GET /" + String(url) + " ";
+#ifdef HS_TRACE
+        traceURL = "GET /" + String(url) + "/trace ";
+#endif
+        metricsURL = "GET /" + String(url) + "/metrics ";
+        logURL = "GET /" + String(url) + "/log";  // may be followed by "?since=<seq>"
         isEnabled = true;
     }
-    log = (log_t *)HS_CALLOC(maxEntries, sizeof(log_t));
+
+    if (maxEntries == 0)
+        return;
+
+    uint32_t ringSize = maxEntries * DEFAULT_WEBLOG_ENTRY_SIZE + sizeof(entry_t) + MAX_WEBLOG_MESSAGE;  // any msg fits
+    uint8_t *buf = (uint8_t *)hs_malloc(ringSize, HS_MEM_WEBLOG);
+
+    if (!buf) {
+        Serial.printf("\n\n*** FATAL ERROR: Requested allocation of %d bytes failed.  Program Halting.\n\n", ringSize);
+        while (1) {
+        }
+    }
+
+    ring.begin(buf, ringSize, maxEntries);
 }
 
 ///////////////////////////////
@@ -2605,31 +3346,120 @@ void SpanWebLog::initTime(void *args)
 
 void SpanWebLog::vLog(boolean sysMsg, const char *fmt, va_list ap)
 {
-    char *buf;
-    vasprintf(&buf, fmt, ap);
+    char buf[MAX_WEBLOG_MESSAGE];
+    vsnprintf(buf, sizeof(buf), fmt, ap);
 
     if (sysMsg)
         LOG0("%s\n", buf);
     else
         LOG1("WEBLOG: %s\n", buf);
 
-    if (maxEntries > 0) {
-        int index = nEntries % maxEntries;
+    if (!ring.enabled())
+        return;
 
-        log[index].upTime = esp_timer_get_time();
-        if (timeInit)
-            getLocalTime(&log[index].clockTime, 10);
-        else
-            log[index].clockTime.tm_year = 0;
+    entry_t entry;  // fill in header before taking lock
+
+    entry.upTime = esp_timer_get_time() / 1000000;
+    entry.clientIP = homeSpan.lastClientIP;
+    entry.len = strlen(buf);
+    entry.clockTime[0] = '\0';
+
+    if (timeInit) {
+        time_t now = time(NULL);
+        struct tm clockTime;
+        localtime_r(&now, &clockTime);
+        strftime(entry.clockTime, sizeof(entry.clockTime), "%c", &clockTime);
+    }
+
+    portENTER_CRITICAL(&mux);
+    ring.append(entry, buf);
+    portEXIT_CRITICAL(&mux);
+}
+
+///////////////////////////////
+
+boolean SpanWebLog::readEntry(cursor_t &cursor, entry_t &entry, char *msg, size_t msgSize, boolean older)
+{
+    portENTER_CRITICAL(&mux);
+    boolean found = ring.read(cursor, entry, msg, msgSize, older);
+    portEXIT_CRITICAL(&mux);
+    return (found);
+}
+
+///////////////////////////////
+
+boolean SpanWebLog::readNewer(cursor_t &cursor, uint32_t lastSeq, entry_t &entry, char *msg, size_t msgSize)
+{
+    portENTER_CRITICAL(&mux);
+    boolean found = ring.readNewer(cursor, lastSeq, entry, msg, msgSize);
+    portEXIT_CRITICAL(&mux);
+    return (found);
+}
+
+///////////////////////////////
+
+void SpanWebLog::getRange(uint32_t &oldestSeq, uint32_t &newestSeq)
+{
+    portENTER_CRITICAL(&mux);
+    ring.getRange(oldestSeq, newestSeq);
+    portEXIT_CRITICAL(&mux);
+}
+
+///////////////////////////////
+//        SpanStalls         //
+///////////////////////////////
+
+const char *const SpanStalls::phaseNames[NUM_PHASES] = {
+    "WiFi Connect",   "Serial Command", "Accept Client", "HAP Requests",
+    "Key Generation", "Updates",        "Service Loops", "Read Callbacks",
+    "SpanButtons",    "Notifications",  "OTA",           "Control/Status"};
+
+SpanStalls::stall_t SpanStalls::stalls[MAX_STALLS];
+int SpanStalls::nStalls = 0;
+uint32_t SpanStalls::threshold = 0;
+uint32_t SpanStalls::lastMark = 0;
+
+///////////////////////////////
 
-        log[index].message = (char *)HS_REALLOC(log[index].message, strlen(buf) + 1);
-        strcpy(log[index].message, buf);
+void SpanStalls::mark(phase_t phase)
+{
+    uint32_t now = micros();
+    uint32_t duration = now - lastMark;
+    lastMark = now;
 
-        log[index].clientIP = homeSpan.lastClientIP;
-        nEntries++;
+    if (threshold && duration >= threshold) {
+        homeSpan.addWebLog(true, "Poll Stall: %s blocked for %" PRIu32 " ms", phaseNames[phase], duration / 1000);
+        lastMark = micros();  // don't charge time spent adding Web Log entry to the next phase
     }
 
-    free(buf);
+    if (nStalls == MAX_STALLS && duration <= stalls[MAX_STALLS - 1].duration)  // not one of the longest stalls
+        return;
+
+    int i = (nStalls < MAX_STALLS) ? nStalls++ : MAX_STALLS - 1;  // start from last slot (dropping shortest if full)
+    for (; i > 0 && stalls[i - 1].duration < duration; i--)      // shift shorter stalls down to keep table sorted
+        stalls[i] = stalls[i - 1];
+
+    stalls[i].phase = phase;
+    stalls[i].duration = duration;
+    stalls[i].upTime = millis() - duration / 1000;
+}
+
+///////////////////////////////
+
+void SpanStalls::print()
+{
+    LOG0("\n*** Longest pollTask() Stalls ***\n\n");
+    LOG0("   Phase               Duration (ms)   Up Time (sec)\n");
+    LOG0("   ----------------    -------------   -------------\n");
+
+    for (int i = 0; i < nStalls; i++)
+        LOG0("   %-16s    %13.1f   %13.3f\n", phaseNames[stalls[i].phase], stalls[i].duration / 1000.0,
+             stalls[i].upTime / 1000.0);
+
+    if (threshold)
+        LOG0("\nStalls of %" PRIu32 " ms or longer are recorded in the Web Log\n", threshold / 1000);
+
+    LOG0("\n*** End Stalls ***\n\n");
 }
 
 ///////////////////////////////
@@ -53,6 +53,9 @@
 
 #include "Settings.h"
 #include "Utils.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "Log.h"
 #include "Network.h"
 #include "HAPConstants.h"
 #include "HapQR.h"
@@ -133,6 +136,7 @@ struct SpanAccessory;
 struct SpanService;
 struct SpanCharacteristic;
 struct SpanBuf;
+struct SpanQueryPlan;
 struct SpanButton;
 struct SpanUserCommand;
 
@@ -178,30 +182,125 @@ struct SpanBuf
 
 ///////////////////////////////
 
+// parsed and resolved GET /characteristics request, cached by Span so repeated polls skip parsing and lookups
+struct SpanQueryPlan
+{
+    struct item_t
+    {
+        SpanCharacteristic *characteristic;  // resolved Characteristic (NULL if not found or not readable)
+        uint32_t aid;                        // requested aid
+        uint32_t iid;                        // requested iid
+        StatusCode status;                   // status code resolved when plan was created
+    };
+
+    uint32_t hash = 0;                         // FNV-1a hash of query string
+    vector<char, TagAllocator<char, HS_MEM_CACHE>> query;      // copy of query string (null-terminated) to confirm hash
+    int flags = 0;                                             // final flags, including GET_STATUS if any id failed
+    vector<item_t, TagAllocator<item_t, HS_MEM_CACHE>> items;  // resolved ids, in requested order
+    uint32_t lastUsed = 0;                                     // LRU counter value when plan was last used
+    vector<char, TagAllocator<char, HS_MEM_CACHE>> body;       // JSON body produced the last time plan was rendered
+    uint32_t bodySeq = 0;                                      // global change sequence number when body was rendered
+    boolean bodyValid = false;                                 // body may be re-sent until one of its values changes
+};
+
+///////////////////////////////
+
 struct SpanWebLog
 {                                   // optional web status/log data
     boolean isEnabled = false;      // flag to inidicate WebLog has been enabled
     uint16_t maxEntries = 0;        // max number of log entries;
-    int nEntries = 0;               // total cumulative number of log entries
     const char *timeServer = NULL;  // optional time server to use for acquiring clock time
     const char *timeZone;           // optional time-zone specification
     boolean timeInit = false;       // flag to indicate time has been initialized
     char bootTime[33] = "Unknown";  // boot time
     String statusURL;               // URL of status log
+#ifdef HS_TRACE
+    String traceURL;                // URL of stage trace (Chrome trace JSON)
+#endif
+    String metricsURL;              // URL of metrics (Prometheus text format)
+    String logURL;                  // URL of incremental Web Log (JSON)
     uint32_t waitTime = 120000;     // number of milliseconds to wait for initial connection to time server
     String css = "";                // optional user-defined style sheet for web log
 
-    struct log_t
-    {                         // log entry type
-        uint64_t upTime;      // number of seconds since booting
-        struct tm clockTime;  // clock time
-        char *message;        // pointers to log entries of arbitrary size
-        String clientIP;      // IP address of client making request (or "0.0.0.0" if not applicable)
-    } *log = NULL;            // array of log entries
+    // Log entries are stored in a single byte ring allocated once in init().  The ring is protected by a spinlock so
+    // that entries can be added from any task, and is read one entry at a time (copying each entry out under the
+    // lock) so that slow network writes never hold the lock.
+
+    struct entry_t
+    {                        // header of each log entry
+        uint32_t seq;        // sequence number of entry (first entry is 1)
+        uint32_t upTime;     // number of seconds since booting
+        uint32_t clientIP;   // packed IPv4 address of client making request (or 0 if not applicable)
+        uint32_t next;       // offset of next (newer) entry in ring (undefined for newest entry)
+        uint32_t prev;       // offset of previous (older) entry in ring (undefined for oldest entry)
+        uint16_t len;        // length of message (not including null terminator)
+        char clockTime[26];  // pre-formatted clock time (or empty string if time is not known)
+    };
+
+    typedef Utils::LogRing<entry_t>::cursor_t cursor_t;  // position of an entry in the log
+
+    Utils::LogRing<entry_t> ring;                     // ring holding all log entries
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;  // serializes access to ring
 
     void init(uint16_t maxEntries, const char *serv, const char *tz, const char *url);
     static void initTime(void *args);
     void vLog(boolean sysMsg, const char *fmr, va_list ap);
+
+    // copies entry at cursor (and up to msgSize-1 characters of its message) and then moves cursor to the next older
+    // (or newer) entry - returns false if entry at cursor is not (or is no longer) in the log
+    boolean readEntry(cursor_t &cursor, entry_t &entry, char *msg, size_t msgSize, boolean older = true);
+
+    // same as readEntry() toward newer entries, but first skips cursor ahead past any entries evicted since it was
+    // set - returns false only if there is no entry from cursor up to lastSeq
+    boolean readNewer(cursor_t &cursor, uint32_t lastSeq, entry_t &entry, char *msg, size_t msgSize);
+
+    // returns sequence numbers of oldest and newest entries in the log (oldest is greater than newest if log is empty)
+    void getRange(uint32_t &oldestSeq, uint32_t &newestSeq);
+};
+
+///////////////////////////////
+
+struct SpanStalls
+{  // times each phase of pollTask() and keeps a table of the longest-blocking phases (see 'b' command and Web Log)
+
+    enum phase_t : uint8_t
+    {
+        CONNECT,     // checkConnect() - WiFi connect/reconnect and post-connect initialization
+        SERIAL_CMD,  // processing of serial commands
+        ACCEPT,      // accepting new HAP clients
+        REQUESTS,    // processing of HAP requests (including pair-setup/pair-verify SRP and curve math)
+        KEYGEN,      // idle-time pre-generation of ephemeral keys
+        UPDATES,     // queued updates, coalesced writes, and their update() callbacks (including NVS commits)
+        LOOPS,       // Service loop() methods (including any SpanPoint::send() calls)
+        READS,       // read callbacks of subscribed Characteristics
+        BUTTONS,     // SpanButton checks and button() callbacks
+        NOTIFY,      // event notifications and timed-write expirations
+        OTA,         // ArduinoOTA.handle()
+        CONTROL,     // control button, status LED, and reboot callback
+        NUM_PHASES
+    };
+
+    static const int MAX_STALLS = 8;                  // number of entries in table of longest stalls
+    static const char *const phaseNames[NUM_PHASES];  // phase labels
+
+    struct stall_t
+    {
+        phase_t phase;      // phase that blocked
+        uint32_t duration;  // duration of phase (in microseconds)
+        uint32_t upTime;    // time phase started (in milliseconds since boot)
+    };
+
+    // stalls are recorded only from the HomeSpan polling task, so no locking is needed
+
+    static stall_t stalls[MAX_STALLS];  // longest stalls since boot (or last reset), sorted from longest to shortest
+    static int nStalls;                 // number of entries in use
+    static uint32_t threshold;          // phases that take at least this long (in microseconds) are added to Web Log
+    static uint32_t lastMark;           // time (in microseconds) that the current phase started
+
+    static void start() { lastMark = micros(); }  // starts timing first phase of a pollTask() cycle
+    static void mark(phase_t phase);              // records time since last mark as duration of phase
+    static void print();                          // prints table of longest stalls to Serial
+    static void reset() { nStalls = 0; }          // clears table of longest stalls
 };
 
 ///////////////////////////////
@@ -257,7 +356,7 @@ class Span
     const char *sketchVersion = "n/a";  // version of the sketch
     char pairingCodeCommand[12] = "";   // user-specified Pairing Code - only needed if Pairing Setup Code is specified
                                         // in sketch using setPairingCode()
-    String lastClientIP = "0.0.0.0";    // IP address of last client accessing device through encrypted channel
+    uint32_t lastClientIP = 0;          // packed IPv4 address of client whose request is being processed (0 if none)
     boolean newCode;  // flag indicating new application code has been loaded (based on keeping track of app SHA256)
     boolean serialInputDisabled = false;  // flag indiating that serial input is disabled
     uint8_t rebootCount = 0;      // counts number of times device was rebooted (used in optional Reboot callback)
@@ -309,20 +408,60 @@ class Span
     SpanConfig hapConfig;  // track configuration changes to the HAP Accessory database; used to increment the
                            // configuration number (c#) when changes found
 
-    list<HAPClient, Mallocator<HAPClient>> hapList;  // linked-list of HAPClient structures containing HTTP client
-                                                     // connections, parsing routines, and state variables
-    list<HAPClient, Mallocator<HAPClient>>::iterator currentClient;    // iterator to current client
+    typedef SlabAllocator<HAPClient, MAX_CLIENT_SLOTS> ClientAllocator;  // fixed slab of HAPClient connection slots
+
+    list<HAPClient, ClientAllocator> hapList;  // linked-list of HAPClient structures containing HTTP client
+                                               // connections, parsing routines, and state variables
+    list<HAPClient, ClientAllocator>::iterator currentClient;          // iterator to current client
+    BumpArena requestArena{HS_MEM_NETWORK, DEFAULT_REQUEST_ARENA_SIZE};  // per-request buffers
     vector<SpanAccessory *, Mallocator<SpanAccessory *>> Accessories;  // vector of pointers to all Accessories
     vector<SpanService *, Mallocator<SpanService *>>
-        Loops;  // vector of pointer to all Services that have over-ridden loop() methods
+        Loops;  // vector of pointer to all Services that have over-ridden loop() methods to be called on every poll
+    vector<SpanService *, Mallocator<SpanService *>>
+        LoopTimers;  // min-heap of pointers to all Services that have over-ridden loop() methods with a loop period,
+                     // ordered by time of next scheduled call
+    boolean loopsChanged = false;  // flag indicating Loops and LoopTimers need to be rebuilt before next poll
+    vector<SpanCharacteristic *, Mallocator<SpanCharacteristic *>>
+        ReadCallbacks;  // vector of pointers to all Characteristics with a read callback
+    vector<SpanService *, Mallocator<SpanService *>>
+        PendingWrites;  // vector of pointers to all Services with coalesced writes waiting for update()
     vector<SpanBuf, Mallocator<SpanBuf>>
         Notifications;  // vector of SpanBuf objects that store info for Characteristics that are updated with setVal()
                         // and require a Notification Event
     vector<SpanButton *, Mallocator<SpanButton *>> PushButtons;  // vector of pointer to all PushButtons
     unordered_map<uint64_t, uint32_t> TimedWrites;        // map of timed-write PIDs and Alarm Times (based on TTLs)
     unordered_map<char, SpanUserCommand *> UserCommands;  // map of pointers to all UserCommands
+    vector<SpanQueryPlan, Mallocator<SpanQueryPlan>> queryPlans;  // LRU cache of GET /characteristics query plans
+    uint8_t queryCacheSize = DEFAULT_QUERY_CACHE_SIZE;            // max number of query plans to cache
+    uint32_t queryClock = 0;                                      // LRU counter for query plans
+    uint32_t changeSeq = 0;                                       // global change sequence number (high-water mark)
+    SpanCharacteristic *lastChanged = NULL;                       // changed Characteristics, most recent change first
+    uint8_t batchDepth = 0;                                       // nesting depth of open beginBatch() calls
+    boolean batchCommitNVS = false;  // flag indicating an NVS commit of Characteristic values was deferred by a batch
+    uint16_t updateQueueSize = DEFAULT_UPDATE_QUEUE_SIZE;         // depth of update queue
+    Utils::PurgeableQueue updateQueue;                            // updates from setValAsync() and setValFromISR()
+    vector<char *, Mallocator<char *>> retiredValues;  // replaced string values, freed on next pass of pollTask()
+    portMUX_TYPE valueMux = portMUX_INITIALIZER_UNLOCKED;  // serializes writers of Characteristic values
 
     void pollTask();      // poll HAP Clients and process any new HAP requests
+    // rebuilds Loops and LoopTimers from all Services with over-ridden loop() methods
+    void scheduleLoops();
+    // calls loop() for every Service in Loops, and for every Service in LoopTimers that is due
+    void runLoops();
+    // calls update() for all Services whose write-coalescing window has closed
+    void checkWrites();
+    // moves writes held in Service svc into newValue (unless newer writes are already there) so update() sees them
+    void releaseWrites(SpanService *svc);
+    // commits (if ok=true) or reverts (if ok=false) all pending writes to Characteristics in Service svc
+    void finishWrites(SpanService *svc, boolean ok);
+    // refreshes all Characteristics with a read callback that have EV subscribers and whose values have expired
+    void checkReads();
+    // refreshes all Characteristics in query plan with a read callback whose values have expired
+    void checkReads(SpanQueryPlan *plan);
+    // applies all updates queued by setValAsync() and setValFromISR()
+    void checkUpdates();
+    // frees all string values replaced during the previous pass of pollTask()
+    void freeRetiredValues();
     void checkConnect();  // check WiFi connection; connect if needed
     void commandMode();   // allows user to control and reset HomeSpan settings with the control button
     void resetStatus();   // resets statusLED and calls statusCallback based on current HomeSpan status
@@ -340,11 +479,23 @@ class Span
     int updateCharacteristics(char *buf, SpanBuf *pObj);
     // writes SpanBuf objects to hapOut stream
     void printfAttributes(SpanBuf *pObj, int nObj);
-    // writes accessory requested characteristic ids to hapOut stream - returns true if all characteristics are found
-    // and readable, else returns false
-    boolean printfAttributes(char **ids, int numIDs, int flags);
+    // returns cached plan matching GET /characteristics 'query' string, else NULL if not found
+    SpanQueryPlan *findQueryPlan(const char *query);
+    // resolves 'numIDs' requested "aid.iid" strings in 'ids' into a plan (cached under 'query'), and returns the plan
+    SpanQueryPlan *createQueryPlan(const char *query, char **ids, int numIDs, int flags);
+    // clears all cached query plans (must be called whenever Accessories, Services, or Characteristics change)
+    void clearQueryPlans();
+    // writes characteristics requested in query plan to hapOut stream - returns true if any characteristic is not
+    // found or not readable (response requires a status attribute), else returns false
+    boolean printfAttributes(SpanQueryPlan *plan);
+    // renders query plan into its body buffer, unless the existing body is still current
+    void renderQueryPlan(SpanQueryPlan *plan);
+    // commits Characteristic values stored in NVS, unless deferred until batch is committed
+    void commitCharNVS();
     // clear all notifications related to specific client connection
     void clearNotify(HAPClient *hc);
+    // clears Notifications vector once EVENT notifications have been sent
+    void clearNotifications();
     // writes notification JSON to hapOut stream based on SpanBuf objects and specified connection
     void printfNotify(SpanBuf *pObj, int nObj, HAPClient *hc);
 
@@ -377,6 +528,21 @@ class Span
     // deletes Accessory with matching aid; returns true if found, else returns false
     boolean deleteAccessory(uint32_t aid);
 
+    // starts a batch of Characteristic updates - EVENT notifications and NVS commits are held until commitBatch()
+    Span &beginBatch();
+    // commits a batch of Characteristic updates (batches may be nested - only the outermost commitBatch() takes effect)
+    Span &commitBatch();
+
+    // returns time (in millis) until the next Service loop() is due - returns 0 if any Service loop() is called on
+    // every poll, or ULONG_MAX if there are no Service loops
+    unsigned long timeToNextLoop();
+
+    // returns global change sequence number, which is incremented every time the value of any Characteristic changes
+    uint32_t getChangeSeq() { return (changeSeq); }
+    // calls f(chr, user_data) for each Characteristic that changed after change sequence number 'since', starting with
+    // the most recent change; returns number of Characteristics found
+    int getChanges(uint32_t since, void (*f)(SpanCharacteristic *, void *), void *user_data = NULL);
+
     // sets Control Pin, with optional trigger type
     Span &setControlPin(uint8_t pin, PushButton::triggerType_t triggerType = PushButton::TRIGGER_ON_LOW)
     {
@@ -582,6 +748,28 @@ class Span
         return (*this);
     }
 
+    // sets depth of queue used by setValAsync() and setValFromISR() - must be called before begin()
+    Span &setUpdateQueueSize(uint16_t n)
+    {
+        updateQueueSize = n;
+        return (*this);
+    }
+
+    // sets minimum duration (in milliseconds) of any pollTask() phase that triggers a Web Log entry (0=disable)
+    Span &setStallThreshold(uint32_t ms)
+    {
+        SpanStalls::threshold = ms * 1000;
+        return (*this);
+    }
+
+    // sets number of parsed GET /characteristics requests to cache (0=disable cache)
+    Span &setQueryCacheSize(uint8_t n)
+    {
+        queryCacheSize = n;
+        clearQueryPlans();
+        return (*this);
+    }
+
     // start pollTask()
     void autoPoll(uint32_t stackSize = 8192, uint32_t priority = 1, uint32_t cpu = 0)
     {
@@ -673,6 +861,15 @@ class SpanService
     boolean isCustom;
     // pointer to Accessory containing this Service
     SpanAccessory *accessory = NULL;
+    // time (in millis) between calls to loop() - 0 means loop() is called on every poll
+    uint32_t loopPeriod = 0;
+    // time (in millis) at which loop() is next due, if loopPeriod is set
+    unsigned long nextLoop = 0;
+    // window during which writes from Controllers are held before calling update()
+    Utils::WriteWindow writeWindow;
+
+    // schedules Span LoopTimers using loopPeriod and nextLoop
+    friend struct Utils::LoopHeap<SpanService>;
 
     // writes Service JSON to hapOut stream
     void printfAttributes(int flags);
@@ -696,6 +893,13 @@ class SpanService
     SpanService *setHidden();
     // adds svc as a Linked Service and returns pointer to self
     SpanService *addLink(SpanService *svc);
+    // sets time (in millis) between calls to loop(), instead of calling it on every poll, and returns pointer to self
+    SpanService *setLoopPeriod(uint32_t period);
+    // returns time (in millis) between calls to loop() (0=every poll)
+    uint32_t getLoopPeriod() { return (loopPeriod); }
+    // holds writes from Controllers for 'window' millis so only the latest values are passed to update(), which is
+    // skipped if they equal the current values (0=disable); not applied to requests that ask for a write-response
+    SpanService *setWriteCoalescing(uint32_t window);
 
     // returns linkedServices vector, mapped to <T>, for use as range in "for-each" loops
     template <typename T = SpanService *>
@@ -715,7 +919,7 @@ class SpanService
     // placeholder for code that is called when a Service is updated via a Controller.  Must return true/false depending
     // on success of update
     virtual boolean update() { return (true); }
-    // loops for each Service - called every cycle if over-ridden with user-defined code
+    // loops for each Service - called every cycle (or every loop period, if set) if over-ridden with user-defined code
     virtual void loop() {}
     // method called for a Service when a button attached to "pin" has a Single, Double, or Long Press, according to
     // pressType
@@ -728,6 +932,8 @@ class SpanCharacteristic
 {
     friend class Span;
     friend class SpanService;
+    friend struct Utils::ReadRefresh<SpanCharacteristic>;
+    friend struct Utils::HeldWrites<SpanCharacteristic>;
 
     union UVal
     {
@@ -741,6 +947,21 @@ class SpanCharacteristic
         char *STRING = NULL;
     };
 
+    // value queued by setValAsync() or setValFromISR() for pollTask() to apply
+    struct asyncUpdate_t
+    {
+        SpanCharacteristic *characteristic;  // Characteristic to update
+        UVal value;                          // new value
+        boolean notify;                      // flag indicating whether to send EVENT notification and save to NVS
+        boolean fromPin;                     // flag indicating value is instead read from bound output pin when applied
+    };
+
+    // output pin (and optional toggle pin) bound to Characteristic with bindPin()
+    struct pinBinding_t : PinToggle
+    {
+        SpanCharacteristic *chr;  // Characteristic bound to pins
+    };
+
     // vector of current connections that have subscribed to EV notifications for this Characteristic
     class EVLIST : public vector<HAPClient *, Mallocator<HAPClient *>>
     {
@@ -781,8 +1002,32 @@ class SpanCharacteristic
     unsigned long updateTime =
         0;          // last time value was updated (in millis) either by PUT /characteristic OR by setVal()
     UVal newValue;  // the updated value requested by PUT /characteristic
+    UVal heldValue;  // latest value written by a Controller while Service's write-coalescing window is open
+    boolean writeHeld = false;  // flag indicating heldValue is waiting for update()
     SpanService *service = NULL;  // pointer to Service containing this Characteristic
     EVLIST evList;  // vector of current connections that have subscribed to EV notifications for this Characteristic
+    uint32_t changeSeq = 0;                  // change sequence number assigned when value last changed (0=never)
+    Utils::SeqLock valueLock;                // lets other tasks read value while pollTask() stores a new one
+    SpanCharacteristic *prevChanged = NULL;  // previous (more recently changed) Characteristic in Span change list
+    SpanCharacteristic *nextChanged = NULL;  // next (less recently changed) Characteristic in Span change list
+    boolean notifyPending = false;           // flag indicating Characteristic is in Span Notifications vector
+    void (*readCallback)(SpanCharacteristic *) = NULL;  // optional callback to refresh value when it is read
+    Utils::TTLTimer readTimer;  // determines when readCallback is due to refresh value again
+    // optional output pin (and toggle pin) binding created by bindPin()
+    pinBinding_t *pinBinding = NULL;
+
+    // assigns next global change sequence number and moves Characteristic to front of Span change list
+    void markChanged();
+    // adds Characteristic to Span Notifications vector, unless it is already pending
+    void queueNotify();
+    // copies newValue into value (saving to NVS if needed) after a successful update()
+    void commitNewValue();
+    // restores newValue to value after a failed update(), and notifies Controllers the acknowledged write was undone
+    void revertNewValue();
+    // interrupt handler for edges on a bound toggle pin - flips output pin and queues new value
+    static void togglePinISR(void *arg);
+    // returns true if UVal a equals UVal b, based on format of Characteristic
+    boolean uvEqual(UVal &a, UVal &b);
 
     // writes Characteristic JSON to hapOut stream
     void printfAttributes(int flags);
@@ -862,6 +1107,14 @@ class SpanCharacteristic
 
     void setValCheck();                 // initial check before setting value of any Characteristic
     void setValFinish(boolean notify);  // final processing after setting value of any Characteristic
+    // applies a value queued by setValAsync(), setValFromISR(), or an edge on a bound toggle pin (fromPin=true)
+    void setValQueued(UVal &val, boolean notify, boolean fromPin);
+
+    // publishes 'u' as the new value (taking ownership of u.STRING for string-based Characteristics), or the state of
+    // the bound output pin if fromPin=true
+    void storeValue(UVal &u, boolean fromPin = false);
+    // returns a consistent snapshot of value without locking, even if value is being stored by another task
+    UVal snapValue();
 
   protected:
     ~SpanCharacteristic();  // destructor
@@ -888,7 +1141,7 @@ class SpanCharacteristic
                 }
             } else {
                 if (!nvs_get_str(homeSpan.charNVS, nvsKey, NULL, &len)) {
-                    value.STRING = (char *)HS_REALLOC(value.STRING, len);
+                    value.STRING = (char *)hs_realloc(value.STRING, len, HS_MEM_VALUES);
                     nvs_get_str(homeSpan.charNVS, nvsKey, value.STRING, &len);
                 } else {
                     nvs_set_str(homeSpan.charNVS, nvsKey, value.STRING);  // store string data
@@ -916,14 +1169,27 @@ class SpanCharacteristic
     template <class T = int>
     T getVal()
     {
-        return (uvGet<T>(value));
+        UVal v = snapValue();
+        return (uvGet<T>(v));
+    }
+    // gets the value for string-based Characteristics (in other tasks, valid until the next pass of poll())
+    char *getString()
+    {
+        UVal v = snapValue();
+        return (getStringGeneric(v));
     }
-    // gets the value for string-based Characteristics
-    char *getString() { return (getStringGeneric(value)); }
     // gets the value for data-based Characteristics
-    size_t getData(uint8_t *data, size_t len) { return (getDataGeneric(data, len, value)); }
+    size_t getData(uint8_t *data, size_t len)
+    {
+        UVal v = snapValue();
+        return (getDataGeneric(data, len, v));
+    }
     // gets the value for tlv8-based Characteristics
-    size_t getTLV(TLV8 &tlv) { return (getTLVGeneric(tlv, value)); }
+    size_t getTLV(TLV8 &tlv)
+    {
+        UVal v = snapValue();
+        return (getTLVGeneric(tlv, v));
+    }
 
     // gets the newValue for numeric-based Characteristics
     template <class T = int>
@@ -938,7 +1204,8 @@ class SpanCharacteristic
     // gets the newValue for tlv8-based Characteristics
     size_t getNewTLV(TLV8 &tlv) { return (getTLVGeneric(tlv, newValue)); }
 
-    // sets the value and newValue for string-based Characteristic
+    // sets the value and newValue for string-based Characteristic (setVal() and its variants may only be called from
+    // the task that calls poll() - other tasks must use setValAsync())
     void setString(const char *val, boolean notify = true);
     // sets the value and newValue for data-based Characteristic
     void setData(const uint8_t *data, size_t len, boolean notify = true);
@@ -958,34 +1225,64 @@ class SpanCharacteristic
                 hapName, (double)val, uvGet<double>(minValue), uvGet<double>(maxValue));
         }
 
-        uvSet(value, val);
+        UVal u;
+        uvSet(u, val);
+        storeValue(u);
         uvSet(newValue, value);
+        markChanged();
 
         updateTime = homeSpan.snapTime;
 
         if (notify) {
-            if (updateFlag != 2) {           // do not broadcast EV if update is being done in context of write-response
-                SpanBuf sb;                  // create SpanBuf object
-                sb.characteristic = this;    // set characteristic
-                sb.status = StatusCode::OK;  // set status
-                char dummy[] = "";
-                sb.val = dummy;  // set dummy "val" so that printfNotify knows to consider this "update"
-                homeSpan.Notifications.push_back(sb);  // store SpanBuf in Notifications vector
-            }
+            if (updateFlag != 2)  // do not broadcast EV if update is being done in context of write-response
+                queueNotify();
 
             if (nvsKey) {
                 nvs_set_u64(homeSpan.charNVS, nvsKey,
                             value.UINT64);  // store data as uint64_t regardless of actual type (it will be read
                                             // correctly when access through uvGet())
-                nvs_commit(homeSpan.charNVS);
+                homeSpan.commitCharNVS();
             }
         }
     }
 
+    // queues new value for numeric-based Characteristics from any task - the value is applied (as if by setVal) in
+    // the next call to poll(); returns false if queue is full or value could not be queued
+    template <typename T>
+    boolean setValAsync(T val, boolean notify = true)
+    {
+        if (!homeSpan.updateQueue || format >= FORMAT::STRING)
+            return (false);
+
+        asyncUpdate_t update;
+        update.characteristic = this;
+        uvSet(update.value, val);
+        update.notify = notify;
+        update.fromPin = false;
+        return (homeSpan.updateQueue.send(update));  // does not wait if queue is full
+    }
+
+    // same as setValAsync(), but for use from within an interrupt service routine
+    template <typename T>
+    boolean setValFromISR(T val, boolean notify = true)
+    {
+        if (!homeSpan.updateQueue || format >= FORMAT::STRING)
+            return (false);
+
+        asyncUpdate_t update;
+        update.characteristic = this;
+        uvSet(update.value, val);
+        update.notify = notify;
+        update.fromPin = false;
+        return (homeSpan.updateQueue.sendFromISR(update));  // does not wait if queue is full
+    }
+
     // returns true within update() if Characteristic was updated by Home App
     boolean updated();
     // returns time elapsed (in millis) since value was last updated, either by Home App or by using setVal()
     unsigned long timeVal();
+    // returns global change sequence number assigned when value last changed (0=never changed)
+    uint32_t getChangeSeq() { return (changeSeq); }
 
     // returns IID of Characteristic
     uint32_t getIID();
@@ -1003,6 +1300,15 @@ class SpanCharacteristic
     // sets a list of 'n' valid values allowed for a Characteristic - only applicable if format=INT, UINT8, UINT16, or
     // UINT32
     SpanCharacteristic *setValidValues(int n, ...);
+    // binds a numeric Characteristic to output pin 'outPin', which is then driven to match value whenever it changes
+    // (including directly from within a PUT request), and to an optional input 'togglePin' whose edges (after
+    // debouncing for 'toggleTime' millis) flip the output pin from an interrupt and queue the new value
+    SpanCharacteristic *bindPin(uint8_t outPin, int togglePin = -1, uint16_t toggleTime = 5);
+    // returns number of edges accepted on pin bound with bindPin() (0 if none)
+    uint32_t getPinToggles() { return (pinBinding ? pinBinding->toggles : 0); }
+    // sets a callback f(chr) that refreshes the value (typically with setVal) when it is read by a Controller, or while
+    // any Controller is subscribed to EV notifications, but no more often than once every 'ttl' millis (NULL=remove)
+    SpanCharacteristic *setReadCallback(void (*f)(SpanCharacteristic *), uint32_t ttl = 0);
 
     // sets the allowed range of a Characteristic
     template <typename A, typename B, typename S = int>
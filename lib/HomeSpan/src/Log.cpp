@@ -0,0 +1,325 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#include <soc/soc_memory_layout.h>
+
+#include "Log.h"
+
+RingbufHandle_t SpanLog::ring = NULL;
+TaskHandle_t SpanLog::logTaskHandle = NULL;
+portMUX_TYPE SpanLog::countMux = portMUX_INITIALIZER_UNLOCKED;
+volatile uint32_t SpanLog::nQueued = 0;
+volatile uint32_t SpanLog::nPrinted = 0;
+const char SpanLog::formatFollows = 0;
+
+//////////////////////////////////////
+
+void SpanLog::begin(size_t bufSize)
+{
+    if (ring || bufSize == 0)
+        return;
+
+    if ((ring = xRingbufferCreate(bufSize, RINGBUF_TYPE_NOSPLIT)) == NULL)  // if ring can't be created, log output
+        return;                                                              // simply remains synchronous
+
+    xTaskCreateUniversal(logTask, "logTaskHandle", 4096, NULL, 1, &logTaskHandle, 0);
+}
+
+//////////////////////////////////////
+
+void SpanLog::logTask(void *args)
+{
+    for (;;) {
+        size_t size;
+        uint8_t *rec = (uint8_t *)xRingbufferReceive(ring, &size, portMAX_DELAY);
+        if (!rec)
+            continue;
+
+        decode(rec, size, Serial);
+        vRingbufferReturnItem(ring, rec);
+        nPrinted++;  // only the log task writes nPrinted, so no lock is needed
+    }
+}
+
+//////////////////////////////////////
+
+void SpanLog::flush()
+{
+    if (!ring || xTaskGetCurrentTaskHandle() == logTaskHandle)
+        return;
+
+    while (nPrinted != nQueued)
+        vTaskDelay(1);
+}
+
+//////////////////////////////////////
+
+uint8_t *SpanLog::acquire(size_t size)
+{
+    void *rec;
+
+    if (!ring || xTaskGetCurrentTaskHandle() == logTaskHandle || size > xRingbufferGetMaxItemSize(ring))
+        return (NULL);
+
+    if (xRingbufferSendAcquire(ring, &rec, size, portMAX_DELAY) != pdTRUE)  // blocks if ring is full
+        return (NULL);
+
+    portENTER_CRITICAL(&countMux);
+    nQueued++;
+    portEXIT_CRITICAL(&countMux);
+
+    return ((uint8_t *)rec);
+}
+
+//////////////////////////////////////
+
+void SpanLog::commit(uint8_t *rec)
+{
+    xRingbufferSendComplete(ring, rec);
+}
+
+//////////////////////////////////////
+
+void SpanLog::write(const char *buf, size_t n)
+{
+    const char *fmt = NULL;  // a NULL format pointer marks a record of raw characters
+    const size_t hdrSize = sizeof(fmt) + 1;
+
+    if (!ring || xTaskGetCurrentTaskHandle() == logTaskHandle) {
+        flush();
+        Serial.write((const uint8_t *)buf, n);
+        return;
+    }
+
+    size_t maxChunk = xRingbufferGetMaxItemSize(ring) - hdrSize;
+
+    while (n > 0) {  // split large buffers across multiple records
+        size_t len = n < maxChunk ? n : maxChunk;
+        uint8_t *rec = acquire(hdrSize + len);
+        if (!rec)
+            return;
+        memcpy(rec, &fmt, sizeof(fmt));
+        rec[sizeof(fmt)] = 0;
+        memcpy(rec + hdrSize, buf, len);
+        commit(rec);
+        buf += len;
+        n -= len;
+    }
+}
+
+//////////////////////////////////////
+
+void SpanLog::hexWrite(const uint8_t *buf, size_t n)
+{
+    const char *digits = "0123456789ABCDEF";
+    char hex[64];
+
+    while (n > 0) {  // convert in chunks to avoid queuing a separate record for every byte
+        size_t len = n < sizeof(hex) / 2 ? n : sizeof(hex) / 2;
+        for (size_t i = 0; i < len; i++) {
+            hex[2 * i] = digits[buf[i] >> 4];
+            hex[2 * i + 1] = digits[buf[i] & 0x0F];
+        }
+        write(hex, 2 * len);
+        buf += len;
+        n -= len;
+    }
+}
+
+//////////////////////////////////////
+
+boolean SpanLog::inFlash(const char *s)
+{
+    return (esp_ptr_in_drom(s));  // string literals are placed in flash-mapped read-only data
+}
+
+//////////////////////////////////////
+
+void SpanLog::pack(uint8_t *&p, const void *x)
+{
+    *p++ = ARG_POINTER;
+    memcpy(p, &x, sizeof(x));
+    p += sizeof(x);
+}
+
+//////////////////////////////////////
+
+void SpanLog::pack(uint8_t *&p, const char *s)
+{
+    uint16_t len = strLen(s);
+
+    *p++ = ARG_STRING;
+    memcpy(p, &len, sizeof(len));
+    p += sizeof(len);
+    memcpy(p, s ? s : "(null)", len);
+    p += len;
+    *p++ = '\0';
+}
+
+//////////////////////////////////////
+
+void SpanLog::decode(const uint8_t *rec, size_t size, Print &out)
+{
+    const char *fmt;
+    const uint8_t *p = rec;
+
+    memcpy(&fmt, p, sizeof(fmt));
+    p += sizeof(fmt);
+    int nArgs = *p++;
+
+    if (!fmt) {  // raw characters
+        out.write(p, size - (p - rec));
+        return;
+    }
+
+    if (fmt == &formatFollows) {  // format was copied into record, packed as a string ahead of the arguments
+        uint16_t len;
+        p++;
+        memcpy(&len, p, sizeof(len));
+        p += sizeof(len);
+        fmt = (const char *)p;
+        p += len + 1;
+    }
+
+    char spec[16];  // a single conversion specification, such as "%-8.3f"
+    char buf[64];   // formatted output of a single non-string conversion
+
+    while (*fmt) {
+        if (*fmt != '%') {  // print literal text up to next conversion
+            const char *next = strchr(fmt, '%');
+            size_t len = next ? next - fmt : strlen(fmt);
+            out.write((const uint8_t *)fmt, len);
+            fmt += len;
+            continue;
+        }
+
+        if (fmt[1] == '%') {
+            out.write('%');
+            fmt += 2;
+            continue;
+        }
+
+        const char *start = fmt++;
+        while (*fmt && !strchr("diouxXcsfFeEgGaAp", *fmt))  // skip flags, width, precision, and length modifiers
+            fmt++;
+
+        if (!*fmt || nArgs == 0) {  // malformed conversion or missing argument - print as is
+            if (*fmt)
+                fmt++;
+            out.write((const uint8_t *)start, fmt - start);
+            continue;
+        }
+
+        char conv = *fmt++;
+        size_t specLen = fmt - start;
+        if (specLen >= sizeof(spec))
+            specLen = sizeof(spec) - 1;
+        memcpy(spec, start, specLen);
+        spec[specLen] = '\0';
+        boolean isLong = strstr(spec, "ll") || strchr(spec, 'j');  // 64-bit integer conversion
+        boolean isFloat = strchr("fFeEgGaA", conv);
+
+        nArgs--;
+        uint8_t type = *p++;
+        int n = 0;
+
+        switch (type) {
+            case ARG_INT:
+            case ARG_INT64: {
+                int64_t v = 0;
+                if (type == ARG_INT) {
+                    int32_t v32;
+                    memcpy(&v32, p, sizeof(v32));
+                    p += sizeof(v32);
+                    v = (strchr("uoxX", conv) && !isLong) ? (int64_t)(uint32_t)v32 : v32;
+                } else {
+                    memcpy(&v, p, sizeof(v));
+                    p += sizeof(v);
+                }
+                if (isFloat)
+                    n = snprintf(buf, sizeof(buf), spec, (double)v);
+                else if (conv == 's')
+                    n = snprintf(buf, sizeof(buf), "(?)");
+                else if (isLong)
+                    n = snprintf(buf, sizeof(buf), spec, (long long)v);
+                else
+                    n = snprintf(buf, sizeof(buf), spec, (int)v);
+            } break;
+
+            case ARG_DOUBLE: {
+                double v;
+                memcpy(&v, p, sizeof(v));
+                p += sizeof(v);
+                if (isFloat)
+                    n = snprintf(buf, sizeof(buf), spec, v);
+                else if (isLong)
+                    n = snprintf(buf, sizeof(buf), spec, (long long)v);
+                else if (conv != 's' && conv != 'p')
+                    n = snprintf(buf, sizeof(buf), spec, (int)v);
+                else
+                    n = snprintf(buf, sizeof(buf), "(?)");
+            } break;
+
+            case ARG_POINTER: {
+                void *v;
+                memcpy(&v, p, sizeof(v));
+                p += sizeof(v);
+                n = snprintf(buf, sizeof(buf), (conv == 'p' || strchr("xX", conv)) ? spec : "%p", v);
+            } break;
+
+            case ARG_STRING: {
+                uint16_t len;
+                memcpy(&len, p, sizeof(len));
+                p += sizeof(len);
+                const char *s = (const char *)p;
+                p += len + 1;
+                if (conv != 's') {
+                    n = snprintf(buf, sizeof(buf), "(?)");
+                } else if (specLen == 2) {  // plain "%s" - write string directly, without any length limit
+                    out.write((const uint8_t *)s, len);
+                } else {
+                    n = snprintf(buf, sizeof(buf), spec, s);
+                    if (n >= (int)sizeof(buf)) {  // string conversions with width/precision may not fit into buf
+                        char *sBuf = (char *)malloc(n + 1);
+                        if (sBuf) {
+                            snprintf(sBuf, n + 1, spec, s);
+                            out.write((const uint8_t *)sBuf, n);
+                            free(sBuf);
+                        }
+                        n = 0;
+                    }
+                }
+            } break;
+
+            default:  // unknown type - record is corrupt
+                return;
+        }
+
+        if (n > 0)
+            out.write((const uint8_t *)buf, n < (int)sizeof(buf) ? n : sizeof(buf) - 1);
+    }
+}
@@ -0,0 +1,168 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#pragma once
+
+#include <Arduino.h>
+#include <StreamString.h>
+#include <type_traits>
+#include <freertos/ringbuf.h>
+
+// Deferred logging for the LOG1() and LOG2() macros.  Rather than formatting and writing each message to the Serial
+// port from the calling task (which stalls HAP processing for as long as the UART/USB takes to drain),
+// SpanLog::printf() packs a pointer to the format string together with the raw argument values into a record in a
+// FreeRTOS ring buffer.  A low-priority log task later pulls each record from the ring, expands it against the format
+// string, and writes the result to the Serial port.  Only format strings stored in flash (string literals) are kept
+// as pointers - any other format string, such as one built at runtime in a buffer that may be freed or reused before
+// the record is printed, is copied into the record, as are all string arguments.
+//
+// LOG0() messages remain synchronous, but first call SpanLog::flush() so that all output appears in order.  Before
+// SpanLog::begin() is called (or if a record is too large to fit into the ring) messages are printed synchronously.
+
+class SpanLog
+{
+    enum argType_t : uint8_t
+    {
+        ARG_INT,      // 32-bit integer (all integer types of 4 bytes or less, bool, char, enums)
+        ARG_INT64,    // 64-bit integer
+        ARG_DOUBLE,   // double (floats are promoted, as with any variadic call)
+        ARG_STRING,   // 16-bit length + characters + null terminator
+        ARG_POINTER,  // any non-character pointer
+    };
+
+    static const size_t MAX_STRING = 1024;  // maximum number of characters copied from any one string argument
+    static const char formatFollows;        // its address is the format pointer of a record holding a copied format
+
+    static RingbufHandle_t ring;       // ring buffer holding deferred records
+    static TaskHandle_t logTaskHandle;  // task that prints deferred records
+    static portMUX_TYPE countMux;       // protects nQueued
+    static volatile uint32_t nQueued;   // number of records placed into ring since boot
+    static volatile uint32_t nPrinted;  // number of records printed by log task since boot
+
+    // size of each packed argument, including its type byte
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, size_t>::type argSize(T)
+    {
+        return (1 + (sizeof(T) > 4 ? 8 : 4));
+    }
+
+    template <typename T> static typename std::enable_if<std::is_floating_point<T>::value, size_t>::type argSize(T)
+    {
+        return (1 + sizeof(double));
+    }
+
+    static size_t argSize(const void *) { return (1 + sizeof(void *)); }
+    static size_t argSize(const char *s) { return (1 + 2 + strLen(s) + 1); }
+    static size_t argSize(const String &s) { return (1 + 2 + strLen(s.c_str()) + 1); }
+
+    // pack each argument into record, advancing p
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type pack(uint8_t *&p, T x)
+    {
+        if (sizeof(T) > 4) {
+            int64_t v = (int64_t)x;
+            *p++ = ARG_INT64;
+            memcpy(p, &v, sizeof(v));
+            p += sizeof(v);
+        } else {
+            int32_t v = (int32_t)x;
+            *p++ = ARG_INT;
+            memcpy(p, &v, sizeof(v));
+            p += sizeof(v);
+        }
+    }
+
+    template <typename T> static typename std::enable_if<std::is_floating_point<T>::value>::type pack(uint8_t *&p, T x)
+    {
+        double v = x;
+        *p++ = ARG_DOUBLE;
+        memcpy(p, &v, sizeof(v));
+        p += sizeof(v);
+    }
+
+    static void pack(uint8_t *&p, const void *x);
+    static void pack(uint8_t *&p, const char *s);
+    static void pack(uint8_t *&p, const String &s) { pack(p, s.c_str()); }
+
+    static size_t strLen(const char *s) { return (s ? strnlen(s, MAX_STRING) : 6); }  // NULL is printed as "(null)"
+    static boolean inFlash(const char *s);  // returns true if s is stored in flash (and so remains valid forever)
+
+    static uint8_t *acquire(size_t size);                             // reserves record in ring (NULL if not possible)
+    static void commit(uint8_t *rec);                                 // releases a filled-in record to the log task
+    static void decode(const uint8_t *rec, size_t size, Print &out);  // expands record and prints to out
+    static void logTask(void *args);
+
+  public:
+    static void begin(size_t bufSize);  // creates ring buffer and starts log task
+    static void flush();                // waits until all queued records have been printed
+
+    static void write(const char *buf, size_t n);     // queues n raw characters
+    static void hexWrite(const uint8_t *buf, size_t n);  // queues n bytes as pairs of hex digits
+    static void print(const char *s) { write(s, strlen(s)); }
+    static void print(const String &s) { write(s.c_str(), s.length()); }
+
+    template <typename T> static void print(const T &x)  // prints any other type the way Serial.print() would
+    {
+        StreamString s;
+        s.print(x);
+        write(s.c_str(), s.length());
+    }
+
+    template <typename... Args> static void printf(const char *fmt, const Args &...args)
+    {
+        boolean copyFormat = !inFlash(fmt);
+        size_t size = sizeof(fmt) + 1 + (copyFormat ? argSize(fmt) : 0);
+        int sizes[] = {0, ((size += argSize(args)), 0)...};
+        (void)sizes;
+
+        uint8_t *rec = acquire(size);
+        boolean deferred = (rec != NULL);
+
+        if (!deferred && (rec = (uint8_t *)malloc(size)) == NULL)
+            return;
+
+        uint8_t *p = rec;
+        const char *fmtPtr = copyFormat ? &formatFollows : fmt;
+        memcpy(p, &fmtPtr, sizeof(fmtPtr));
+        p += sizeof(fmtPtr);
+        *p++ = sizeof...(args);
+        if (copyFormat)  // copied format precedes the arguments
+            pack(p, fmt);
+        int packs[] = {0, (pack(p, args), 0)...};
+        (void)packs;
+
+        if (deferred) {
+            commit(rec);
+        } else {
+            flush();
+            decode(rec, size, Serial);
+            free(rec);
+        }
+    }
+};
@@ -0,0 +1,152 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#include <cmath>
+
+#include "Metrics.h"
+
+const uint32_t SpanMetrics::bucketLimits[NUM_BUCKETS - 1] = {250,   500,   1000,   2500,   5000,   10000,
+                                                             25000, 50000, 100000, 250000, 500000};
+
+const char *const SpanMetrics::routeNames[NUM_ROUTES] = {
+    "pair_setup",          "pair_verify", "pairings", "get_accessories", "get_characteristics",
+    "put_characteristics", "put_prepare", "web",      "other"};
+
+SpanMetrics::histogram_t SpanMetrics::requests[NUM_ROUTES];
+SpanMetrics::histogram_t SpanMetrics::pollTime;
+SpanMetrics::route_t SpanMetrics::route = OTHER;
+uint32_t SpanMetrics::framesEncrypted = 0;
+uint32_t SpanMetrics::bytesEncrypted = 0;
+uint32_t SpanMetrics::framesDecrypted = 0;
+uint32_t SpanMetrics::bytesDecrypted = 0;
+uint32_t SpanMetrics::eventsSent = 0;
+uint32_t SpanMetrics::writesCoalesced = 0;
+uint32_t SpanMetrics::nvsCommits = 0;
+
+//////////////////////////////////////
+
+void SpanMetrics::histogram_t::add(uint32_t us)
+{
+    int i = 0;
+    while (i < NUM_BUCKETS - 1 && us > bucketLimits[i])
+        i++;
+    buckets[i]++;
+    count++;
+    sum += us;
+}
+
+//////////////////////////////////////
+
+double SpanMetrics::histogram_t::percentile(int p)
+{
+    if (!count)
+        return (NAN);
+
+    uint32_t target = (count * (uint64_t)p + 99) / 100;  // rank of p-th percentile sample (rounded up)
+    uint32_t n = 0;
+
+    for (int i = 0; i < NUM_BUCKETS - 1; i++) {
+        n += buckets[i];
+        if (n >= target)
+            return (bucketLimits[i]);
+    }
+    return (INFINITY);
+}
+
+//////////////////////////////////////
+
+SpanMetrics::route_t SpanMetrics::routeOf(const char *body)
+{
+    if (!strncmp(body, "POST /pair-setup ", 17))
+        return (PAIR_SETUP);
+    if (!strncmp(body, "POST /pair-verify ", 18))
+        return (PAIR_VERIFY);
+    if (!strncmp(body, "POST /pairings ", 15))
+        return (PAIRINGS);
+    if (!strncmp(body, "GET /accessories ", 17))
+        return (GET_ACCESSORIES);
+    if (!strncmp(body, "GET /characteristics?", 21))
+        return (GET_CHARACTERISTICS);
+    if (!strncmp(body, "PUT /characteristics ", 21))
+        return (PUT_CHARACTERISTICS);
+    if (!strncmp(body, "PUT /prepare ", 13))
+        return (PUT_PREPARE);
+    if (!strncmp(body, "GET /", 5))  // Web Log status, trace, and metrics pages
+        return (WEB);
+    return (OTHER);
+}
+
+//////////////////////////////////////
+
+void SpanMetrics::print(std::ostream &out)
+{
+    out << "# TYPE homespan_request_duration_microseconds histogram\n";
+    for (int r = 0; r < NUM_ROUTES; r++) {
+        if (!requests[r].count)
+            continue;
+        uint32_t n = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            n += requests[r].buckets[i];
+            out << "homespan_request_duration_microseconds_bucket{route=\"" << routeNames[r] << "\",le=\"";
+            if (i < NUM_BUCKETS - 1)
+                out << bucketLimits[i];
+            else
+                out << "+Inf";
+            out << "\"} " << n << "\n";
+        }
+        out << "homespan_request_duration_microseconds_sum{route=\"" << routeNames[r] << "\"} "
+            << requests[r].sum << "\n";
+        out << "homespan_request_duration_microseconds_count{route=\"" << routeNames[r] << "\"} "
+            << requests[r].count << "\n";
+    }
+
+    out << "# TYPE homespan_poll_duration_microseconds summary\n";
+    const int quantiles[] = {50, 90, 99};
+    for (int q : quantiles) {
+        out << "homespan_poll_duration_microseconds{quantile=\"0." << q << "\"} ";
+        double us = pollTime.percentile(q);
+        if (std::isnan(us))  // no polls timed yet
+            out << "NaN\n";
+        else if (std::isinf(us))
+            out << "+Inf\n";
+        else
+            out << (uint32_t)us << "\n";
+    }
+    out << "homespan_poll_duration_microseconds_sum " << pollTime.sum << "\n";
+    out << "homespan_poll_duration_microseconds_count " << pollTime.count << "\n";
+
+    out << "# TYPE homespan_frames_encrypted_total counter\nhomespan_frames_encrypted_total " << framesEncrypted
+        << "\n";
+    out << "# TYPE homespan_bytes_encrypted_total counter\nhomespan_bytes_encrypted_total " << bytesEncrypted << "\n";
+    out << "# TYPE homespan_frames_decrypted_total counter\nhomespan_frames_decrypted_total " << framesDecrypted
+        << "\n";
+    out << "# TYPE homespan_bytes_decrypted_total counter\nhomespan_bytes_decrypted_total " << bytesDecrypted << "\n";
+    out << "# TYPE homespan_events_sent_total counter\nhomespan_events_sent_total " << eventsSent << "\n";
+    out << "# TYPE homespan_writes_coalesced_total counter\nhomespan_writes_coalesced_total " << writesCoalesced
+        << "\n";
+    out << "# TYPE homespan_nvs_commits_total counter\nhomespan_nvs_commits_total " << nvsCommits << "\n";
+}
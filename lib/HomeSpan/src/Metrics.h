@@ -0,0 +1,80 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#pragma once
+
+#include <Arduino.h>
+#include <ostream>
+
+struct SpanMetrics
+{  // request, encryption, and poll-loop metrics served with the Web Log at <status-url>/metrics
+
+    enum route_t : uint8_t
+    {
+        PAIR_SETUP,
+        PAIR_VERIFY,
+        PAIRINGS,
+        GET_ACCESSORIES,
+        GET_CHARACTERISTICS,
+        PUT_CHARACTERISTICS,
+        PUT_PREPARE,
+        WEB,
+        OTHER,
+        NUM_ROUTES
+    };
+
+    static const int NUM_BUCKETS = 12;                     // number of histogram buckets (last bucket is unbounded)
+    static const uint32_t bucketLimits[NUM_BUCKETS - 1];  // upper bound of each bounded bucket (in microseconds)
+    static const char *const routeNames[NUM_ROUTES];      // route labels
+
+    struct histogram_t
+    {                                         // fixed-bucket histogram - updating never allocates
+        uint32_t buckets[NUM_BUCKETS] = {0};  // number of samples in each bucket
+        uint32_t count = 0;                   // total number of samples
+        uint64_t sum = 0;                     // sum of all samples (in microseconds)
+
+        void add(uint32_t us);     // adds sample
+        double percentile(int p);  // returns upper bound of bucket containing the p-th percentile (+Inf if unbounded,
+                                   // NaN if there are no samples)
+    };
+
+    // metrics are updated only from the HomeSpan polling task, so no locking is needed
+
+    static histogram_t requests[NUM_ROUTES];  // request latency per route
+    static histogram_t pollTime;              // time spent in each call to pollTask()
+    static route_t route;                     // route of request currently being processed
+    static uint32_t framesEncrypted;          // number of frames encrypted and sent
+    static uint32_t bytesEncrypted;           // number of plaintext bytes encrypted and sent
+    static uint32_t framesDecrypted;          // number of frames received and decrypted
+    static uint32_t bytesDecrypted;           // number of plaintext bytes received and decrypted
+    static uint32_t eventsSent;               // number of EVENT messages sent to Controllers
+    static uint32_t writesCoalesced;          // number of Characteristic writes held for write-coalescing
+    static uint32_t nvsCommits;               // number of Characteristic NVS commits
+
+    static route_t routeOf(const char *body);  // returns route of HTTP request
+    static void print(std::ostream &out);      // writes all metrics to out (e.g. hapOut) in Prometheus text format
+};
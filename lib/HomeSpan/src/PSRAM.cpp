@@ -0,0 +1,172 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <soc/soc_memory_layout.h>
+
+#include "PSRAM.h"
+
+// Placement policy for each hsMemTag.  Allocations are first attempted with caps; if that fails and fallbackCaps is
+// non-zero, they are attempted again with fallbackCaps.  On boards without PSRAM, MALLOC_CAP_SPIRAM allocations always
+// fall back to the default (internal) heap.
+
+struct hsMemPolicy
+{
+    const char *name;       // tag name shown in 'm' report
+    uint32_t caps;          // preferred heap capabilities
+    uint32_t fallbackCaps;  // heap capabilities to use if preferred heap is exhausted (0=none)
+};
+
+static const hsMemPolicy memPolicy[HS_MEM_NTAGS] = {
+    {"Values", MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL, MALLOC_CAP_DEFAULT},
+    {"Network", MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL, 0},  // HAP stream buffers must stay in internal RAM
+    {"Crypto", MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL, 0},
+    {"Metadata", MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT},
+    {"WebLog", MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT},
+    {"Cache", MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT},
+};
+
+struct hsMemStats
+{
+    uint32_t count;     // number of live allocations
+    uint32_t bytes;     // live bytes (as reported by the heap, including rounding)
+    uint32_t peak;      // maximum live bytes
+    uint32_t internal;  // live bytes that ended up in internal RAM
+    uint32_t failures;  // number of allocations that failed
+};
+
+static hsMemStats memStats[HS_MEM_NTAGS];
+static portMUX_TYPE memMux = portMUX_INITIALIZER_UNLOCKED;  // tagged allocations may be made from any task
+
+//////////////////////////////////////
+
+static void memAccount(void *ptr, hsMemTag tag, int sign)
+{
+    if (!ptr)
+        return;
+
+    size_t size = heap_caps_get_allocated_size(ptr);
+    boolean internal = esp_ptr_internal(ptr);
+
+    portENTER_CRITICAL(&memMux);
+    hsMemStats *s = memStats + tag;
+    s->count += sign;
+    s->bytes += sign * (int)size;
+    if (internal)
+        s->internal += sign * (int)size;
+    if (s->bytes > s->peak)
+        s->peak = s->bytes;
+    portEXIT_CRITICAL(&memMux);
+}
+
+//////////////////////////////////////
+
+static void memFailed(hsMemTag tag)
+{
+    portENTER_CRITICAL(&memMux);
+    memStats[tag].failures++;
+    portEXIT_CRITICAL(&memMux);
+}
+
+//////////////////////////////////////
+
+void *hs_malloc(size_t size, hsMemTag tag)
+{
+    const hsMemPolicy *p = memPolicy + tag;
+
+    void *ptr = heap_caps_malloc(size, p->caps);
+    if (!ptr && p->fallbackCaps)
+        ptr = heap_caps_malloc(size, p->fallbackCaps);
+
+    if (ptr)
+        memAccount(ptr, tag, 1);
+    else
+        memFailed(tag);
+
+    return (ptr);
+}
+
+//////////////////////////////////////
+
+void *hs_calloc(size_t n, size_t size, hsMemTag tag)
+{
+    void *ptr = hs_malloc(n * size, tag);
+    if (ptr)
+        memset(ptr, 0, n * size);
+    return (ptr);
+}
+
+//////////////////////////////////////
+
+void *hs_realloc(void *ptr, size_t size, hsMemTag tag)
+{
+    const hsMemPolicy *p = memPolicy + tag;
+
+    memAccount(ptr, tag, -1);
+
+    void *newPtr = heap_caps_realloc(ptr, size, p->caps);
+    if (!newPtr && p->fallbackCaps)
+        newPtr = heap_caps_realloc(ptr, size, p->fallbackCaps);
+
+    if (newPtr) {
+        memAccount(newPtr, tag, 1);
+    } else {
+        memAccount(ptr, tag, 1);  // original block is left unchanged if reallocation fails
+        memFailed(tag);
+    }
+
+    return (newPtr);
+}
+
+//////////////////////////////////////
+
+void hs_free(void *ptr, hsMemTag tag)
+{
+    memAccount(ptr, tag, -1);
+    heap_caps_free(ptr);
+}
+
+//////////////////////////////////////
+
+void hs_memReport()
+{
+    hsMemStats stats[HS_MEM_NTAGS];
+
+    portENTER_CRITICAL(&memMux);
+    memcpy(stats, memStats, sizeof(stats));
+    portEXIT_CRITICAL(&memMux);
+
+    Serial.printf("Memory Tag  Placement    Allocs     Bytes  Internal      Peak  Failures\n");
+    Serial.printf("----------  ---------  --------- --------- --------- --------- ---------\n");
+    for (int i = 0; i < HS_MEM_NTAGS; i++) {
+        Serial.printf("%10s  %9s  %9u %9u %9u %9u %9u\n", memPolicy[i].name,
+                      (memPolicy[i].caps & MALLOC_CAP_SPIRAM) ? "PSRAM" : "Internal", stats[i].count, stats[i].bytes,
+                      stats[i].internal, stats[i].peak, stats[i].failures);
+    }
+    Serial.printf("\n");
+}
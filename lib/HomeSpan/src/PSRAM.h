@@ -75,4 +75,151 @@ bool operator!=(const Mallocator<T> &, const Mallocator<U> &)
     return false;
 }
 
+// Fixed pool of N equal-sized slots allocated in a single block the first time it is needed and never freed.  Shared
+// by all SlabAllocators with the same Tag so that node-based containers (which rebind the allocator to their internal
+// node type) draw from one pool.  Requests that do not fit in a slot, or that arrive when all slots are in use, fall
+// back to the heap and are counted in fallbacks.
+
+template <class Tag, std::size_t N>
+struct SlabPool
+{
+    static_assert(N <= 32, "SlabPool supports at most 32 slots");
+
+    static uint8_t *slots;        // single block of N slots
+    static std::size_t slotSize;  // size of each slot (set by first allocation)
+    static uint32_t inUse;        // bitmask of slots in use
+    static uint32_t fallbacks;    // number of allocations that fell back to the heap
+
+    static int used() { return (__builtin_popcount(inUse)); }
+    static int capacity() { return (N); }
+};
+
+template <class Tag, std::size_t N>
+uint8_t *SlabPool<Tag, N>::slots = NULL;
+template <class Tag, std::size_t N>
+std::size_t SlabPool<Tag, N>::slotSize = 0;
+template <class Tag, std::size_t N>
+uint32_t SlabPool<Tag, N>::inUse = 0;
+template <class Tag, std::size_t N>
+uint32_t SlabPool<Tag, N>::fallbacks = 0;
+
+template <class T, std::size_t N, class Tag = T>
+struct SlabAllocator
+{
+    typedef T value_type;
+    typedef SlabPool<Tag, N> pool;
+
+    template <class U>
+    struct rebind
+    {
+        typedef SlabAllocator<U, N, Tag> other;
+    };
+
+    SlabAllocator() = default;
+    template <class U>
+    constexpr SlabAllocator(const SlabAllocator<U, N, Tag> &)
+    {
+    }
+
+    [[nodiscard]] T *allocate(std::size_t n)
+    {
+        if (n == 1 && (pool::slotSize == 0 || pool::slotSize == sizeof(T))) {
+            if (pool::slots == NULL) {
+                pool::slotSize = sizeof(T);
+                pool::slots = (uint8_t *)Mallocator<uint8_t>().allocate(N * sizeof(T));
+            }
+            for (std::size_t i = 0; i < N; i++) {
+                if (!(pool::inUse & (1UL << i))) {
+                    pool::inUse |= (1UL << i);
+                    return ((T *)(pool::slots + i * sizeof(T)));
+                }
+            }
+        }
+        pool::fallbacks++;
+        return (Mallocator<T>().allocate(n));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept
+    {
+        uint8_t *b = (uint8_t *)p;
+        if (pool::slots && b >= pool::slots && b < pool::slots + N * pool::slotSize)
+            pool::inUse &= ~(1UL << ((b - pool::slots) / pool::slotSize));
+        else
+            std::free(p);
+    }
+};
+template <class T, class U, std::size_t N, class Tag>
+bool operator==(const SlabAllocator<T, N, Tag> &, const SlabAllocator<U, N, Tag> &)
+{
+    return true;
+}
+template <class T, class U, std::size_t N, class Tag>
+bool operator!=(const SlabAllocator<T, N, Tag> &, const SlabAllocator<U, N, Tag> &)
+{
+    return false;
+}
+
 #endif
+
+// Tagged allocations for HomeSpan data whose placement matters.  Each tag maps to an entry in a placement policy table
+// (see PSRAM.cpp) so that hot data used on every request stays in fast internal SRAM, while cold bulk data goes to
+// PSRAM when the board has it.  Live bytes are tracked per tag and reported by the 'm' serial command.  Memory
+// allocated with a tag must be released (or reallocated) with the same tag.
+
+enum hsMemTag : uint8_t
+{
+    HS_MEM_VALUES,    // Characteristic string values (hot)
+    HS_MEM_NETWORK,   // HAP stream buffers and per-request buffers (hot)
+    HS_MEM_CRYPTO,    // hash contexts and SRP pairing state (hot)
+    HS_MEM_METADATA,  // Characteristic descriptions, units, and valid-values strings (cold)
+    HS_MEM_WEBLOG,    // Web Log entries (cold)
+    HS_MEM_CACHE,     // cached GET /characteristics query plans and JSON bodies (cold)
+    HS_MEM_NTAGS
+};
+
+void *hs_malloc(size_t size, hsMemTag tag);
+void *hs_calloc(size_t n, size_t size, hsMemTag tag);
+void *hs_realloc(void *ptr, size_t size, hsMemTag tag);
+void hs_free(void *ptr, hsMemTag tag);
+void hs_memReport();  // prints placement, live allocations, and bytes for each tag
+
+template <class T, hsMemTag TAG>
+struct TagAllocator
+{
+    typedef T value_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef TagAllocator<U, TAG> other;
+    };
+
+    TagAllocator() = default;
+    template <class U>
+    constexpr TagAllocator(const TagAllocator<U, TAG> &)
+    {
+    }
+
+    [[nodiscard]] T *allocate(std::size_t n)
+    {
+        auto p = static_cast<T *>(hs_malloc(n * sizeof(T), TAG));
+        if (p == NULL) {
+            Serial.printf("\n\n*** FATAL ERROR: Requested allocation of %d bytes failed.  Program Halting.\n\n",
+                          n * sizeof(T));
+            while (1)
+                ;
+        }
+        return p;
+    }
+    void deallocate(T *p, std::size_t) noexcept { hs_free(p, TAG); }
+};
+template <class T, class U, hsMemTag TAG>
+bool operator==(const TagAllocator<T, TAG> &, const TagAllocator<U, TAG> &)
+{
+    return true;
+}
+template <class T, class U, hsMemTag TAG>
+bool operator!=(const TagAllocator<T, TAG> &, const TagAllocator<U, TAG> &)
+{
+    return false;
+}
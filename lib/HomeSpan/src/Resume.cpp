@@ -0,0 +1,129 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#include <sodium.h>
+
+#include "Resume.h"
+#include "HKDF.h"
+
+using namespace PairResume;
+
+static session_t sessions[MAX_SESSIONS];  // cache of resumable sessions
+
+//////////////////////////////////////
+
+void PairResume::save(const uint8_t *sessionID, const uint8_t *sharedSecret, const uint8_t *controllerID)
+{
+    session_t *session = sessions;  // default to first entry
+
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (!sessions[i].active) {  // found unused entry
+            session = sessions + i;
+            break;
+        }
+        if (millis() - sessions[i].createTime > millis() - session->createTime)  // otherwise replace oldest session
+            session = sessions + i;
+    }
+
+    memcpy(session->sessionID, sessionID, hap_session_IDBYTES);
+    memcpy(session->sharedSecret, sharedSecret, 32);
+    memcpy(session->controllerID, controllerID, hap_controller_IDBYTES);
+    session->createTime = millis();
+    session->active = true;
+}
+
+//////////////////////////////////////
+
+session_t *PairResume::find(const uint8_t *sessionID)
+{
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (!sessions[i].active)
+            continue;
+
+        if (millis() - sessions[i].createTime > SESSION_LIFE) {  // session has expired
+            sodium_memzero(sessions + i, sizeof(session_t));
+            continue;
+        }
+
+        if (!memcmp(sessions[i].sessionID, sessionID, hap_session_IDBYTES))
+            return (sessions + i);
+    }
+
+    return (NULL);
+}
+
+//////////////////////////////////////
+
+void PairResume::clear(const uint8_t *id)
+{
+    for (int i = 0; i < MAX_SESSIONS; i++) {
+        if (id == NULL || !memcmp(sessions[i].controllerID, id, hap_controller_IDBYTES))
+            sodium_memzero(sessions + i, sizeof(session_t));
+    }
+}
+
+//////////////////////////////////////
+
+boolean PairResume::resume(session_t *session, const uint8_t *iosCurveKey, const uint8_t *encData, size_t encLen,
+                           uint8_t *newSessionID, uint8_t *responseTag, uint8_t *sharedSecret)
+{
+    uint8_t salt[crypto_box_PUBLICKEYBYTES + hap_session_IDBYTES];  // salt = Controller's Curve25519 Key | Session ID
+    uint8_t resumeKey[32];
+    uint8_t controllerID[hap_controller_IDBYTES];
+
+    memcpy(salt, iosCurveKey, crypto_box_PUBLICKEYBYTES);
+    memcpy(salt + crypto_box_PUBLICKEYBYTES, session->sessionID, hap_session_IDBYTES);
+
+    HKDF::create(resumeKey, session->sharedSecret, 32, salt, sizeof(salt),
+                 "Pair-Resume-Request-Info");  // create Request Key from cached Shared-Secret
+
+    if (encLen != crypto_aead_chacha20poly1305_IETF_ABYTES ||  // EncryptedData is an Authentication Tag of empty data
+        crypto_aead_chacha20poly1305_ietf_decrypt(NULL, NULL, NULL, encData, encLen, NULL, 0,
+                                                  (unsigned char *)"\x00\x00\x00\x00PR-Msg01", resumeKey) == -1) {
+        sodium_memzero(resumeKey, sizeof(resumeKey));
+        return (false);
+    }
+
+    randombytes_buf(newSessionID, hap_session_IDBYTES);                           // generate new random Session ID
+    memcpy(salt + crypto_box_PUBLICKEYBYTES, newSessionID, hap_session_IDBYTES);  // salt = Controller Key | new ID
+
+    HKDF::create(resumeKey, session->sharedSecret, 32, salt, sizeof(salt),
+                 "Pair-Resume-Response-Info");  // create Response Key from cached Shared-Secret
+
+    crypto_aead_chacha20poly1305_ietf_encrypt(responseTag, NULL, (unsigned char *)"", 0, NULL, 0, NULL,
+                                              (unsigned char *)"\x00\x00\x00\x00PR-Msg02", resumeKey);
+
+    HKDF::create(sharedSecret, session->sharedSecret, 32, salt, sizeof(salt),
+                 "Pair-Resume-Shared-Secret-Info");  // derive new Shared-Secret for the resumed session
+
+    memcpy(controllerID, session->controllerID, hap_controller_IDBYTES);
+    sodium_memzero(resumeKey, sizeof(resumeKey));
+    sodium_memzero(session, sizeof(session_t));  // each Session ID can only be resumed once
+
+    save(newSessionID, sharedSecret, controllerID);  // cache new session so it can be resumed again
+    return (true);
+}
@@ -0,0 +1,80 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "HAPConstants.h"
+
+/////////////////////////////////////////////////
+// Pair-Resume Session Cache (HAP Section 7.3.6)
+//
+// Sessions verified with pair-verify (or pair-resume) are
+// cached so a returning Controller can resume the session
+// with a pair-resume request, which derives new session keys
+// using only HKDF.  Each cached session can be resumed only
+// once, expires SESSION_LIFE ms after it was cached, and the
+// oldest session is replaced when the cache is full.  The
+// cache is kept in internal RAM.
+
+namespace PairResume {
+
+const int MAX_SESSIONS = 8;              // maximum number of verified sessions cached for pair-resume
+const uint32_t SESSION_LIFE = 3600000;  // time (in ms) a cached session can be resumed (1 hour)
+
+struct session_t
+{
+    uint8_t sessionID[hap_session_IDBYTES];        // Session ID derived when session was verified
+    uint8_t sharedSecret[32];                      // Shared-Secret of verified session (used to derive new keys)
+    uint8_t controllerID[hap_controller_IDBYTES];  // ID of Controller that verified the session
+    uint32_t createTime;                           // millis() time when session was cached
+    boolean active;                                // true if entry holds a valid session
+};
+
+// caches verified session for later pair-resume, replacing the oldest cached session if the cache is full
+void save(const uint8_t *sessionID, const uint8_t *sharedSecret, const uint8_t *controllerID);
+
+// returns pointer to unexpired cached session with matching ID (or NULL if no match)
+session_t *find(const uint8_t *sessionID);
+
+// wipes cached sessions for Controller with ID=id; wipes all cached sessions if id=NULL
+void clear(const uint8_t *id);
+
+// authenticates pair-resume M1 request for 'session' from the Controller's Curve25519 Key and the EncryptedData
+// (an Authentication Tag of empty data).  If authentic, creates a new Session ID, the Authentication Tag to send in
+// M2, and the new Shared-Secret, then wipes 'session' and caches the new session in its place.  Returns false
+// (leaving 'session' unchanged) if the request is not authentic, in which case a full pair-verify is needed.
+boolean resume(session_t *session,
+               const uint8_t *iosCurveKey,
+               const uint8_t *encData,
+               size_t encLen,
+               uint8_t *newSessionID,
+               uint8_t *responseTag,
+               uint8_t *sharedSecret);
+
+};  // namespace PairResume
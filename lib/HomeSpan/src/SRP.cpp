@@ -29,6 +29,7 @@
 #include <Arduino.h>
 
 #include "SRP.h"
+#include "Log.h"
 
 /////////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////////
@@ -37,8 +38,6 @@ SRP6A::SRP6A()
 {
     // initialize MPI structures
 
-    mbedtls_mpi_init(&N);
-    mbedtls_mpi_init(&g);
     mbedtls_mpi_init(&s);
     mbedtls_mpi_init(&x);
     mbedtls_mpi_init(&v);
@@ -46,25 +45,18 @@ SRP6A::SRP6A()
     mbedtls_mpi_init(&b);
     mbedtls_mpi_init(&B);
     mbedtls_mpi_init(&S);
-    mbedtls_mpi_init(&k);
     mbedtls_mpi_init(&u);
-    mbedtls_mpi_init(&_rr);
     mbedtls_mpi_init(&t1);
     mbedtls_mpi_init(&t2);
     mbedtls_mpi_init(&t3);
 
-    // load N and g into MPI structures
-
-    mbedtls_mpi_read_string(&N, 16, N3072);
-    mbedtls_mpi_lset(&g, g3072);
+    loadGroup();  // load N and g, and compute k, hNgI and _rr (only done once for all instances)
 }
 
 //////////////////////////////////////
 
 SRP6A::~SRP6A()
 {
-    mbedtls_mpi_free(&N);
-    mbedtls_mpi_free(&g);
     mbedtls_mpi_free(&s);
     mbedtls_mpi_free(&x);
     mbedtls_mpi_free(&v);
@@ -72,9 +64,7 @@ SRP6A::~SRP6A()
     mbedtls_mpi_free(&b);
     mbedtls_mpi_free(&B);
     mbedtls_mpi_free(&S);
-    mbedtls_mpi_free(&k);
     mbedtls_mpi_free(&u);
-    mbedtls_mpi_free(&_rr);
     mbedtls_mpi_free(&t1);
     mbedtls_mpi_free(&t2);
     mbedtls_mpi_free(&t3);
@@ -82,6 +72,58 @@ SRP6A::~SRP6A()
 
 //////////////////////////////////////
 
+void SRP6A::loadGroup()
+{
+    if (groupLoaded)  // group constants never change, so they only need to be computed once
+        return;
+
+    TempBuffer<uint8_t> tBuf(768);  // temporary buffer for staging
+    TempBuffer<uint8_t> tHash(64);  // temporary buffer for storing SHA-512 results
+
+    mbedtls_mpi_init(&N);
+    mbedtls_mpi_init(&g);
+    mbedtls_mpi_init(&k);
+    mbedtls_mpi_init(&_rr);
+
+    // load N and g into MPI structures
+
+    mbedtls_mpi_read_string(&N, 16, N3072);
+    mbedtls_mpi_lset(&g, g3072);
+
+    // compute k = SHA512( N | PAD(g) )
+
+    mbedtls_mpi_write_binary(&N, tBuf, 384);  // write N into first half of staging buffer
+    mbedtls_mpi_write_binary(&g, tBuf + 384,
+                             384);  // write g into second half of staging buffer (fully padded with leading zeros)
+    mbedtls_sha512_ret(tBuf, 768, tHash, 0);  // create hash of data
+    mbedtls_mpi_read_binary(&k, tHash, 64);   // load hash result into k
+
+    // compute hNgI = SHA512(N) xor SHA512(g) | SHA512(I), the fixed part of M1V used in verifyClientProof()
+
+    mbedtls_sha512_ret(tBuf, 384, tHash, 0);  // create hash of N (still in first half of staging buffer)
+    mbedtls_sha512_ret(&g3072, 1, hNgI, 0);   // create hash of g, but place output directly into hNgI
+
+    for (int i = 0; i < 64; i++)  // H(g) ->  H(g) XOR H(N), with results in first 64 bytes of hNgI
+        hNgI[i] ^= tHash[i];
+
+    mbedtls_sha512_ret((uint8_t *)I, strlen(I), hNgI + 64, 0);  // create hash of userName and place in last 64 bytes
+
+    // pre-compute the Montgomery helper R^2 %N, which mbedtls stores in _rr the first time it is used and then re-uses
+    // for every subsequent exponential modulus of any instance (g^x, g^b, v^u, and (A*v^u)^b all share the same N)
+
+    mbedtls_mpi one, t;
+    mbedtls_mpi_init(&one);
+    mbedtls_mpi_init(&t);
+    mbedtls_mpi_lset(&one, 1);
+    mbedtls_mpi_exp_mod(&t, &g, &one, &N, &_rr);  // t = g^1 %N (result is not needed - only the side effect on _rr)
+    mbedtls_mpi_free(&one);
+    mbedtls_mpi_free(&t);
+
+    groupLoaded = true;
+}
+
+//////////////////////////////////////
+
 void SRP6A::createVerifyCode(const char *setupCode, Verification *vData)
 {
     TempBuffer<uint8_t> tBuf(80);   // temporary buffer for staging
@@ -116,10 +158,8 @@ void SRP6A::createVerifyCode(const char *setupCode, Verification *vData)
 
 //////////////////////////////////////
 
-void SRP6A::createPublicKey(const Verification *vData, uint8_t *publicKey)
+void SRP6A::createKeys(const Verification *vData)
 {
-    TempBuffer<uint8_t> tBuf(768);       // temporary buffer for staging
-    TempBuffer<uint8_t> tHash(64);       // temporary buffer for storing SHA-512 results
     TempBuffer<uint8_t> privateKey(32);  // temporary buffer for generating private key random numbers
 
     // load stored salt, s, and verification code, v
@@ -132,27 +172,32 @@ void SRP6A::createPublicKey(const Verification *vData, uint8_t *publicKey)
     randombytes_buf(privateKey, 32);              // generate 32 random bytes for private key
     mbedtls_mpi_read_binary(&b, privateKey, 32);  // load private key into b
 
-    // compute k = SHA512( N | PAD(g) )
-
-    mbedtls_mpi_write_binary(&N, tBuf, 384);  // write N into first half of staging buffer
-    mbedtls_mpi_write_binary(&g, tBuf + 384,
-                             384);  // write g into second half of staging buffer (fully padded with leading zeros)
-    mbedtls_sha512_ret(tBuf, 768, tHash, 0);  // create hash of data
-    mbedtls_mpi_read_binary(&k, tHash, 64);   // load hash result into k
-
-    // compute B = (k*v + g^b) %N
+    // compute B = (k*v + g^b) %N, where k was pre-computed in loadGroup()
 
     mbedtls_mpi_mul_mpi(&t1, &k, &v);            // t1 = k*v
     mbedtls_mpi_exp_mod(&t2, &g, &b, &N, &_rr);  // t2 = g^b %N
     mbedtls_mpi_add_mpi(&t3, &t1, &t2);          // t3 = t1 + t2
     mbedtls_mpi_mod_mpi(&B, &t3, &N);            // B = t3 %N      = ACCESSORY PUBLIC KEY
+}
+
+//////////////////////////////////////
 
+void SRP6A::writePublicKey(uint8_t *publicKey)
+{
     mbedtls_mpi_write_binary(&B, publicKey,
                              384);  // write B into publicKey (padding with initial zeros is less than 384 bytes)
 }
 
 //////////////////////////////////////
 
+void SRP6A::createPublicKey(const Verification *vData, uint8_t *publicKey)
+{
+    createKeys(vData);
+    writePublicKey(publicKey);
+}
+
+//////////////////////////////////////
+
 void SRP6A::createSessionKey(const uint8_t *publicKey, size_t len)
 {
     TempBuffer<uint8_t> tBuf(768);  // temporary buffer for staging
@@ -198,15 +243,7 @@ int SRP6A::verifyClientProof(const uint8_t *proof)
 
     // compute M1V = SHA512( SHA512(N) xor SHA512(g) | SHA512(I) | s | A | B | K )
 
-    mbedtls_mpi_write_binary(&N, tBuf, 384);  // write N into staging buffer
-    mbedtls_sha512_ret(tBuf, 384, tHash, 0);  // create hash of data
-    mbedtls_sha512_ret(&g3072, 1, tBuf, 0);   // create hash of g, but place output directly into staging buffer
-
-    for (int i = 0; i < 64; i++)  // H(g) ->  H(g) XOR H(N), with results in first 64 bytes of staging buffer
-        tBuf[i] ^= tHash[i];
-
-    mbedtls_sha512_ret((uint8_t *)I, strlen(I), tBuf + 64,
-                       0);  // create hash of userName and concatenate result to end of staging buffer
+    memcpy(tBuf, hNgI, 128);  // copy pre-computed H(N) XOR H(g) | H(I) into first 128 bytes of staging buffer
 
     mbedtls_mpi_write_binary(&s, tBuf + 128, 16);  // concatenate s to staging buffer
 
@@ -258,11 +295,18 @@ void SRP6A::print(mbedtls_mpi *mpi)
 
     // subtract 1 for null-terminator, and then divide by 2 to get number of bytes (e.g. 4F = 2 characters, but
     // represents just one mpi byte)
-    Serial.printf("%d %s\n", (sLen - 1) / 2, sBuf.get());
+    SpanLog::printf("%d %s\n", (sLen - 1) / 2, sBuf.get());
 }
 
 //////////////////////////////////////
 
+mbedtls_mpi SRP6A::N;
+mbedtls_mpi SRP6A::g;
+mbedtls_mpi SRP6A::k;
+mbedtls_mpi SRP6A::_rr;
+uint8_t SRP6A::hNgI[128];
+boolean SRP6A::groupLoaded = false;
+
 constexpr char SRP6A::N3072[];
 constexpr char SRP6A::I[];
 const uint8_t SRP6A::g3072;
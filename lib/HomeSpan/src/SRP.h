@@ -70,11 +70,15 @@ struct SRP6A
     static constexpr char I[] = "Pair-Setup";
 
     // N                            - 3072-bit Group pre-defined prime used for all SRP-6A calculations (384 bytes)
-    mbedtls_mpi N;
+    static mbedtls_mpi N;
     // g                            - pre-defined generator for the specified 3072-bit Group (g=5)
-    mbedtls_mpi g;
+    static mbedtls_mpi g;
     // k = H(N | PAD(g))            - SRP-6A multiplier (which is different from versions SRP-6 or SRP-3)
-    mbedtls_mpi k;
+    static mbedtls_mpi k;
+    // hNgI = H(N) xor H(g) | H(I)  - fixed leading portion of the M1 proof computation (128 bytes)
+    static uint8_t hNgI[128];
+    // groupLoaded                  - flag indicating N, g, k, hNgI and _rr have been computed (done only once)
+    static boolean groupLoaded;
     // s                            - randomly-generated salt (16 bytes)
     mbedtls_mpi s;
     // x = H(s | H(I | ":" | P))    - salted, double-hash of username and password (64 bytes)
@@ -103,19 +107,28 @@ struct SRP6A
     mbedtls_mpi t2;
     // temp3                        - temporary mpi structures for intermediate results
     mbedtls_mpi t3;
-    // _rr                          - temporary "helper" for large exponential modulus calculations
-    mbedtls_mpi _rr;
+    // _rr                          - Montgomery "helper" (R^2 %N) for large exponential modulus calculations
+    // (shared by all instances since N never changes)
+    static mbedtls_mpi _rr;
 
-    // initializes N, G, and computes k
+    // initializes N, g, and computes k, hNgI and _rr the first time it is called
+    static void loadGroup();
+
+    // initializes per-session mpi structures and loads the (shared) group constants
     SRP6A();
     ~SRP6A();
 
-    // override new operator to use PSRAM when available
-    void *operator new(size_t size) { return (HS_MALLOC(size)); }
+    // override new and delete operators to keep pairing state in internal RAM
+    void *operator new(size_t size) { return (hs_malloc(size, HS_MEM_CRYPTO)); }
+    void operator delete(void *p) { hs_free(p, HS_MEM_CRYPTO); }
 
     // generates random s and computes v; writes back resulting Verification Data
     void createVerifyCode(const char *setupCode, Verification *vData);
-    // generates random b and computes k and B; writes back resulting Accessory Public Key
+    // loads s and v from Verification Data, generates random b and computes B (using pre-computed k)
+    void createKeys(const Verification *vData);
+    // writes back Accessory Public Key, B, previously computed in createKeys()
+    void writePublicKey(uint8_t *publicKey);
+    // generates random b and computes B (using pre-computed k); writes back resulting Accessory Public Key
     void createPublicKey(const Verification *vData, uint8_t *publicKey);
     // computes u, S, and K from Client Public Key, A (of variable length)
     void createSessionKey(const uint8_t *publicKey, size_t len);
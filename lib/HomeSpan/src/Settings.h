@@ -62,12 +62,33 @@
 // change with optional fourth argument in homeSpan.enableWebLog()
 #define DEFAULT_WEBLOG_URL "status"
 
+// number of bytes reserved in the Web Log ring for each of the maxEntries specified in homeSpan.enableWebLog()
+#define DEFAULT_WEBLOG_ENTRY_SIZE 128
+
+// maximum size (including null terminator) of a single Web Log message - longer messages are truncated
+#define MAX_WEBLOG_MESSAGE 256
+
 // default low watermark memory (for internal RAM) threshold that triggers warning
 #define DEFAULT_LOW_MEM_THRESHOLD 80000
 
 // default time (in milliseconds) to check for reboot callback
 #define DEFAULT_REBOOT_CALLBACK_TIME 5000
 
+// change with homeSpan.setQueryCacheSize() - number of parsed GET /characteristics requests to cache (0=disable)
+#define DEFAULT_QUERY_CACHE_SIZE 8
+
+// change with homeSpan.setUpdateQueueSize() - max number of pending setValAsync() and setValFromISR() updates
+#define DEFAULT_UPDATE_QUEUE_SIZE 32
+
+// number of HAP client connections held in a fixed slab (additional connections are allocated from the heap)
+#define MAX_CLIENT_SLOTS 16
+
+// initial size (in bytes) of the per-request arena used to hold HTTP buffers while a request is processed
+#define DEFAULT_REQUEST_ARENA_SIZE 2048
+
+// size (in bytes) of the ring buffer holding deferred LOG1() and LOG2() messages (0=print all messages synchronously)
+#define DEFAULT_LOG_BUFFER_SIZE 4096
+
 /////////////////////////////////////////////////////
 //              OTA PARTITION INFO                 //
 
@@ -88,22 +109,50 @@
 //      Message Log Level Control Macros           //
 //       0=Minimal, 1=Informative, 2=All           //
 
+// LOG0() is synchronous (after flushing any deferred messages); LOG1() and LOG2() are deferred to the log task (see
+// Log.h).  Levels above HS_MAX_LOG_LEVEL are compiled out entirely, though their arguments are still type-checked.
+// Set it with a build flag, e.g. -DHS_MAX_LOG_LEVEL=1 to compile out LOG2() (see platformio.ini).
+
+#ifndef HS_MAX_LOG_LEVEL
+#    define HS_MAX_LOG_LEVEL 2
+#endif
+
 #define LOG0(format, ...)                                                   \
     do {                                                                    \
-        if (homeSpan.getLogLevel() >= 0)                                    \
-            Serial.print##__VA_OPT__(f)(format __VA_OPT__(, ) __VA_ARGS__); \
-    } while (0)
-#define LOG1(format, ...)                                                   \
-    do {                                                                    \
-        if (homeSpan.getLogLevel() >= 1)                                    \
-            Serial.print##__VA_OPT__(f)(format __VA_OPT__(, ) __VA_ARGS__); \
-    } while (0)
-#define LOG2(format, ...)                                                   \
-    do {                                                                    \
-        if (homeSpan.getLogLevel() >= 2)                                    \
+        if (homeSpan.getLogLevel() >= 0) {                                  \
+            SpanLog::flush();                                               \
             Serial.print##__VA_OPT__(f)(format __VA_OPT__(, ) __VA_ARGS__); \
+        }                                                                   \
     } while (0)
 
+#if HS_MAX_LOG_LEVEL >= 1
+#    define LOG1(format, ...)                                                     \
+        do {                                                                      \
+            if (homeSpan.getLogLevel() >= 1)                                      \
+                SpanLog::print##__VA_OPT__(f)(format __VA_OPT__(, ) __VA_ARGS__); \
+        } while (0)
+#else
+#    define LOG1(format, ...)                                                     \
+        do {                                                                      \
+            if (0)                                                                \
+                SpanLog::print##__VA_OPT__(f)(format __VA_OPT__(, ) __VA_ARGS__); \
+        } while (0)
+#endif
+
+#if HS_MAX_LOG_LEVEL >= 2
+#    define LOG2(format, ...)                                                     \
+        do {                                                                      \
+            if (homeSpan.getLogLevel() >= 2)                                      \
+                SpanLog::print##__VA_OPT__(f)(format __VA_OPT__(, ) __VA_ARGS__); \
+        } while (0)
+#else
+#    define LOG2(format, ...)                                                     \
+        do {                                                                      \
+            if (0)                                                                \
+                SpanLog::print##__VA_OPT__(f)(format __VA_OPT__(, ) __VA_ARGS__); \
+        } while (0)
+#endif
+
 #define WEBLOG(format, ...) homeSpan.addWebLog(false, format __VA_OPT__(, ) __VA_ARGS__);
 
 //////////////////////////////////////////////////////
@@ -26,6 +26,7 @@
  ********************************************************************************/
 
 #include "TLV8.h"
+#include "Log.h"
 
 //////////////////////////////////////
 
@@ -260,19 +261,18 @@ void TLV8::print(TLV8_itc it1, TLV8_itc it2) const
     while (it1 != it2) {
         const char *name = getName(it1->getTag());
         if (name)
-            Serial.printf("%s", name);
+            SpanLog::printf("%s", name);
         else
-            Serial.printf("%d", it1->getTag());
-        Serial.printf("(%d) ", it1->getLen());
-        for (int i = 0; i < it1->getLen(); i++)
-            Serial.printf("%02X", (*it1)[i]);
+            SpanLog::printf("%d", it1->getTag());
+        SpanLog::printf("(%d) ", it1->getLen());
+        SpanLog::hexWrite(it1->get(), it1->getLen());
         if (it1->getLen() == 0)
-            Serial.printf(" [null]");
+            SpanLog::printf(" [null]");
         else if (it1->getLen() <= 4)
-            Serial.printf(" [%u]", it1->getVal());
+            SpanLog::printf(" [%u]", it1->getVal());
         else if (it1->getLen() <= 8)
-            Serial.printf(" [%llu]", it1->getVal<uint64_t>());
-        Serial.printf("\n");
+            SpanLog::printf(" [%llu]", it1->getVal<uint64_t>());
+        SpanLog::printf("\n");
         it1++;
     }
 }
@@ -282,13 +282,13 @@ void TLV8::print(TLV8_itc it1, TLV8_itc it2) const
 void TLV8::printAll_r(String label) const
 {
     for (auto it = begin(); it != end(); it++) {
-        Serial.printf("%s", label.c_str());
+        SpanLog::printf("%s", label.c_str());
         print(it);
         TLV8 tlv;
         if (tlv.unpack(*it, (*it).getLen()) == 0)
             tlv.printAll_r(label + String((*it).getTag()) + "-");
     }
-    Serial.printf("%sDONE\n", label.c_str());
+    SpanLog::printf("%sDONE\n", label.c_str());
 }
 
 //////////////////////////////////////
@@ -300,3 +300,276 @@ void TLV8::osprint(std::ostream &os, TLV8_itc it1, TLV8_itc it2) const
 }
 
 //////////////////////////////////////
+
+int TLV8View::unpack(uint8_t *buf, size_t bufSize)
+{
+    uint8_t *p = buf;
+    uint8_t *pend = buf + bufSize;
+
+    nRecords = 0;
+
+    while (p < pend) {
+        if (pend - p < 2 || pend - p < 2 + p[1])  // header or value of record is truncated
+            return (-1);
+
+        if (nRecords > 0 && records[nRecords - 1].tag == p[0]) {  // next fragment of the prior record
+            records[nRecords - 1].len += p[1];
+            records[nRecords - 1].fragmented = true;
+        } else {
+            if (nRecords == MAX_RECORDS)  // too many records to index
+                return (-1);
+            records[nRecords].tag = p[0];
+            records[nRecords].val = p + 2;
+            records[nRecords].len = p[1];
+            records[nRecords].fragmented = false;
+            nRecords++;
+        }
+
+        p += 2 + p[1];
+        records[nRecords - 1].end = p;
+    }
+
+    return (0);
+}
+
+//////////////////////////////////////
+
+void TLV8View::merge(tlv8_view_t *r)
+{
+    if (!r->fragmented)
+        return;
+
+    uint8_t *dst = r->val;      // merged value starts where value of first fragment starts
+    uint8_t *src = r->val - 2;  // header of first fragment
+
+    while (src < r->end) {  // shift the value of each fragment down over the preceding fragment headers
+        uint8_t nBytes = src[1];
+        memmove(dst, src + 2, nBytes);
+        dst += nBytes;
+        src += 2 + nBytes;
+    }
+
+    r->fragmented = false;
+}
+
+//////////////////////////////////////
+
+TLV8View_itc TLV8View::find(uint8_t tag)
+{
+    for (int i = 0; i < nRecords; i++) {
+        if (records[i].tag == tag) {
+            merge(records + i);
+            return (records + i);
+        }
+    }
+
+    return (NULL);
+}
+
+//////////////////////////////////////
+
+const char *TLV8View::getName(uint8_t tag) const
+{
+    if (names == NULL)
+        return (NULL);
+
+    for (int i = 0; i < nNames; i++) {
+        if (names[i].tag == tag)
+            return (names[i].name);
+    }
+
+    return (NULL);
+}
+
+//////////////////////////////////////
+
+void TLV8View::print()
+{
+    for (int n = 0; n < nRecords; n++) {
+        tlv8_view_t *r = records + n;
+        merge(r);
+        const char *name = getName(r->tag);
+        if (name)
+            SpanLog::printf("%s", name);
+        else
+            SpanLog::printf("%d", r->tag);
+        SpanLog::printf("(%d) ", r->len);
+        SpanLog::hexWrite(r->val, r->len);
+        if (r->len == 0)
+            SpanLog::printf(" [null]");
+        else if (r->len <= 4)
+            SpanLog::printf(" [%u]", r->getVal());
+        else if (r->len <= 8)
+            SpanLog::printf(" [%llu]", r->getVal<uint64_t>());
+        SpanLog::printf("\n");
+    }
+}
+
+//////////////////////////////////////
+
+void TLV8Writer::reserve(size_t addBytes)
+{
+    if (used + addBytes <= arenaSize)
+        return;
+
+    size_t newSize = arenaSize ? arenaSize : 64;
+    while (newSize < used + addBytes)
+        newSize *= 2;
+
+    arena = (uint8_t *)HS_REALLOC(arena, newSize);
+    if (arena == NULL) {
+        Serial.printf("\n\n*** FATAL ERROR: Requested allocation of %d bytes failed.  Program Halting.\n\n", newSize);
+        while (1)
+            ;
+    }
+    arenaSize = newSize;
+}
+
+//////////////////////////////////////
+
+TLV8Writer::header_t TLV8Writer::getHeader(size_t offset) const
+{
+    header_t hdr;
+    memcpy(&hdr, arena + offset, sizeof(header_t));  // headers are not necessarily aligned within arena
+    return (hdr);
+}
+
+//////////////////////////////////////
+
+TLV8Writer::ref_t TLV8Writer::add(uint8_t tag, size_t len, const uint8_t *val)
+{
+    reserve(sizeof(header_t) + len);
+
+    if (nRecords > 0 && getHeader(lastRecord).tag == tag) {  // extend last record (same as TLV8::add)
+        header_t hdr = getHeader(lastRecord);
+        packSize -= fragmentedSize(hdr.len);
+        hdr.len += len;
+        packSize += fragmentedSize(hdr.len);
+        memcpy(arena + lastRecord, &hdr, sizeof(header_t));
+    } else {
+        header_t hdr = {tag, len};
+        lastRecord = used;
+        memcpy(arena + used, &hdr, sizeof(header_t));
+        used += sizeof(header_t);
+        packSize += fragmentedSize(len);
+        nRecords++;
+    }
+
+    if (val != NULL)
+        memcpy(arena + used, val, len);
+    used += len;
+
+    return (ref_t(this, lastRecord));
+}
+
+//////////////////////////////////////
+
+TLV8Writer::ref_t TLV8Writer::add(uint8_t tag, uint64_t val)
+{
+    uint8_t *p = reinterpret_cast<uint8_t *>(&val);
+    size_t nBytes = sizeof(uint64_t);
+    while (nBytes > 1 && p[nBytes - 1] == 0)  // same little-endian sizing rules as TLV8::add (1, 2, 4, or 8 bytes)
+        nBytes--;
+    if (nBytes == 3)
+        nBytes = 4;
+    else if (nBytes > 4)
+        nBytes = 8;
+    return (add(tag, nBytes, p));
+}
+
+//////////////////////////////////////
+
+size_t TLV8Writer::pack(uint8_t *buf) const
+{
+    uint8_t *p = buf;
+
+    for (size_t offset = 0; offset < used;) {
+        header_t hdr = getHeader(offset);
+        const uint8_t *val = arena + offset + sizeof(header_t);
+        size_t remaining = hdr.len;
+
+        do {
+            uint8_t nBytes = remaining > 255 ? 255 : remaining;  // max is 255 bytes per TLV record
+            *p++ = hdr.tag;
+            *p++ = nBytes;
+            memcpy(p, val, nBytes);
+            p += nBytes;
+            val += nBytes;
+            remaining -= nBytes;
+        } while (remaining > 0);
+
+        offset += sizeof(header_t) + hdr.len;
+    }
+
+    return (p - buf);
+}
+
+//////////////////////////////////////
+
+void TLV8Writer::osprint(std::ostream &os) const
+{
+    for (size_t offset = 0; offset < used;) {
+        header_t hdr = getHeader(offset);
+        const uint8_t *val = arena + offset + sizeof(header_t);
+        size_t remaining = hdr.len;
+
+        do {
+            uint8_t fragHeader[2] = {hdr.tag, (uint8_t)(remaining > 255 ? 255 : remaining)};
+            os.write((char *)fragHeader, 2);
+            os.write((char *)val, fragHeader[1]);
+            val += fragHeader[1];
+            remaining -= fragHeader[1];
+        } while (remaining > 0);
+
+        offset += sizeof(header_t) + hdr.len;
+    }
+}
+
+//////////////////////////////////////
+
+const char *TLV8Writer::getName(uint8_t tag) const
+{
+    if (names == NULL)
+        return (NULL);
+
+    for (int i = 0; i < nNames; i++) {
+        if (names[i].tag == tag)
+            return (names[i].name);
+    }
+
+    return (NULL);
+}
+
+//////////////////////////////////////
+
+void TLV8Writer::print() const
+{
+    for (size_t offset = 0; offset < used;) {
+        header_t hdr = getHeader(offset);
+        const uint8_t *val = arena + offset + sizeof(header_t);
+        const char *name = getName(hdr.tag);
+        if (name)
+            SpanLog::printf("%s", name);
+        else
+            SpanLog::printf("%d", hdr.tag);
+        SpanLog::printf("(%d) ", hdr.len);
+        SpanLog::hexWrite(val, hdr.len);
+        if (hdr.len == 0)
+            SpanLog::printf(" [null]");
+        else if (hdr.len <= 4) {
+            uint32_t iVal = 0;
+            for (int i = 0; i < hdr.len; i++)
+                iVal |= static_cast<uint32_t>(val[i]) << (i * 8);
+            SpanLog::printf(" [%u]", iVal);
+        } else if (hdr.len <= 8) {
+            uint64_t iVal = 0;
+            for (int i = 0; i < hdr.len; i++)
+                iVal |= static_cast<uint64_t>(val[i]) << (i * 8);
+            SpanLog::printf(" [%llu]", iVal);
+        }
+        SpanLog::printf("\n");
+        offset += sizeof(header_t) + hdr.len;
+    }
+}
+
+//////////////////////////////////////
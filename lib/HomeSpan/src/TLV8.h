@@ -149,3 +149,145 @@ class TLV8 : public std::list<tlv8_t, Mallocator<tlv8_t>>
 
     void wipe() { std::list<tlv8_t, Mallocator<tlv8_t>>().swap(*this); }
 };
+
+/////////////////////////////////////
+// TLV8View parses a received TLV8 buffer in place, without copying or allocating.  Consecutive records with the same
+// tag (i.e. fragments of a value longer than 255 bytes) are indexed as a single record, and only merged into one
+// contiguous value (by shifting the fragments over their headers within the same buffer) when that record is found.
+
+class tlv8_view_t
+{
+    friend class TLV8View;
+
+  private:
+    uint8_t tag;
+    uint8_t *val;        // pointer to start of value (first byte after first fragment header)
+    size_t len;          // total length of value across all fragments
+    uint8_t *end;        // pointer to first byte beyond last fragment
+    boolean fragmented;  // true if value spans multiple fragments that have not yet been merged
+
+  public:
+    operator uint8_t *() const { return (val); }
+
+    uint8_t &operator[](int index) const { return (val[index]); }
+
+    uint8_t *get() const { return (val); }
+
+    size_t getLen() const { return (len); }
+
+    uint8_t getTag() const { return (tag); }
+
+    template <class T = uint32_t>
+    T getVal() const
+    {
+        T iVal = 0;
+        for (int i = 0; i < len; i++)
+            iVal |= static_cast<T>(val[i]) << (i * 8);
+        return (iVal);
+    }
+};
+
+/////////////////////////////////////
+
+typedef const tlv8_view_t *TLV8View_itc;
+
+class TLV8View
+{
+    static const int MAX_RECORDS = 16;  // maximum number of (merged) records indexed in a single view
+
+    tlv8_view_t records[MAX_RECORDS];
+    int nRecords = 0;
+
+    const TLV8_names *names = NULL;
+    int nNames = 0;
+
+    void merge(tlv8_view_t *r);
+
+  public:
+    TLV8View() {};
+    TLV8View(const TLV8_names *names, int nNames) : names{names}, nNames{nNames} {};
+
+    int unpack(uint8_t *buf, size_t bufSize);  // returns 0 if successful, or -1 if buf is malformed or too large
+
+    TLV8View_itc find(uint8_t tag);  // returns NULL if not found
+    TLV8View_itc end() const { return (NULL); }
+
+    int len(TLV8View_itc it) const { return (it == NULL ? -1 : it->getLen()); }
+    int size() const { return (nRecords); }
+
+    const char *getName(uint8_t tag) const;
+
+    void print();
+};
+
+/////////////////////////////////////
+// TLV8Writer builds outgoing TLV8 records in a single, contiguous arena.  Each record is stored unfragmented as a
+// header followed by its value.  The packed size (including the extra headers needed to split values longer than 255
+// bytes into fragments) is tracked as records are added, so it is known before anything is packed, and packing copies
+// each fragment with a single memcpy (or a single write to an ostream).
+
+class TLV8Writer
+{
+    struct header_t
+    {
+        uint8_t tag;
+        size_t len;
+    };
+
+    uint8_t *arena = NULL;  // contiguous storage of all records
+    size_t arenaSize = 0;   // allocated size of arena
+    size_t used = 0;        // number of bytes of arena used
+    size_t lastRecord = 0;  // offset of header of last record added
+    size_t packSize = 0;    // total number of bytes needed to pack all records
+    int nRecords = 0;
+
+    const TLV8_names *names = NULL;
+    int nNames = 0;
+
+    void reserve(size_t addBytes);
+    header_t getHeader(size_t offset) const;
+    static size_t fragmentedSize(size_t len) { return (len + 2 * (len == 0 ? 1 : (len + 254) / 255)); }
+
+  public:
+    class ref_t
+    {  // reference to the value of a record that remains valid even if the arena is subsequently re-allocated
+        friend class TLV8Writer;
+
+        const TLV8Writer *tlv;
+        size_t offset;  // offset of record header within arena
+
+        ref_t(const TLV8Writer *tlv, size_t offset) : tlv{tlv}, offset{offset} {}
+
+      public:
+        uint8_t *operator*() const { return (tlv->arena + offset + sizeof(header_t)); }
+        size_t getLen() const { return (tlv->getHeader(offset).len); }
+    };
+
+    TLV8Writer(size_t initialSize = 256) { reserve(initialSize); }
+    TLV8Writer(const TLV8_names *names, int nNames, size_t initialSize = 256) : names{names}, nNames{nNames}
+    {
+        reserve(initialSize);
+    }
+    ~TLV8Writer() { free(arena); }
+
+    TLV8Writer(const TLV8Writer &) = delete;
+    TLV8Writer &operator=(const TLV8Writer &) = delete;
+
+    ref_t add(uint8_t tag, size_t len, const uint8_t *val);
+    ref_t add(uint8_t tag, uint64_t val);
+    ref_t add(uint8_t tag) { return (add(tag, 0, NULL)); }
+
+    size_t pack_size() const { return (packSize); }
+    size_t pack(uint8_t *buf) const;
+    void osprint(std::ostream &os) const;
+
+    void clear()
+    {
+        used = 0;
+        packSize = 0;
+        nRecords = 0;
+    }
+
+    const char *getName(uint8_t tag) const;
+    void print() const;
+};
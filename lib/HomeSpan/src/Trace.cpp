@@ -0,0 +1,76 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#include "Trace.h"
+
+#ifdef HS_TRACE
+
+SpanTrace::event_t SpanTrace::events[HS_TRACE_SIZE];
+uint32_t SpanTrace::nEvents = 0;
+
+//////////////////////////////////////
+
+void SpanTrace::record(const char *name, uint64_t start, uint32_t cycles)
+{
+    event_t *e = events + (nEvents % HS_TRACE_SIZE);
+    e->name = name;
+    e->start = start;
+    e->cycles = cycles;
+    nEvents++;
+}
+
+//////////////////////////////////////
+
+void SpanTrace::print(std::ostream &out)
+{
+    uint32_t mhz = getCpuFrequencyMhz();
+    uint32_t first = nEvents > HS_TRACE_SIZE ? nEvents - HS_TRACE_SIZE : 0;
+    char buf[32];
+
+    out << "{\"traceEvents\":[";
+
+    for (uint32_t i = first; i < nEvents; i++) {
+        event_t *e = events + (i % HS_TRACE_SIZE);
+        uint32_t dur = e->cycles * 10ULL / mhz;  // duration in tenths of a microsecond
+        sprintf(buf, "%u.%u", dur / 10, dur % 10);
+        if (i > first)
+            out << ",";
+        out << "{\"name\":\"" << e->name << "\",\"ph\":\"X\",\"ts\":" << e->start << ",\"dur\":" << buf
+            << ",\"pid\":1,\"tid\":1}";
+    }
+
+    out << "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"events\":" << nEvents << ",\"dropped\":" << first << "}}";
+}
+
+//////////////////////////////////////
+
+void SpanTrace::clear()
+{
+    nEvents = 0;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*********************************************************************************
+ *  MIT License
+ *
+ *  Copyright (c) 2020-2024 Gregg E. Berman
+ *
+ *  https://github.com/HomeSpan/HomeSpan
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ *
+ ********************************************************************************/
+
+#pragma once
+
+#include <Arduino.h>
+#include <ostream>
+
+// Optional hot-path stage tracing for diagnosing slow HAP responses.  Build with -DHS_TRACE to record the duration
+// of each instrumented stage (decrypt, parse, find, update, nvs, render, encrypt, write...) into a fixed-size ring.
+// The ring can be exported as Chrome trace JSON (load in chrome://tracing or ui.perfetto.dev) from <status-url>/trace
+// or with the 'T' serial command.  When HS_TRACE is not defined, all HS_TRACE macros compile to nothing.
+//
+//   HS_TRACE_SCOPE(name)      - records the time from this point until the end of the enclosing scope
+//   HS_TRACE_BEGIN(id, name)  - records the time from this point until HS_TRACE_END(id) or end of enclosing scope
+//   HS_TRACE_END(id)
+
+#ifdef HS_TRACE
+
+#    ifndef HS_TRACE_SIZE
+#        define HS_TRACE_SIZE 256  // number of events kept in ring (oldest events are overwritten)
+#    endif
+
+struct SpanTrace
+{
+    struct event_t
+    {
+        uint64_t start;    // start time (microseconds since boot - 64 bits, so ts never wraps in the exported trace)
+        const char *name;  // stage name (must be a string literal)
+        uint32_t cycles;   // duration in CPU cycles
+    };
+
+    // events are recorded and exported only from the HomeSpan polling task, so the ring needs no locking
+
+    static event_t events[HS_TRACE_SIZE];  // ring of recorded events
+    static uint32_t nEvents;               // total number of events recorded since boot (or last clear)
+
+    static void record(const char *name, uint64_t start, uint32_t cycles);  // adds event to ring
+    static void print(std::ostream &out);  // writes all events in ring to out (e.g. hapOut) as Chrome trace JSON
+    static void clear();  // discards all events in ring
+};
+
+class SpanTraceMark
+{
+    const char *name;
+    uint64_t start;
+    uint32_t startCycles;
+
+  public:
+    SpanTraceMark(const char *name) : name(name), start(esp_timer_get_time()), startCycles(ESP.getCycleCount())
+    {
+    }
+
+    void end()
+    {
+        if (name)
+            SpanTrace::record(name, start, ESP.getCycleCount() - startCycles);
+        name = NULL;
+    }
+
+    ~SpanTraceMark() { end(); }
+};
+
+#    define HS_TRACE_ID2(line) hsTrace_##line
+#    define HS_TRACE_ID(line) HS_TRACE_ID2(line)
+#    define HS_TRACE_SCOPE(name) SpanTraceMark HS_TRACE_ID(__LINE__)(name)
+#    define HS_TRACE_BEGIN(id, name) SpanTraceMark hsTrace_##id(name)
+#    define HS_TRACE_END(id) hsTrace_##id.end()
+
+#else
+
+#    define HS_TRACE_SCOPE(name)
+#    define HS_TRACE_BEGIN(id, name)
+#    define HS_TRACE_END(id)
+
+#endif
@@ -35,6 +35,10 @@
 //  Utils::readSerial       - reads all characters from Serial port and saves only up to max specified
 //  Utils::mask             - masks a string with asterisks (good for displaying passwords)
 //
+//  class BumpArena         - hands out per-request buffers from one main block that is reset after each request
+//
+//  class PinToggle         - drives an output pin, and flips it on debounced edges of an optional toggle pin
+//
 //  class PushButton        - tracks Single, Double, and Long Presses of a pushbutton that connects a specified pin to
 //  ground
 //
@@ -103,6 +107,159 @@ String Utils::mask(char *c, int n)
     return (s);
 }  // mask
 
+////////////////////////////////
+//         BumpArena          //
+////////////////////////////////
+
+BumpArena::~BumpArena()
+{
+    while (overflow) {
+        block_t *next = overflow->next;
+        hs_free(overflow, tag);
+        overflow = next;
+    }
+    hs_free(buf, tag);
+}
+
+//////////////////////////////////////
+
+void *BumpArena::alloc(size_t nBytes)
+{
+    nBytes = (nBytes + 3) & ~3;  // keep all allocations 4-byte aligned
+    demand += nBytes;
+
+    if (buf == NULL && capacity > 0)  // main block is allocated on first use
+        buf = (uint8_t *)allocBlock(capacity);
+
+    if (used + nBytes <= capacity) {
+        void *p = buf + used;
+        used += nBytes;
+        return (p);
+    }
+
+    overflows++;
+    block_t *b = (block_t *)allocBlock(sizeof(block_t) + nBytes);
+    b->next = overflow;
+    overflow = b;
+    return (b + 1);
+}
+
+//////////////////////////////////////
+
+void *BumpArena::allocBlock(size_t nBytes)
+{
+    void *p = hs_malloc(nBytes, tag);
+    if (p == NULL) {
+        Serial.printf("\n\n*** FATAL ERROR: Requested allocation of %d bytes failed.  Program Halting.\n\n", nBytes);
+        while (1) {}
+    }
+    return (p);
+}
+
+//////////////////////////////////////
+
+void BumpArena::reset()
+{
+    while (overflow) {
+        block_t *next = overflow->next;
+        hs_free(overflow, tag);
+        overflow = next;
+    }
+
+    if (demand > highWater)
+        highWater = demand;
+    if (demand > recentPeak)
+        recentPeak = demand;
+
+    if (demand > capacity) {  // grow main block once so that the same request fits next time
+        resize((demand + 511) & ~511);
+    } else if (++resets == SHRINK_RESETS) {  // shrink main block if a rare large request left it larger than needed
+        size_t fit = (recentPeak + 511) & ~511;
+        if (fit < minCapacity)
+            fit = minCapacity;
+        if (fit < capacity)
+            resize(fit);
+        recentPeak = 0;
+        resets = 0;
+    }
+
+    used = 0;
+    demand = 0;
+}
+
+//////////////////////////////////////
+
+void BumpArena::resize(size_t nBytes)
+{
+    hs_free(buf, tag);
+    buf = NULL;
+    capacity = nBytes;
+    recentPeak = 0;
+    resets = 0;
+}
+
+////////////////////////////////
+//         PinToggle          //
+////////////////////////////////
+
+void PinToggle::begin(uint8_t outPin, int togglePin, uint16_t toggleTime, boolean initial, portMUX_TYPE *mux,
+                      void (*isr)(void *), void *arg)
+{
+    this->outPin = outPin;
+    this->togglePin = togglePin;
+    this->toggleTime = toggleTime;
+    this->mux = mux;
+    state = initial;
+    lastEdge = 0;
+    toggles = 0;
+
+    pinMode(outPin, OUTPUT);
+    digitalWrite(outPin, state);
+
+    if (togglePin >= 0) {
+        pinMode(togglePin, INPUT_PULLUP);
+        lastLevel = digitalRead(togglePin);
+        attachInterruptArg(togglePin, isr, arg, CHANGE);
+    }
+}
+
+//////////////////////////////////////
+
+void PinToggle::end()
+{
+    if (togglePin >= 0)
+        detachInterrupt(togglePin);
+}
+
+//////////////////////////////////////
+
+boolean IRAM_ATTR PinToggle::edge()
+{
+    int level = digitalRead(togglePin);
+    int64_t now = esp_timer_get_time();
+
+    if (level == lastLevel || now - lastEdge < toggleTime * 1000LL)  // no change, or bounce
+        return (false);
+
+    lastLevel = level;
+    lastEdge = now;
+    toggles++;
+
+    portENTER_CRITICAL_ISR(mux);  // a task may be driving the pin from the other core
+    state = !state;
+    digitalWrite(outPin, state);  // drive output right away
+    portEXIT_CRITICAL_ISR(mux);
+    return (true);
+}
+
+//////////////////////////////////////
+
+void PinToggle::drive(boolean newState)
+{
+    state = newState;
+    digitalWrite(outPin, state);
+}
+
 ////////////////////////////////
 //         PushButton         //
 ////////////////////////////////
@@ -142,14 +299,52 @@ PushButton::PushButton(int pin, triggerType_t triggerType)
         pressType = OPEN;
         toggleStatus = 0;
     }
+
+    if (triggerType == TRIGGER_ON_LOW || triggerType == TRIGGER_ON_HIGH) {  // use interrupts to queue edges
+        lastPressed = triggerType(pin);
+        useEdges = true;
+        attachInterruptArg(pin, edgeISR, this, CHANGE);
+    }
+}
+
+//////////////////////////////////////
+
+PushButton::~PushButton()
+{
+    if (useEdges)
+        detachInterrupt(pin);
 }
 
 //////////////////////////////////////
 
 boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t doubleTime)
 {
-    unsigned long cTime = millis();
+    if (!useEdges)
+        return (triggerStep(millis(), triggerType(pin), singleTime, longTime, doubleTime));
+
+    edge_t e;
+    while (nextEdge(e)) {  // run state machine over queued edges, using the time of each edge
+        if (triggerStep(e.time, lastPressed, singleTime, longTime, doubleTime))
+            return (true);  // a timeout expired before this edge - leave edge in ring for next call
+
+        boolean trig = triggerStep(e.time, e.pressed, singleTime, longTime, doubleTime);
+        lastPressed = e.pressed;
+        edgeTail = (edgeTail + 1) % EDGE_RING_SIZE;
+        if (trig)
+            return (true);
+    }
+
+    return (triggerStep(millis(), lastPressed, singleTime, longTime, doubleTime));  // check for timeouts
+}
 
+//////////////////////////////////////
+
+boolean PushButton::triggerStep(uint32_t cTime,
+                                boolean pressed,
+                                uint16_t singleTime,
+                                uint16_t longTime,
+                                uint16_t doubleTime)
+{
     switch (status) {
         case 0:
             if (doubleCheck && cTime > doubleAlarm) {
@@ -158,7 +353,7 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
                 return (true);
             }
 
-            if (triggerType(pin)) {  // button is "pressed"
+            if (pressed) {  // button is "pressed"
                 singleAlarm = cTime + singleTime;
                 if (!doubleCheck) {
                     status = 1;
@@ -172,7 +367,7 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
 
         case 1:
         case 2:
-            if (!triggerType(pin)) {  // button is released
+            if (!pressed) {  // button is released
                 status = 0;
                 if (cTime > singleAlarm) {
                     doubleCheck = true;
@@ -186,7 +381,7 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
             break;
 
         case 3:
-            if (!triggerType(pin)) {  // button has been released after a long press
+            if (!pressed) {  // button has been released after a long press
                 status = 0;
             } else if (cTime > longAlarm) {
                 longAlarm = cTime + longTime;
@@ -196,7 +391,7 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
             break;
 
         case 4:
-            if (!triggerType(pin)) {  // button is released
+            if (!pressed) {  // button is released
                 status = 0;
             } else if (cTime > singleAlarm) {  // button is still pressed
                 status = 5;
@@ -207,7 +402,7 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
             break;
 
         case 5:
-            if (!triggerType(pin))  // button has been released after double-click
+            if (!pressed)  // button has been released after double-click
                 status = 0;
             break;
     }
@@ -219,18 +414,38 @@ boolean PushButton::triggered(uint16_t singleTime, uint16_t longTime, uint16_t d
 
 boolean PushButton::toggled(uint16_t toggleTime)
 {
-    unsigned long cTime = millis();
+    if (!useEdges)
+        return (toggleStep(millis(), triggerType(pin), toggleTime));
+
+    edge_t e;
+    while (nextEdge(e)) {  // run state machine over queued edges, using the time of each edge
+        if (toggleStep(e.time, lastPressed, toggleTime))
+            return (true);  // switch was held CLOSED long enough before this edge - leave edge in ring for next call
+
+        boolean trig = toggleStep(e.time, e.pressed, toggleTime);
+        lastPressed = e.pressed;
+        edgeTail = (edgeTail + 1) % EDGE_RING_SIZE;
+        if (trig)
+            return (true);
+    }
+
+    return (toggleStep(millis(), lastPressed, toggleTime));  // check for switch held CLOSED long enough
+}
 
+//////////////////////////////////////
+
+boolean PushButton::toggleStep(uint32_t cTime, boolean pressed, uint16_t toggleTime)
+{
     switch (toggleStatus) {
         case 0:
-            if (triggerType(pin)) {  // switch is toggled CLOSED
+            if (pressed) {  // switch is toggled CLOSED
                 singleAlarm = cTime + toggleTime;
                 toggleStatus = 1;
             }
             break;
 
         case 1:
-            if (!triggerType(pin)) {  // switch is toggled back OPEN too soon
+            if (!pressed) {  // switch is toggled back OPEN too soon
                 toggleStatus = 0;
             } else if (cTime > singleAlarm) {  // switch has been in CLOSED state for sufficient time
                 toggleStatus = 2;
@@ -240,7 +455,7 @@ boolean PushButton::toggled(uint16_t toggleTime)
             break;
 
         case 2:
-            if (!triggerType(pin)) {  // switch is toggled OPEN after being in CLOSED state
+            if (!pressed) {  // switch is toggled OPEN after being in CLOSED state
                 toggleStatus = 0;
                 pressType = OPEN;
                 return (true);
@@ -254,6 +469,46 @@ boolean PushButton::toggled(uint16_t toggleTime)
 
 //////////////////////////////////////
 
+void IRAM_ATTR PushButton::edgeISR(void *arg)
+{
+    PushButton *pb = (PushButton *)arg;
+
+    uint8_t next = (pb->edgeHead + 1) % EDGE_RING_SIZE;
+    if (next == pb->edgeTail) {  // ring is full
+        pb->edgeOverflow = true;
+        return;
+    }
+
+    int level = digitalRead(pb->pin);  // edges are only queued for TRIGGER_ON_LOW and TRIGGER_ON_HIGH, so pin is
+                                       // read here rather than through triggerType(), which may be in flash
+
+    pb->edges[pb->edgeHead].time = esp_timer_get_time() / 1000;  // same clock as millis(), but safe to read from IRAM
+    pb->edges[pb->edgeHead].pressed = (pb->triggerType == TRIGGER_ON_LOW) ? !level : level;
+    __sync_synchronize();  // make sure edge is written before it is published
+    pb->edgeHead = next;
+}
+
+//////////////////////////////////////
+
+boolean PushButton::nextEdge(edge_t &e)
+{
+    if (edgeOverflow) {  // edges were lost - discard queue and re-sync with current state of pin
+        edgeTail = edgeHead;
+        edgeOverflow = false;
+        lastPressed = triggerType(pin);
+        return (false);
+    }
+
+    if (edgeTail == edgeHead)
+        return (false);
+
+    __sync_synchronize();
+    e = edges[edgeTail];
+    return (true);
+}
+
+//////////////////////////////////////
+
 boolean PushButton::primed()
 {
     if (millis() > singleAlarm && status == 1) {
@@ -284,6 +539,11 @@ void PushButton::wait()
 void PushButton::reset()
 {
     status = 0;
+
+    if (useEdges) {  // discard any queued edges and re-sync with current state of pin
+        edgeTail = edgeHead;
+        lastPressed = triggerType(pin);
+    }
 }
 
 //////////////////////////////////////
@@ -28,6 +28,8 @@
 #pragma once
 
 #include <Arduino.h>
+#include <algorithm>
+#include <sodium.h>
 
 #include "PSRAM.h"
 
@@ -41,6 +43,496 @@ String mask(char *c, int n);
 
 // strips backslashes out of c (Apple unecessesarily "escapes" forward slashes in JSON)
 char *stripBackslash(char *c);
+
+// FreeRTOS queue that can be purged of selected items.  Every send and receive, whether from a task or an ISR, on
+// either core, takes the same spinlock 'mux' as purge(), so no item can be queued or taken while purge() cycles the
+// queue.  No task ever waits on the queue (all calls use a zero timeout), so the FromISR calls made inside the
+// critical section never need to wake or yield to another task.
+class PurgeableQueue
+{
+    QueueHandle_t queue = NULL;
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+  public:
+    template <class T>
+    boolean begin(UBaseType_t depth)  // creates queue of items of type T; returns false if it could not be allocated
+    {
+        queue = xQueueCreate(depth, sizeof(T));
+        return (queue != NULL);
+    }
+
+    explicit operator bool() const { return (queue != NULL); }
+
+    template <class T>
+    boolean send(const T &item)  // from a task; returns false if queue is full
+    {
+        portENTER_CRITICAL(&mux);
+        BaseType_t sent = xQueueSendFromISR(queue, &item, NULL);
+        portEXIT_CRITICAL(&mux);
+        return (sent == pdTRUE);
+    }
+
+    template <class T>
+    boolean IRAM_ATTR sendFromISR(const T &item)  // from an ISR; returns false if queue is full
+    {
+        portENTER_CRITICAL_ISR(&mux);
+        BaseType_t sent = xQueueSendFromISR(queue, &item, NULL);
+        portEXIT_CRITICAL_ISR(&mux);
+        return (sent == pdTRUE);
+    }
+
+    template <class T>
+    boolean receive(T &item)  // from a task; returns false if queue is empty
+    {
+        portENTER_CRITICAL(&mux);
+        BaseType_t received = xQueueReceiveFromISR(queue, &item, NULL);
+        portEXIT_CRITICAL(&mux);
+        return (received == pdTRUE);
+    }
+
+    // removes every item of type T for which drop(item) is true, without processing any item and keeping the others
+    // in their original order.  Since each item kept is sent back right after it was received, with all producers
+    // held off, there is always room for it - returns the number of kept items that could nonetheless not be sent
+    // back (and so were lost), which is always zero unless the queue was corrupted.
+    template <class T, class Pred>
+    int purge(Pred drop)
+    {
+        T item;
+        int lost = 0;
+
+        portENTER_CRITICAL(&mux);
+        UBaseType_t n = uxQueueMessagesWaitingFromISR(queue);
+        while (n-- > 0 && xQueueReceiveFromISR(queue, &item, NULL) == pdTRUE) {
+            if (!drop(item) && xQueueSendFromISR(queue, &item, NULL) != pdTRUE)
+                lost++;
+        }
+        portEXIT_CRITICAL(&mux);
+        return (lost);
+    }
+};
+
+// sequence lock that lets readers in any task (or on the other core) take a consistent copy of data published by a
+// single writer, without ever blocking the writer.  Writers are serialized by 'mux'; a reader copies the data and
+// retries if a write began or completed while it was copying.  Only the copy is protected - any memory the data
+// points to must stay valid until the reader is done with it.
+class SeqLock
+{
+    volatile uint32_t seq = 0;  // odd while a write is in progress
+
+  public:
+    void writeBegin(portMUX_TYPE *mux)
+    {
+        portENTER_CRITICAL(mux);
+        seq++;
+        __sync_synchronize();
+    }
+
+    void writeEnd(portMUX_TYPE *mux)
+    {
+        __sync_synchronize();
+        seq++;
+        portEXIT_CRITICAL(mux);
+    }
+
+    template <class T>
+    T read(const T &data)  // returns a copy of 'data' that no write overlapped
+    {
+        T snap;
+        uint32_t s;
+
+        do {
+            while ((s = seq) & 1)  // wait for write in progress (on other core) to complete
+                ;
+            __sync_synchronize();
+            snap = data;
+            __sync_synchronize();
+        } while (s != seq);
+
+        return (snap);
+    }
+};
+
+// schedules periodic calls for a min-heap of pointers to objects of class T, ordered by their next deadline
+// T::nextLoop (in millis) and repeating every T::loopPeriod millis.  T must declare 'friend struct LoopHeap<T>'.
+template <class T>
+struct LoopHeap
+{
+    // heap comparator - returns true if a is due after b (safe across millis() wrap-around)
+    static bool after(T *a, T *b) { return ((long)(a->nextLoop - b->nextLoop) > 0); }
+
+    // pops each item in 'heap' that is due at time 'now' (earliest first), calls run(item), and pushes it back one
+    // period later - or one period after 'now' if it fell more than one period behind, so it is not run in a burst.
+    // Stops early if run() returns false.
+    template <class V, class Run>
+    static void runDue(V &heap, unsigned long now, Run run)
+    {
+        while (!heap.empty() && (long)(now - heap.front()->nextLoop) >= 0) {
+            std::pop_heap(heap.begin(), heap.end(), after);
+            T *item = heap.back();
+
+            boolean more = run(item);
+
+            item->nextLoop += item->loopPeriod;
+            if ((long)(now - item->nextLoop) >= 0)
+                item->nextLoop = now + item->loopPeriod;
+
+            std::push_heap(heap.begin(), heap.end(), after);
+
+            if (!more)
+                break;
+        }
+    }
+};
+
+// tracks when a value refreshed on demand must be refreshed again - no more often than once every 'ttl' millis
+class TTLTimer
+{
+    uint32_t ttl = 0;       // time (in millis) a refreshed value remains valid
+    uint32_t time = 0;      // time (in millis) of last refresh
+    boolean valid = false;  // flag indicating value has been refreshed at least once since set()
+
+  public:
+    void set(uint32_t _ttl)  // sets ttl and forces a refresh on next call to due()
+    {
+        ttl = _ttl;
+        valid = false;
+    }
+
+    boolean due(uint32_t now)  // returns true, and restarts ttl, if value needs refreshing at time 'now'
+    {
+        if (valid && now - time < ttl)  // value is still fresh
+            return (false);
+
+        valid = true;
+        time = now;
+        return (true);
+    }
+};
+
+// refreshes values that have read callbacks, using pointers to objects of class T, each with a read callback
+// T::readCallback (NULL if none), a TTLTimer T::readTimer, and a container T::evList of the Controllers subscribed to
+// its value.  T must declare 'friend struct ReadRefresh<T>'.
+template <class T>
+struct ReadRefresh
+{
+    static void check(T *item, uint32_t now)  // calls read callback if value has not been refreshed within its TTL
+    {
+        if (item->readTimer.due(now))  // value is not yet refreshed, or has expired
+            item->readCallback(item);
+    }
+
+    // background refresh of each item in 'items' (all of which have read callbacks), but only while some Controller
+    // is subscribed to its value
+    template <class V>
+    static void subscribed(V &items, uint32_t now)
+    {
+        for (auto item = items.begin(); item != items.end(); item++) {
+            if (!(*item)->evList.empty())
+                check(*item, now);
+        }
+    }
+
+    // refresh of each item that has a read callback among the entries of a request, where item(entry) returns the
+    // item of an entry (NULL if none)
+    template <class V, class Item>
+    static void requested(V &entries, Item item, uint32_t now)
+    {
+        for (auto entry = entries.begin(); entry != entries.end(); entry++) {
+            T *t = item(*entry);
+            if (t && t->readCallback)
+                check(t, now);
+        }
+    }
+};
+
+// times a write-coalescing window, which opens with the first write held and closes 'length' millis later
+class WriteWindow
+{
+    uint32_t length = 0;      // time (in millis) writes are held - 0 means writes are not held
+    uint32_t closeTime = 0;   // time (in millis) at which open window closes
+    boolean pending = false;  // flag indicating window is open and holding writes
+
+  public:
+    void setLength(uint32_t ms) { length = ms; }
+    boolean enabled() { return (length > 0); }
+    boolean isPending() { return (pending); }
+
+    boolean hold(uint32_t now)  // opens window if not already open - returns true if it was opened by this write
+    {
+        if (pending)
+            return (false);
+
+        pending = true;
+        closeTime = now + length;
+        return (true);
+    }
+
+    boolean due(uint32_t now) { return (pending && (int32_t)(now - closeTime) >= 0); }  // window has closed
+    void finish() { pending = false; }  // held writes have been processed
+};
+
+// holds writes to objects of class T acknowledged while their Service's write-coalescing window is open, and hands
+// them to update() when it closes.  T must have values 'value', 'newValue' and 'heldValue' copied with uvSet() and
+// compared with uvEqual(), flags 'writeHeld' and 'updateFlag', and methods markChanged(), commitNewValue() and
+// revertNewValue().  T must declare 'friend struct HeldWrites<T>'.
+template <class T>
+struct HeldWrites
+{
+    static void hold(T *item)  // moves newValue into heldValue (restoring newValue) until window closes
+    {
+        item->uvSet(item->heldValue, item->newValue);
+        item->writeHeld = true;
+        item->uvSet(item->newValue, item->value);  // setVal() and update() see the current value until window closes
+        item->updateFlag = 0;
+        item->markChanged();  // heldValue is reported to Controllers while window is open
+    }
+
+    template <class V>
+    static void release(V &items)  // moves held values back into newValue, ready for update()
+    {
+        for (auto item = items.begin(); item != items.end(); item++) {
+            if (!(*item)->writeHeld)
+                continue;
+
+            if (!(*item)->updateFlag) {  // not written again in the request now being processed
+                (*item)->uvSet((*item)->newValue, (*item)->heldValue);
+                (*item)->updateFlag = 1;
+            }
+            (*item)->writeHeld = false;
+        }
+    }
+
+    template <class V>
+    static boolean changed(V &items)  // returns true if any value released to update() differs from current value
+    {
+        for (auto item = items.begin(); item != items.end(); item++) {
+            if ((*item)->updateFlag && !(*item)->uvEqual((*item)->newValue, (*item)->value))
+                return (true);
+        }
+        return (false);
+    }
+
+    template <class V>
+    static void finish(V &items, boolean ok)  // commits (if update() succeeded) or reverts values released to update()
+    {
+        for (auto item = items.begin(); item != items.end(); item++) {
+            if (!(*item)->updateFlag)
+                continue;
+
+            if (ok)
+                (*item)->commitNewValue();
+            else
+                (*item)->revertNewValue();
+            (*item)->updateFlag = 0;
+        }
+    }
+
+    // ends released writes when update() was skipped because no value changed - there is nothing to store, mark as
+    // changed, or save to NVS
+    template <class V>
+    static void discard(V &items)
+    {
+        for (auto item = items.begin(); item != items.end(); item++)
+            (*item)->updateFlag = 0;
+    }
+};
+
+// checks out pair-verify temporaries (of type T::tempKeys_t) for objects of class T from the fixed pool
+// T::tempPool[T::MAX_PAIR_VERIFY] shared by all of them.  A slot held for longer than T::PAIR_VERIFY_TIMEOUT millis is
+// reclaimed from its abandoned owner; when every slot is busy the temporaries are allocated from the heap instead
+// (counted in T::tempFallbacks), so a burst of reconnects is never refused while memory lasts.  Temporaries are wiped
+// when released.  T must have a member 'temp' pointing to the temporaries it holds (NULL if none).
+template <class T>
+struct PairVerifyPool
+{
+    typedef typename T::tempKeys_t temp_t;
+
+    static boolean inPool(temp_t *temp) { return (temp >= T::tempPool && temp < T::tempPool + T::MAX_PAIR_VERIFY); }
+
+    static boolean acquire(T *client, uint32_t now)  // returns false only if the heap is exhausted
+    {
+        if (client->temp) {  // client already holds temporaries (e.g. Controller restarted pair-verify)
+            client->temp->startTime = now;
+            return (true);
+        }
+
+        for (int i = 0; i < T::MAX_PAIR_VERIFY; i++) {
+            temp_t *slot = T::tempPool + i;
+            if (!slot->owner || now - slot->startTime > T::PAIR_VERIFY_TIMEOUT) {  // free or abandoned slot
+                if (slot->owner)
+                    release(slot->owner);
+                client->temp = slot;
+                break;
+            }
+        }
+
+        if (!client->temp) {
+            client->temp = (temp_t *)hs_calloc(1, sizeof(temp_t), HS_MEM_CRYPTO);
+            if (!client->temp)
+                return (false);
+            T::tempFallbacks++;
+        }
+
+        client->temp->owner = client;
+        client->temp->startTime = now;
+        return (true);
+    }
+
+    static void release(T *client)  // wipes temporaries and returns them to the pool (or the heap)
+    {
+        if (!client->temp)
+            return;
+
+        sodium_memzero(client->temp, sizeof(temp_t));  // wipes keys and marks slot as free (owner=NULL)
+        if (!inPool(client->temp))
+            hs_free(client->temp, HS_MEM_CRYPTO);
+        client->temp = NULL;
+    }
+
+    static int used()  // number of pool slots in use
+    {
+        int n = 0;
+        for (int i = 0; i < T::MAX_PAIR_VERIFY; i++)
+            if (T::tempPool[i].owner)
+                n++;
+        return (n);
+    }
+};
+
+// stores log entries back-to-back in a caller-supplied byte ring, each an E header followed by its null-terminated
+// message, padded to a multiple of 4 bytes.  Appending an entry evicts the oldest entries as needed to make room (and
+// to keep no more than 'maxEntries'), and never allocates.  E must have uint32_t members seq, next and prev, and a
+// uint16_t member len.  Callers must serialize access.
+template <class E>
+class LogRing
+{
+  public:
+    static const uint32_t NO_OFFSET = 0xFFFFFFFF;
+
+    struct cursor_t
+    {                     // position of an entry in the log
+        uint32_t seq;     // sequence number of entry
+        uint32_t offset;  // offset of entry in ring (NO_OFFSET if not yet known)
+
+        cursor_t(uint32_t seq, uint32_t offset = NO_OFFSET) : seq{seq}, offset{offset} {}
+    };
+
+  private:
+    uint8_t *ring = NULL;     // ring holding all log entries
+    uint32_t ringSize = 0;    // size of ring (in bytes)
+    uint32_t maxEntries = 0;  // maximum number of entries held in ring
+    uint32_t head = 0;        // offset in ring just past newest entry
+    uint32_t tail = 0;        // offset in ring of oldest entry
+    uint32_t newest = 0;      // offset in ring of newest entry
+    uint32_t nLive = 0;       // number of entries currently held in ring
+    uint32_t nEntries = 0;    // total cumulative number of entries (also sequence number of newest entry)
+
+    E *at(uint32_t offset) { return ((E *)(ring + offset)); }
+
+  public:
+    void begin(uint8_t *buf, uint32_t size, uint32_t max)
+    {
+        ring = buf;
+        ringSize = size;
+        maxEntries = max;
+    }
+
+    boolean enabled() { return (ring != NULL); }
+
+    // size an entry with a message of 'len' characters takes up in the ring (padded to keep every header 4-byte
+    // aligned) - must not exceed the size of the ring
+    static uint32_t entrySize(uint16_t len) { return ((sizeof(E) + len + 1 + 3) & ~3); }
+
+    // appends 'msg' (of entry.len characters) with header 'entry', after setting entry.seq, entry.next and entry.prev
+    void append(E &entry, const char *msg)
+    {
+        uint32_t size = entrySize(entry.len);
+        uint32_t offset = (head + size <= ringSize) ? head : 0;  // wrap to start of ring if entry does not fit at end
+
+        while (nLive > 0) {  // evict oldest entries until there is room
+            boolean fits;
+            if (nLive >= maxEntries)
+                fits = false;
+            else if (tail < head)  // live entries do not wrap: free space is after head and before tail
+                fits = (offset == head || offset + size <= tail);
+            else  // live entries wrap: free space is only between head and tail
+                fits = (offset == head && head + size <= tail);
+
+            if (fits)
+                break;
+
+            tail = at(tail)->next;
+            nLive--;
+        }
+
+        if (nLive > 0)
+            at(newest)->next = offset;
+        else
+            tail = offset;
+
+        entry.seq = ++nEntries;
+        entry.prev = newest;
+        entry.next = NO_OFFSET;
+        memcpy(ring + offset, &entry, sizeof(E));
+        memcpy(ring + offset + sizeof(E), msg, entry.len + 1);
+
+        newest = offset;
+        head = offset + size;
+        nLive++;
+    }
+
+    // copies entry at cursor (and up to msgSize-1 characters of its message) and then moves cursor to the next older
+    // (or newer) entry - returns false if entry at cursor is not (or is no longer) in the log
+    boolean read(cursor_t &cursor, E &entry, char *msg, size_t msgSize, boolean older = true)
+    {
+        uint32_t oldestSeq = nEntries - nLive + 1;
+
+        if (nLive == 0 || cursor.seq < oldestSeq || cursor.seq > nEntries)
+            return (false);
+
+        if (cursor.offset == NO_OFFSET) {  // locate entry by walking forward from oldest
+            cursor.offset = tail;
+            for (uint32_t seq = oldestSeq; seq < cursor.seq; seq++)
+                cursor.offset = at(cursor.offset)->next;
+        }
+
+        memcpy(&entry, ring + cursor.offset, sizeof(E));
+        size_t n = entry.len < msgSize - 1 ? entry.len : msgSize - 1;
+        memcpy(msg, ring + cursor.offset + sizeof(E), n);
+        msg[n] = '\0';
+
+        if (older) {
+            cursor.seq--;
+            cursor.offset = entry.prev;
+        } else {
+            cursor.seq++;
+            cursor.offset = entry.next;  // NO_OFFSET if this is the newest entry (next entry located when read)
+        }
+        return (true);
+    }
+
+    // reads like read() toward newer entries, except that if the entry at cursor has been evicted, cursor first skips
+    // ahead to the oldest entry still in the log - returns false only if there is no entry from cursor up to lastSeq
+    boolean readNewer(cursor_t &cursor, uint32_t lastSeq, E &entry, char *msg, size_t msgSize)
+    {
+        uint32_t oldestSeq = nEntries - nLive + 1;
+
+        if (nLive > 0 && cursor.seq < oldestSeq)
+            cursor = cursor_t(oldestSeq, tail);
+
+        if (cursor.seq > lastSeq)
+            return (false);
+
+        return (read(cursor, entry, msg, msgSize, false));
+    }
+
+    // returns sequence numbers of oldest and newest entries in the log (oldest is greater than newest if log is empty)
+    void getRange(uint32_t &oldestSeq, uint32_t &newestSeq)
+    {
+        newestSeq = nEntries;
+        oldestSeq = nEntries - nLive + 1;
+    }
+};
 }  // namespace Utils
 
 /////////////////////////////////////////////////
@@ -95,6 +587,87 @@ class TempBuffer
     operator bufType *() const { return (buf); }
 };
 
+////////////////////////////////
+//         BumpArena          //
+////////////////////////////////
+
+class BumpArena
+{
+  private:
+    struct block_t
+    {
+        block_t *next;  // next overflow block
+    };
+
+    static const uint16_t SHRINK_RESETS = 64;  // number of resets after which an enlarged main block may shrink
+
+    hsMemTag tag;              // allocation tag (determines placement of main and overflow blocks)
+    uint8_t *buf = NULL;       // main block, sized to the high-water mark of recent requests
+    size_t minCapacity;        // initial size of main block, below which it never shrinks
+    size_t capacity;           // size of main block
+    size_t used = 0;           // bytes allocated from main block since last reset()
+    size_t demand = 0;         // total bytes requested since last reset() (including overflow)
+    size_t highWater = 0;      // largest demand seen across all resets
+    size_t recentPeak = 0;     // largest demand seen since main block was last resized or checked for shrinking
+    uint16_t resets = 0;       // number of resets since main block was last resized or checked for shrinking
+    uint32_t overflows = 0;    // number of allocations that did not fit in main block
+    block_t *overflow = NULL;  // overflow blocks allocated from the heap, freed on reset()
+
+    void *allocBlock(size_t nBytes);  // allocates block with tag; halts if heap is exhausted
+    void resize(size_t nBytes);       // frees main block, which is re-allocated with nBytes on next use
+
+  public:
+    BumpArena(hsMemTag tag, size_t initialSize = 0) : tag(tag), minCapacity(initialSize), capacity(initialSize) {}
+    ~BumpArena();  // frees main block and any overflow blocks
+
+    void *alloc(size_t nBytes);  // returns nBytes of 4-byte aligned storage valid until next reset(); halts if heap
+                                 // is exhausted
+    void reset();  // releases all storage; grows main block if previous request overflowed, or shrinks it (but not
+                   // below initialSize) if no request in the last SHRINK_RESETS needed all of it
+
+    template <class T>
+    T *allocArray(size_t nElements)  // default-constructs nElements of type T (which must be trivially destructible)
+    {
+        T *p = (T *)alloc(nElements * sizeof(T));
+        for (size_t i = 0; i < nElements; i++)
+            new (p + i) T();
+        return (p);
+    }
+
+    size_t getCapacity() { return (capacity); }
+    size_t getHighWater() { return (highWater); }
+    uint32_t getOverflows() { return (overflows); }
+};
+
+////////////////////////////////
+//         PinToggle          //
+////////////////////////////////
+
+// drives an output pin to match a boolean state, and optionally flips that state on each debounced edge of a toggle
+// input pin (such as a rocker switch).  The pin-change ISR calls edge(), which holds 'mux' while it changes the state
+// and output pin, as callers of drive() must too - so the two never disagree, even if the ISR runs on the other core.
+
+class PinToggle
+{
+  public:
+    uint8_t outPin;             // output pin driven to match state
+    int togglePin;              // optional input pin whose edges flip state (-1 if none)
+    uint16_t toggleTime;        // minimum time (in millis) between accepted edges on togglePin
+    volatile boolean state;     // current level of outPin
+    volatile int lastLevel;     // level of togglePin at last accepted edge
+    volatile int64_t lastEdge;  // time (in micros) of last accepted edge
+    volatile uint32_t toggles;  // number of accepted edges on togglePin
+    portMUX_TYPE *mux;          // spinlock held while state and outPin change
+
+    // sets up pins, starting outPin at 'initial', and attaches isr(arg) to edges on togglePin (if any)
+    void begin(uint8_t outPin, int togglePin, uint16_t toggleTime, boolean initial, portMUX_TYPE *mux,
+               void (*isr)(void *), void *arg);
+    void end();                    // detaches ISR from togglePin (if any)
+    boolean edge();                // for use in ISR - flips state and drives outPin unless edge is a bounce; returns
+                                   // true if edge was accepted
+    void drive(boolean newState);  // sets state and drives outPin - caller must hold mux
+};
+
 ////////////////////////////////
 //         PushButton         //
 ////////////////////////////////
@@ -117,6 +690,26 @@ class PushButton
     static touch_value_t threshold;
     static const int calibCount = 20;
 
+    static const int EDGE_RING_SIZE = 16;  // number of button edges that can be queued by interrupt handler
+
+    struct edge_t
+    {
+        uint32_t time;    // time of edge (in millis)
+        boolean pressed;  // state of button after edge
+    };
+
+    edge_t edges[EDGE_RING_SIZE];           // ring of edges queued by edgeISR() - single producer, single consumer
+    volatile uint8_t edgeHead = 0;          // next slot to be written by edgeISR()
+    volatile uint8_t edgeTail = 0;          // next slot to be read by triggered() or toggled()
+    volatile boolean edgeOverflow = false;  // flag indicating ring was full and edges were lost
+    boolean useEdges = false;               // flag indicating button is read from edge interrupts instead of polling
+    boolean lastPressed = false;            // state of button after last edge read from ring
+
+    static void edgeISR(void *arg);         // interrupt handler that queues a timestamped edge
+    boolean nextEdge(edge_t &e);            // peeks at next queued edge; returns false if none
+    boolean triggerStep(uint32_t cTime, boolean pressed, uint16_t singleTime, uint16_t longTime, uint16_t doubleTime);
+    boolean toggleStep(uint32_t cTime, boolean pressed, uint16_t toggleTime);
+
   public:
     typedef boolean (*triggerType_t)(int pin);
 
@@ -147,6 +740,7 @@ class PushButton
 #endif
 
     PushButton(int pin, triggerType_t triggerType = TRIGGER_ON_LOW);
+    ~PushButton();
 
     //  Creates a push-button/toggle-switch of specified type on specified pin
     //
@@ -156,6 +750,10 @@ class PushButton
     //                with *pin* is pressed/on, or FALSE if not.  Can choose from 3 pre-specifed
     //                triggerType_t functions (TRIGGER_ON_LOW, TRIGGER_ON_HIGH, and TRIGGER_ON_TOUCH),
     //                or write your own custom handler
+    //
+    //  Buttons using TRIGGER_ON_LOW or TRIGGER_ON_HIGH are read from pin-change interrupts that queue timestamped
+    //  edges, so press classification does not depend on how often triggered() or toggled() is called.  Touch
+    //  sensors and custom handlers are polled.
 
     void reset();
 
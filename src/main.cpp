@@ -20,9 +20,9 @@ class InvertedLED : public Blinkable
 class DevLed : public Service::LightBulb
 {
     int ledPin;
-    int powerPin;
     SpanCharacteristic *power;
 
+    uint32_t toggles{0};
     int resetCount{0};
     uint32_t resetAlarm{0};
     uint32_t resetTime{3000};
@@ -30,22 +30,15 @@ class DevLed : public Service::LightBulb
   public:
     DevLed(int ledPin, int powerPin)
     {
-        power = new Characteristic::On();
+        power = (new Characteristic::On())->bindPin(ledPin, powerPin);  // relay follows power, switch flips it
         this->ledPin = ledPin;
-        pinMode(ledPin, OUTPUT);
-
-        new SpanToggle(powerPin);
-        this->powerPin = powerPin;
     }
 
-    boolean update()
+    void loop() override
     {
-        digitalWrite(ledPin, power->getNewVal());
-        return (true);
-    }
+        if (power->getPinToggles() == toggles)
+            return;
 
-    void button(int pin, int pressType) override
-    {
         unsigned long cTime = millis();
 
         if (resetCount == 0 || cTime > resetAlarm) {
@@ -53,20 +46,15 @@ class DevLed : public Service::LightBulb
             resetCount = 0;
         }
 
-        if (pressType == SpanButton::OPEN || pressType == SpanButton::CLOSED) {
-            power->setVal(1 - power->getVal());
+        resetCount += power->getPinToggles() - toggles;
+        toggles = power->getPinToggles();
 
-            resetCount++;
-        }
-
-        if (resetCount == 7 && cTime < resetAlarm) {
+        if (resetCount >= 7 && cTime < resetAlarm) {
+            resetCount = 0;
             homeSpan.processSerialCommand("A");
 
             digitalWrite(ledPin, LOW);
-            return;
         }
-
-        digitalWrite(ledPin, power->getVal());
     }
 };
 
@@ -0,0 +1,160 @@
+// Minimal host stand-in for the parts of the Arduino-ESP32 core used by the HomeSpan sources under test
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <cmath>
+#include <string>
+#include <new>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define IRAM_ATTR  // code is never placed in internal RAM on the host
+
+// virtual clock - tests advance hostMicros explicitly
+
+extern uint64_t hostMicros;
+inline uint32_t micros() { return ((uint32_t)hostMicros); }
+inline uint32_t millis() { return ((uint32_t)(hostMicros / 1000)); }
+inline void delay(uint32_t ms) { hostMicros += (uint64_t)ms * 1000; }
+inline int64_t esp_timer_get_time() { return ((int64_t)hostMicros); }
+
+uint32_t esp_random();
+
+// CPU cycle counter, running at getCpuFrequencyMhz() cycles per microsecond of the virtual clock
+
+inline uint32_t getCpuFrequencyMhz() { return (160); }
+
+struct EspClass
+{
+    uint32_t getCycleCount() { return ((uint32_t)(hostMicros * getCpuFrequencyMhz())); }
+};
+inline EspClass ESP;
+
+// simulated GPIO levels
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+#define CHANGE 0x03
+
+extern int hostPinLevel[64];
+inline int digitalRead(int pin) { return (hostPinLevel[pin & 63]); }
+inline void digitalWrite(int pin, int level) { hostPinLevel[pin & 63] = level; }
+inline void pinMode(int, int) {}
+
+// pin-change interrupts - hostSetPin() changes the level of a pin and, if it changed, calls the attached handler
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+void hostSetPin(int pin, int level);
+
+class String
+{
+    std::string s;
+
+  public:
+    String(const char *c = "") : s(c ? c : "") {}
+    String(const std::string &c) : s(c) {}
+    String(int v) : s(std::to_string(v)) {}
+    const char *c_str() const { return (s.c_str()); }
+    size_t length() const { return (s.length()); }
+    String &operator+=(const String &x)
+    {
+        s += x.s;
+        return (*this);
+    }
+    String &operator+=(const char *x)
+    {
+        s += x;
+        return (*this);
+    }
+    String &operator+=(char c)
+    {
+        s += c;
+        return (*this);
+    }
+    String operator+(const String &x) const { return (String(s + x.s)); }
+    String operator+(const char *x) const { return (String(s + x)); }
+    bool operator==(const char *x) const { return (s == x); }
+    bool operator==(const String &x) const { return (s == x.s); }
+    void clear() { s.clear(); }
+};
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+            write(buf[i]);
+        return (n);
+    }
+    size_t write(const char *s) { return (write((const uint8_t *)s, strlen(s))); }
+    size_t write(const char *buf, size_t n) { return (write((const uint8_t *)buf, n)); }
+
+    size_t print(const char *s) { return (write(s)); }
+    size_t print(const String &s) { return (write(s.c_str(), s.length())); }
+    size_t print(char c) { return (write((uint8_t)c)); }
+    size_t print(int v) { return (printf("%d", v)); }
+    size_t print(unsigned int v) { return (printf("%u", v)); }
+    size_t print(long v) { return (printf("%ld", v)); }
+    size_t print(unsigned long v) { return (printf("%lu", v)); }
+    size_t print(long long v) { return (printf("%lld", v)); }
+    size_t print(unsigned long long v) { return (printf("%llu", v)); }
+    size_t print(double v, int digits = 2) { return (printf("%.*f", digits, v)); }
+
+    template <typename T> size_t println(const T &x) { return (print(x) + print("\n")); }
+    size_t println() { return (print("\n")); }
+
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buf[512];
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+        if (n < 0)
+            return (0);
+        return (write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1));
+    }
+};
+
+// Serial output goes to stdout, unless captured by a test
+
+class HardwareSerial : public Print
+{
+  public:
+    bool capturing = false;
+    std::string captured;
+
+    int available() { return (0); }  // there is no serial input on the host
+    int read() { return (-1); }
+
+    size_t write(uint8_t c) override { return (write(&c, 1)); }
+    size_t write(const uint8_t *buf, size_t n) override
+    {
+        if (capturing)
+            captured.append((const char *)buf, n);
+        else
+            fwrite(buf, 1, n, stdout);
+        return (n);
+    }
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
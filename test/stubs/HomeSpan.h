@@ -0,0 +1,16 @@
+// Host stand-in for the one part of Span used by Utils.cpp.  The test build compiles a copy of Utils.cpp placed in
+// the build directory (see CMakeLists.txt), so that its #include "HomeSpan.h" finds this file instead of the real one.
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "Log.h"
+
+class Span
+{
+  public:
+    boolean getSerialInputDisable() { return (true); }  // readSerial() returns an empty string right away
+};
+
+extern Span homeSpan;
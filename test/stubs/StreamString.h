@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+
+class StreamString : public Print, public String
+{
+  public:
+    size_t write(uint8_t c) override
+    {
+        *this += (char)c;
+        return (1);
+    }
+    using Print::write;
+};
@@ -0,0 +1,35 @@
+// Host stand-ins for FreeRTOS types.  Critical sections map to one global recursive mutex, which models a
+// single-core ESP32-C3 where entering any critical section excludes every other task.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+
+struct portMUX_TYPE
+{
+    int unused;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED \
+    {                                \
+        0                            \
+    }
+
+void hostEnterCritical();
+void hostExitCritical();
+
+#define portENTER_CRITICAL(m) hostEnterCritical()
+#define portEXIT_CRITICAL(m) hostExitCritical()
+#define portENTER_CRITICAL_ISR(m) hostEnterCritical()
+#define portEXIT_CRITICAL_ISR(m) hostExitCritical()
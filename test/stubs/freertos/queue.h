@@ -0,0 +1,21 @@
+// Thread-safe host stand-in for FreeRTOS queues.  Sends and receives from a task (any thread) wait while another
+// thread has the scheduler suspended, which models a single core on which no other task runs during vTaskSuspendAll().
+// The FromISR variants ignore the suspension, just as interrupts still run on the ESP32.
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+typedef struct hostQueue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t depth, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *taskWoken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *item, BaseType_t *taskWoken);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaitingFromISR(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+#define portYIELD_FROM_ISR()
@@ -0,0 +1,23 @@
+// No-split ring buffers, holding each item in its own heap block.  Senders block while the ring is full, and
+// receivers block while it is empty or while a test holds back receiving with hostRingbufHold(true), as if the task
+// receiving from the ring had not yet been scheduled.
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+typedef void *RingbufHandle_t;
+
+enum RingbufferType_t
+{
+    RINGBUF_TYPE_NOSPLIT
+};
+
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t type);
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t ring);
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t ring, void **item, size_t size, TickType_t ticks);
+BaseType_t xRingbufferSendComplete(RingbufHandle_t ring, void *item);
+void *xRingbufferReceive(RingbufHandle_t ring, size_t *size, TickType_t ticks);
+void vRingbufferReturnItem(RingbufHandle_t ring, void *item);
+
+void hostRingbufHold(bool hold);  // while true, xRingbufferReceive() waits
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+TaskHandle_t xTaskGetCurrentTaskHandle();  // returns hostTaskHandle of the calling thread
+void vTaskDelay(TickType_t ticks);
+void vTaskDelete(TaskHandle_t task);
+void vTaskSuspendAll();
+BaseType_t xTaskResumeAll();
+BaseType_t xTaskCreateUniversal(TaskFunction_t fn, const char *name, uint32_t stack, void *args, UBaseType_t priority,
+                                TaskHandle_t *handle, BaseType_t core);
+
+extern thread_local TaskHandle_t hostTaskHandle;  // tests set this to impersonate a task
@@ -0,0 +1,7 @@
+// Host-only view of the tagged allocations made through the hs_malloc() stand-ins in stubs.cpp
+
+#pragma once
+
+#include "PSRAM.h"
+
+size_t hostMemLive(hsMemTag tag);  // bytes currently allocated with tag
@@ -0,0 +1,69 @@
+// mbedtls_mpi API used by SRP.cpp, implemented on OpenSSL BIGNUMs for host tests
+
+#pragma once
+
+#include <openssl/bn.h>
+#include <cstring>
+
+#define MBEDTLS_ERR_MPI_BUFFER_TOO_SMALL -0x0008
+
+struct mbedtls_mpi
+{
+    BIGNUM *bn;
+};
+
+BN_CTX *hostBnCtx();
+
+inline void mbedtls_mpi_init(mbedtls_mpi *X) { X->bn = BN_new(); }
+inline void mbedtls_mpi_free(mbedtls_mpi *X)
+{
+    BN_clear_free(X->bn);
+    X->bn = NULL;
+}
+inline int mbedtls_mpi_lset(mbedtls_mpi *X, long z) { return (BN_set_word(X->bn, z) ? 0 : -1); }
+inline size_t mbedtls_mpi_size(const mbedtls_mpi *X) { return (BN_num_bytes(X->bn)); }
+inline int mbedtls_mpi_read_binary(mbedtls_mpi *X, const unsigned char *buf, size_t len)
+{
+    return (BN_bin2bn(buf, len, X->bn) ? 0 : -1);
+}
+inline int mbedtls_mpi_write_binary(const mbedtls_mpi *X, unsigned char *buf, size_t len)
+{
+    return (BN_bn2binpad(X->bn, buf, len) < 0 ? MBEDTLS_ERR_MPI_BUFFER_TOO_SMALL : 0);
+}
+inline int mbedtls_mpi_read_string(mbedtls_mpi *X, int radix, const char *s)
+{
+    return (radix == 16 && BN_hex2bn(&X->bn, s) ? 0 : -1);
+}
+inline int mbedtls_mpi_write_string(const mbedtls_mpi *X, int radix, char *buf, size_t buflen, size_t *olen)
+{
+    char *s = BN_bn2hex(X->bn);
+    size_t n = strlen(s) + 1;
+    *olen = n;
+    int ret = (radix != 16 || buflen < n) ? MBEDTLS_ERR_MPI_BUFFER_TOO_SMALL : 0;
+    if (!ret && buf)
+        memcpy(buf, s, n);
+    OPENSSL_free(s);
+    return (ret);
+}
+inline int mbedtls_mpi_add_mpi(mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *B)
+{
+    return (BN_add(X->bn, A->bn, B->bn) ? 0 : -1);
+}
+inline int mbedtls_mpi_mul_mpi(mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *B)
+{
+    return (BN_mul(X->bn, A->bn, B->bn, hostBnCtx()) ? 0 : -1);
+}
+inline int mbedtls_mpi_mod_mpi(mbedtls_mpi *R, const mbedtls_mpi *A, const mbedtls_mpi *B)
+{
+    return (BN_nnmod(R->bn, A->bn, B->bn, hostBnCtx()) ? 0 : -1);
+}
+
+// the Montgomery helper is accepted for API compatibility; a non-empty _RR records that it was initialized
+
+inline int mbedtls_mpi_exp_mod(mbedtls_mpi *X, const mbedtls_mpi *A, const mbedtls_mpi *E, const mbedtls_mpi *N,
+                               mbedtls_mpi *_RR)
+{
+    if (_RR && BN_is_zero(_RR->bn))
+        BN_mod_sqr(_RR->bn, BN_value_one(), N->bn, hostBnCtx());
+    return (BN_mod_exp(X->bn, A->bn, E->bn, N->bn, hostBnCtx()) ? 0 : -1);
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <openssl/crypto.h>
+
+inline void mbedtls_platform_zeroize(void *buf, size_t len) { OPENSSL_cleanse(buf, len); }
@@ -0,0 +1,31 @@
+// mbedtls SHA-512 API used by SRP.cpp and HKDF.cpp, implemented on OpenSSL for host tests
+
+#pragma once
+
+#include <openssl/sha.h>
+#include <cstring>
+
+struct mbedtls_sha512_context
+{
+    SHA512_CTX ctx;
+};
+
+inline void mbedtls_sha512_init(mbedtls_sha512_context *c) { memset(c, 0, sizeof(*c)); }
+inline void mbedtls_sha512_free(mbedtls_sha512_context *c) { memset(c, 0, sizeof(*c)); }
+inline void mbedtls_sha512_clone(mbedtls_sha512_context *dst, const mbedtls_sha512_context *src) { *dst = *src; }
+inline int mbedtls_sha512_starts_ret(mbedtls_sha512_context *c, int is384)
+{
+    return (is384 || !SHA512_Init(&c->ctx) ? -1 : 0);
+}
+inline int mbedtls_sha512_update_ret(mbedtls_sha512_context *c, const unsigned char *in, size_t len)
+{
+    return (SHA512_Update(&c->ctx, in, len) ? 0 : -1);
+}
+inline int mbedtls_sha512_finish_ret(mbedtls_sha512_context *c, unsigned char out[64])
+{
+    return (SHA512_Final(out, &c->ctx) ? 0 : -1);
+}
+inline int mbedtls_sha512_ret(const unsigned char *in, size_t len, unsigned char out[64], int is384)
+{
+    return (is384 || !SHA512(in, len, out) ? -1 : 0);
+}
@@ -0,0 +1,9 @@
+// Host stand-in for the ESP-IDF memory-region checks.  The host has no flash, so the read-only data of the test
+// executable (which holds its string literals, between the end of the code and the start of the writable data)
+// stands in for flash-mapped DROM.
+
+#pragma once
+
+extern "C" char etext, __data_start;
+
+inline bool esp_ptr_in_drom(const void *p) { return ((const char *)p >= &etext && (const char *)p < &__data_start); }
@@ -0,0 +1,33 @@
+// libsodium functions used by SRP.cpp and Resume.cpp, implemented on OpenSSL.  Tests may queue deterministic random
+// bytes, which are consumed before falling back to OpenSSL's generator.
+
+#pragma once
+
+#include <cstddef>
+
+#define crypto_box_PUBLICKEYBYTES 32
+#define crypto_aead_chacha20poly1305_IETF_ABYTES 16
+
+void randombytes_buf(void *buf, size_t n);
+void hostQueueRandom(const void *buf, size_t n);
+void sodium_memzero(void *pnt, size_t len);
+
+int crypto_aead_chacha20poly1305_ietf_encrypt(unsigned char *c,
+                                              unsigned long long *clen_p,
+                                              const unsigned char *m,
+                                              unsigned long long mlen,
+                                              const unsigned char *ad,
+                                              unsigned long long adlen,
+                                              const unsigned char *nsec,
+                                              const unsigned char *npub,
+                                              const unsigned char *k);
+
+int crypto_aead_chacha20poly1305_ietf_decrypt(unsigned char *m,
+                                              unsigned long long *mlen_p,
+                                              unsigned char *nsec,
+                                              const unsigned char *c,
+                                              unsigned long long clen,
+                                              const unsigned char *ad,
+                                              unsigned long long adlen,
+                                              const unsigned char *npub,
+                                              const unsigned char *k);
@@ -0,0 +1,414 @@
+// Host implementations of the stubbed Arduino, FreeRTOS, libsodium and HomeSpan memory functions
+
+#include <Arduino.h>
+#include <sodium.h>
+#include <mbedtls/bignum.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+#include <openssl/rand.h>
+#include <freertos/ringbuf.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+#include <thread>
+#include <unordered_map>
+
+#include "PSRAM.h"
+#include "HomeSpan.h"
+
+HardwareSerial Serial;
+Span homeSpan;
+uint64_t hostMicros = 0;
+int hostPinLevel[64];
+thread_local TaskHandle_t hostTaskHandle = NULL;
+
+static struct
+{
+    void (*isr)(void *);
+    void *arg;
+} pinInterrupts[64];
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int)
+{
+    pinInterrupts[pin & 63] = {isr, arg};
+}
+
+void detachInterrupt(uint8_t pin) { pinInterrupts[pin & 63] = {NULL, NULL}; }
+
+void hostSetPin(int pin, int level)
+{
+    if (hostPinLevel[pin & 63] == level)
+        return;
+    hostPinLevel[pin & 63] = level;
+    if (pinInterrupts[pin & 63].isr)
+        pinInterrupts[pin & 63].isr(pinInterrupts[pin & 63].arg);
+}
+
+static std::recursive_mutex criticalMutex;
+static std::deque<uint8_t> queuedRandom;
+
+void hostEnterCritical() { criticalMutex.lock(); }
+void hostExitCritical() { criticalMutex.unlock(); }
+
+uint32_t esp_random()
+{
+    uint32_t r;
+    randombytes_buf(&r, sizeof(r));
+    return (r);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return (hostTaskHandle); }
+void vTaskDelay(TickType_t) { std::this_thread::yield(); }
+void vTaskDelete(TaskHandle_t) {}
+
+// scheduler suspension: tasks take schedulerLock shared for each queue operation, vTaskSuspendAll() takes it
+// exclusively
+
+static std::shared_mutex schedulerLock;
+static thread_local int suspendDepth = 0;
+
+void vTaskSuspendAll()
+{
+    if (suspendDepth++ == 0)
+        schedulerLock.lock();
+}
+
+BaseType_t xTaskResumeAll()
+{
+    if (--suspendDepth == 0)
+        schedulerLock.unlock();
+    return (pdFALSE);
+}
+
+struct hostQueue
+{
+    std::mutex mutex;
+    std::deque<std::vector<uint8_t>> items;
+    size_t depth;
+    size_t itemSize;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t depth, UBaseType_t itemSize)
+{
+    QueueHandle_t q = new hostQueue;
+    q->depth = depth;
+    q->itemSize = itemSize;
+    return (q);
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+static BaseType_t queueSend(QueueHandle_t q, const void *item)
+{
+    std::lock_guard<std::mutex> lock(q->mutex);
+    if (q->items.size() >= q->depth)
+        return (pdFALSE);
+    q->items.emplace_back((const uint8_t *)item, (const uint8_t *)item + q->itemSize);
+    return (pdTRUE);
+}
+
+static BaseType_t queueReceive(QueueHandle_t q, void *item)
+{
+    std::lock_guard<std::mutex> lock(q->mutex);
+    if (q->items.empty())
+        return (pdFALSE);
+    memcpy(item, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    return (pdTRUE);
+}
+
+// each queue operation from a task is a point at which it may be preempted, unless the scheduler is suspended
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t)
+{
+    if (suspendDepth)
+        return (queueSend(queue, item));
+    std::this_thread::yield();
+    std::shared_lock<std::shared_mutex> task(schedulerLock);
+    return (queueSend(queue, item));
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *taskWoken)
+{
+    if (taskWoken)
+        *taskWoken = pdFALSE;
+    return (queueSend(queue, item));
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t)
+{
+    if (suspendDepth)
+        return (queueReceive(queue, item));
+    std::this_thread::yield();
+    std::shared_lock<std::shared_mutex> task(schedulerLock);
+    return (queueReceive(queue, item));
+}
+
+// the other core keeps running (and its ISRs keep firing) right after an item is taken, even in a critical section
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *item, BaseType_t *taskWoken)
+{
+    if (taskWoken)
+        *taskWoken = pdFALSE;
+    BaseType_t received = queueReceive(queue, item);
+    std::this_thread::yield();
+    return (received);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (queue->items.size());
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR(QueueHandle_t queue) { return (uxQueueMessagesWaiting(queue)); }
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return (queue->depth - queue->items.size());
+}
+
+// each task runs in its own detached thread, which is never stopped
+
+BaseType_t xTaskCreateUniversal(TaskFunction_t fn, const char *, uint32_t, void *args, UBaseType_t,
+                                TaskHandle_t *handle, BaseType_t)
+{
+    TaskHandle_t task = new char;  // unique handle
+    if (handle)
+        *handle = task;
+    std::thread([=]() {
+        hostTaskHandle = task;
+        fn(args);
+    }).detach();
+    return (pdPASS);
+}
+
+// ring buffers are allocated once and never deleted, so a task still waiting on one when the test ends is harmless
+
+struct hostRingbuf_t
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::pair<void *, size_t>> items;  // items sent and not yet received
+    std::unordered_map<void *, size_t> sizes;     // size of every item acquired and not yet returned
+    size_t capacity;
+    size_t used = 0;
+};
+
+static std::atomic<bool> ringbufHeld{false};
+
+RingbufHandle_t xRingbufferCreate(size_t size, RingbufferType_t)
+{
+    hostRingbuf_t *ring = new hostRingbuf_t;
+    ring->capacity = size;
+    return (ring);
+}
+
+size_t xRingbufferGetMaxItemSize(RingbufHandle_t ring)
+{
+    return (((hostRingbuf_t *)ring)->capacity / 2);
+}
+
+BaseType_t xRingbufferSendAcquire(RingbufHandle_t handle, void **item, size_t size, TickType_t ticks)
+{
+    hostRingbuf_t *ring = (hostRingbuf_t *)handle;
+    std::unique_lock<std::mutex> lock(ring->mutex);
+
+    if (size > ring->capacity / 2)
+        return (pdFALSE);
+    if (ring->used + size > ring->capacity && ticks != portMAX_DELAY)
+        return (pdFALSE);
+    while (ring->used + size > ring->capacity)
+        ring->changed.wait_for(lock, std::chrono::milliseconds(1));
+
+    *item = malloc(size);
+    ring->sizes[*item] = size;
+    ring->used += size;
+    return (pdTRUE);
+}
+
+BaseType_t xRingbufferSendComplete(RingbufHandle_t handle, void *item)
+{
+    hostRingbuf_t *ring = (hostRingbuf_t *)handle;
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    ring->items.push_back({item, ring->sizes[item]});
+    ring->changed.notify_all();
+    return (pdTRUE);
+}
+
+void *xRingbufferReceive(RingbufHandle_t handle, size_t *size, TickType_t ticks)
+{
+    hostRingbuf_t *ring = (hostRingbuf_t *)handle;
+    std::unique_lock<std::mutex> lock(ring->mutex);
+
+    auto ready = [=]() { return (!ring->items.empty() && !ringbufHeld); };
+    if (!ready() && ticks != portMAX_DELAY)
+        return (NULL);
+    while (!ready())
+        ring->changed.wait_for(lock, std::chrono::milliseconds(1));  // also polls ringbufHeld
+
+    void *item = ring->items.front().first;
+    *size = ring->items.front().second;
+    ring->items.pop_front();
+    return (item);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t handle, void *item)
+{
+    hostRingbuf_t *ring = (hostRingbuf_t *)handle;
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    ring->used -= ring->sizes[item];
+    ring->sizes.erase(item);
+    free(item);
+    ring->changed.notify_all();
+}
+
+void hostRingbufHold(bool hold)
+{
+    ringbufHeld = hold;
+}
+
+BN_CTX *hostBnCtx()
+{
+    static thread_local BN_CTX *ctx = BN_CTX_new();
+    return (ctx);
+}
+
+void randombytes_buf(void *buf, size_t n)
+{
+    uint8_t *p = (uint8_t *)buf;
+    while (n > 0 && !queuedRandom.empty()) {
+        *p++ = queuedRandom.front();
+        queuedRandom.pop_front();
+        n--;
+    }
+    if (n > 0)
+        RAND_bytes(p, n);
+}
+
+void hostQueueRandom(const void *buf, size_t n)
+{
+    queuedRandom.insert(queuedRandom.end(), (const uint8_t *)buf, (const uint8_t *)buf + n);
+}
+
+void sodium_memzero(void *pnt, size_t len)
+{
+    OPENSSL_cleanse(pnt, len);
+}
+
+// ChaCha20-Poly1305 (IETF): the ciphertext is followed by the 16-byte authentication tag, and decryption of a message
+// with a bad tag returns -1 without writing any plaintext (m may be NULL when there is no plaintext)
+
+int crypto_aead_chacha20poly1305_ietf_encrypt(unsigned char *c, unsigned long long *clen_p, const unsigned char *m,
+                                              unsigned long long mlen, const unsigned char *ad,
+                                              unsigned long long adlen, const unsigned char *,
+                                              const unsigned char *npub, const unsigned char *k)
+{
+    int len;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, k, npub);
+    if (adlen)
+        EVP_EncryptUpdate(ctx, NULL, &len, ad, adlen);
+    if (mlen)
+        EVP_EncryptUpdate(ctx, c, &len, m, mlen);
+    EVP_EncryptFinal_ex(ctx, c + mlen, &len);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, 16, c + mlen);
+    EVP_CIPHER_CTX_free(ctx);
+    if (clen_p)
+        *clen_p = mlen + 16;
+    return (0);
+}
+
+int crypto_aead_chacha20poly1305_ietf_decrypt(unsigned char *m, unsigned long long *mlen_p, unsigned char *,
+                                              const unsigned char *c, unsigned long long clen, const unsigned char *ad,
+                                              unsigned long long adlen, const unsigned char *npub,
+                                              const unsigned char *k)
+{
+    if (clen < 16)
+        return (-1);
+
+    unsigned long long mlen = clen - 16;
+    std::vector<unsigned char> plain(mlen + 1);
+    int len;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_DecryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, k, npub);
+    if (adlen)
+        EVP_DecryptUpdate(ctx, NULL, &len, ad, adlen);
+    if (mlen)
+        EVP_DecryptUpdate(ctx, plain.data(), &len, c, mlen);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, 16, (void *)(c + mlen));
+    bool ok = EVP_DecryptFinal_ex(ctx, plain.data() + mlen, &len) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+
+    if (!ok)
+        return (-1);
+    if (m)
+        memcpy(m, plain.data(), mlen);
+    if (mlen_p)
+        *mlen_p = mlen;
+    return (0);
+}
+
+// tagged allocations use the host heap, with live bytes tracked per tag as on the ESP32
+
+static std::mutex memMutex;
+static std::unordered_map<void *, size_t> memSizes;
+static size_t memLive[HS_MEM_NTAGS];
+
+static void memAccount(void *ptr, size_t size, hsMemTag tag)
+{
+    if (!ptr)
+        return;
+    std::lock_guard<std::mutex> lock(memMutex);
+    memSizes[ptr] = size;
+    memLive[tag] += size;
+}
+
+static void memRelease(void *ptr, hsMemTag tag)
+{
+    if (!ptr)
+        return;
+    std::lock_guard<std::mutex> lock(memMutex);
+    memLive[tag] -= memSizes[ptr];
+    memSizes.erase(ptr);
+}
+
+void *hs_malloc(size_t size, hsMemTag tag)
+{
+    void *p = malloc(size);
+    memAccount(p, size, tag);
+    return (p);
+}
+
+void *hs_calloc(size_t n, size_t size, hsMemTag tag)
+{
+    void *p = calloc(n, size);
+    memAccount(p, n * size, tag);
+    return (p);
+}
+
+void *hs_realloc(void *ptr, size_t size, hsMemTag tag)
+{
+    memRelease(ptr, tag);
+    void *p = realloc(ptr, size);
+    memAccount(p, size, tag);
+    return (p);
+}
+
+void hs_free(void *ptr, hsMemTag tag)
+{
+    memRelease(ptr, tag);
+    free(ptr);
+}
+
+void hs_memReport() {}
+
+size_t hostMemLive(hsMemTag tag)
+{
+    std::lock_guard<std::mutex> lock(memMutex);
+    return (memLive[tag]);
+}
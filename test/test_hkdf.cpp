@@ -0,0 +1,135 @@
+// HKDF::create() and HKDF::createPair() checked against OpenSSL's HKDF-SHA-512 as the reference implementation,
+// plus a benchmark of the cached-salt key schedules
+
+#include <gtest/gtest.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "HKDF.h"
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+bytes reference(const bytes &ikm, const bytes &salt, const std::string &info)
+{
+    bytes out(32);
+    size_t outLen = out.size();
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, NULL);
+    EVP_PKEY_derive_init(ctx);
+    EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha512());
+    EVP_PKEY_CTX_set1_hkdf_salt(ctx, salt.data(), salt.size());
+    EVP_PKEY_CTX_set1_hkdf_key(ctx, ikm.data(), ikm.size());
+    EVP_PKEY_CTX_add1_hkdf_info(ctx, (const uint8_t *)info.data(), info.size());
+    EVP_PKEY_derive(ctx, out.data(), &outLen);
+    EVP_PKEY_CTX_free(ctx);
+    return (out);
+}
+
+bytes str(const char *s) { return (bytes(s, s + strlen(s))); }
+
+bytes inputKey(size_t len)
+{
+    bytes k(len);
+    for (size_t i = 0; i < len; i++)
+        k[i] = (uint8_t)(i * 37 + 11);
+    return (k);
+}
+
+// salt and info strings used by HAP (the first six salts have pre-computed key schedules)
+
+const char *const hapSalts[][2] = {
+    {"Pair-Setup-Encrypt-Salt", "Pair-Setup-Encrypt-Info"},
+    {"Pair-Setup-Controller-Sign-Salt", "Pair-Setup-Controller-Sign-Info"},
+    {"Pair-Setup-Accessory-Sign-Salt", "Pair-Setup-Accessory-Sign-Info"},
+    {"Pair-Verify-Encrypt-Salt", "Pair-Verify-Encrypt-Info"},
+    {"Pair-Verify-ResumeSessionID-Salt", "Pair-Verify-ResumeSessionID-Info"},
+    {"Control-Salt", "Control-Read-Encryption-Key"},
+    {"Not-A-Fixed-Salt", "Some-Info"},
+};
+
+}  // namespace
+
+TEST(HKDF, StringSaltsMatchReference)
+{
+    for (size_t len : {32, 64}) {
+        bytes ikm = inputKey(len);
+        for (auto &s : hapSalts) {
+            uint8_t out[32];
+            EXPECT_EQ(HKDF::create(out, ikm.data(), ikm.size(), s[0], s[1]), 0);
+            EXPECT_EQ(bytes(out, out + 32), reference(ikm, str(s[0]), s[1])) << s[0] << " len=" << len;
+        }
+    }
+}
+
+TEST(HKDF, BinarySaltMatchesReference)
+{
+    bytes ikm = inputKey(32);
+
+    for (size_t saltLen : {0, 1, 40, 128, 129, 300}) {  // 129 and 300 exceed the SHA-512 block and are hashed first
+        bytes salt = inputKey(saltLen + 1);
+        salt.erase(salt.begin());
+        uint8_t out[32];
+        EXPECT_EQ(HKDF::create(out, ikm.data(), ikm.size(), salt.data(), salt.size(), "Pair-Resume-Request-Info"), 0);
+        EXPECT_EQ(bytes(out, out + 32), reference(ikm, salt, "Pair-Resume-Request-Info")) << "saltLen=" << saltLen;
+    }
+}
+
+TEST(HKDF, PairMatchesTwoSingleKeys)
+{
+    bytes ikm = inputKey(32);
+
+    for (const char *salt : {"Control-Salt", "Not-A-Fixed-Salt"}) {
+        uint8_t k1[32], k2[32];
+        EXPECT_EQ(HKDF::createPair(k1, "Control-Read-Encryption-Key", k2, "Control-Write-Encryption-Key", ikm.data(),
+                                   ikm.size(), salt),
+                  0);
+        EXPECT_EQ(bytes(k1, k1 + 32), reference(ikm, str(salt), "Control-Read-Encryption-Key"));
+        EXPECT_EQ(bytes(k2, k2 + 32), reference(ikm, str(salt), "Control-Write-Encryption-Key"));
+    }
+}
+
+TEST(HKDF, InitIsIdempotent)
+{
+    bytes ikm = inputKey(32);
+    uint8_t before[32], after[32];
+
+    HKDF::create(before, ikm.data(), ikm.size(), "Control-Salt", "Control-Read-Encryption-Key");
+    HKDF::init();
+    HKDF::init();
+    HKDF::create(after, ikm.data(), ikm.size(), "Control-Salt", "Control-Read-Encryption-Key");
+    EXPECT_EQ(bytes(before, before + 32), bytes(after, after + 32));
+}
+
+// Compares the cached fixed-salt key schedules with a binary (uncached) salt and with the OpenSSL reference.
+// Host timings only show relative costs.
+
+TEST(HKDF, Benchmark)
+{
+    const int nIter = 20000;
+    bytes ikm = inputKey(32), salt = str("Control-Salt");
+    uint8_t k1[32], k2[32];
+
+    auto time = [&](const char *label, std::function<void()> op) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < nIter; i++)
+            op();
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        printf("%-32s %8.2f us/op\n", label, us / nIter);
+    };
+
+    time("create (fixed salt)",
+         [&]() { HKDF::create(k1, ikm.data(), 32, "Control-Salt", "Control-Read-Encryption-Key"); });
+    time("createPair (fixed salt)", [&]() {
+        HKDF::createPair(k1, "Control-Read-Encryption-Key", k2, "Control-Write-Encryption-Key", ikm.data(), 32,
+                         "Control-Salt");
+    });
+    time("create (binary salt)", [&]() {
+        HKDF::create(k1, ikm.data(), 32, salt.data(), salt.size(), "Control-Read-Encryption-Key");
+    });
+    time("OpenSSL reference", [&]() { reference(ikm, salt, "Control-Read-Encryption-Key"); });
+}
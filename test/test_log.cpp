@@ -0,0 +1,167 @@
+// SpanLog::decode(), which expands a record packed by SpanLog::printf() against its format string.  Until a test calls
+// SpanLog::begin(), every LOG1()/LOG2() record is packed and decoded synchronously; after that, records are queued in
+// a ring buffer and printed by the log task.  Either way, the result is captured from Serial and compared with what
+// printf() itself produces.
+
+#include <gtest/gtest.h>
+#include <string>
+
+#include "Log.h"
+
+namespace {
+
+template <typename... Args> std::string logged(const char *fmt, const Args &...args)
+{
+    Serial.captured.clear();
+    Serial.capturing = true;
+    SpanLog::printf(fmt, args...);
+    SpanLog::flush();
+    Serial.capturing = false;
+    return (Serial.captured);
+}
+
+template <typename... Args> std::string expected(const char *fmt, Args... args)
+{
+    char buf[2048];
+    snprintf(buf, sizeof(buf), fmt, args...);
+    return (buf);
+}
+
+}  // namespace
+
+TEST(SpanLog, IntegersMatchPrintf)
+{
+    EXPECT_EQ(logged("aid=%d iid=%u", 1, 12u), "aid=1 iid=12");
+    EXPECT_EQ(logged("[%5d|%-5d|%05d]", -42, 42, 42), expected("[%5d|%-5d|%05d]", -42, 42, 42));
+    EXPECT_EQ(logged("%x %X %o", 0xBEEF, 0xBEEF, 8), "beef BEEF 10");
+    EXPECT_EQ(logged("%c%c", 'o', 'k'), "ok");
+    EXPECT_EQ(logged("%d", true), "1");
+}
+
+TEST(SpanLog, NegativeIntegersWithUnsignedConversions)
+{
+    EXPECT_EQ(logged("%u", -1), "4294967295");  // 32-bit, as on the ESP32
+    EXPECT_EQ(logged("%x", -1), "ffffffff");
+    EXPECT_EQ(logged("%d", (int8_t)-5), "-5");
+}
+
+TEST(SpanLog, SixtyFourBitIntegers)
+{
+    int64_t big = -1234567890123LL;
+    uint64_t ubig = 0xFEDCBA9876543210ULL;
+
+    EXPECT_EQ(logged("%lld", big), "-1234567890123");
+    EXPECT_EQ(logged("%llx", ubig), "fedcba9876543210");
+    EXPECT_EQ(logged("%llu", ubig), expected("%llu", (unsigned long long)ubig));
+}
+
+TEST(SpanLog, FloatsMatchPrintf)
+{
+    EXPECT_EQ(logged("%f", 21.5), "21.500000");
+    EXPECT_EQ(logged("%.1f C", 21.46f), "21.5 C");
+    EXPECT_EQ(logged("[%8.3e]", 12345.678), expected("[%8.3e]", 12345.678));
+    EXPECT_EQ(logged("%g", 0.0001), "0.0001");
+    EXPECT_EQ(logged("%.2f", 3), "3.00");  // integer argument with a float conversion
+    EXPECT_EQ(logged("%d", 7.9), "7");     // double argument with an integer conversion
+}
+
+TEST(SpanLog, Strings)
+{
+    std::string room = "Living Room";
+    String s("Light");
+    const char *none = NULL;
+
+    EXPECT_EQ(logged("%s: %s", room.c_str(), s), "Living Room: Light");
+    EXPECT_EQ(logged("[%-8s|%8s|%.3s]", "ab", "cd", "abcdef"), "[ab      |      cd|abc]");
+    EXPECT_EQ(logged("%s", none), "(null)");
+    EXPECT_EQ(logged("%d", "text"), "(?)");  // mismatched conversion does not read the string as a number
+}
+
+TEST(SpanLog, StringsAreCopiedWhenLogged)
+{
+    std::string buf = "first";
+    std::string out = logged("%s/", buf.c_str());
+    buf = "second";
+    out += logged("%s", buf.c_str());
+    EXPECT_EQ(out, "first/second");
+}
+
+TEST(SpanLog, LongStrings)
+{
+    std::string big(1500, 'x');
+    std::string clipped(1024, 'x');  // at most MAX_STRING characters are copied into a record
+
+    EXPECT_EQ(logged("<%s>", big.c_str()), "<" + clipped + ">");
+
+    std::string medium(200, 'y');  // longer than the 64-byte buffer used for a single conversion
+    EXPECT_EQ(logged("[%-210s]", medium.c_str()), expected("[%-210s]", medium.c_str()));
+}
+
+TEST(SpanLog, Pointers)
+{
+    int x;
+    void *p = &x;
+
+    EXPECT_EQ(logged("%p", p), expected("%p", p));
+    EXPECT_EQ(logged("%d", p), expected("%p", p));  // pointer with an integer conversion is printed as a pointer
+}
+
+TEST(SpanLog, PercentSignsAndMalformedConversions)
+{
+    EXPECT_EQ(logged("100%%"), "100%");
+    EXPECT_EQ(logged("%d%% done", 50), "50% done");
+    EXPECT_EQ(logged("a=%d b=%d", 1), "a=1 b=%d");  // missing argument is printed as is
+    EXPECT_EQ(logged("trailing %"), "trailing %");
+    EXPECT_EQ(logged("%d", 1, 2), "1");  // extra arguments are ignored
+}
+
+TEST(SpanLog, RawWrites)
+{
+    Serial.captured.clear();
+    Serial.capturing = true;
+    SpanLog::write("raw\0bytes", 9);
+    uint8_t bytes[] = {0x00, 0x7F, 0xA5, 0xFF};
+    SpanLog::hexWrite(bytes, sizeof(bytes));
+    SpanLog::flush();
+    Serial.capturing = false;
+
+    EXPECT_EQ(Serial.captured, std::string("raw\0bytes", 9) + "007FA5FF");
+}
+
+TEST(SpanLog, DeferredRecordsPrintInOrder)
+{
+    SpanLog::begin(4096);
+    Serial.captured.clear();
+    Serial.capturing = true;
+
+    hostRingbufHold(true);  // log task has not run yet
+    for (int i = 0; i < 20; i++)
+        SpanLog::printf("%d,", i);
+    SpanLog::print("done");
+    EXPECT_EQ(Serial.captured, "");
+
+    hostRingbufHold(false);
+    SpanLog::flush();
+    Serial.capturing = false;
+    EXPECT_EQ(Serial.captured, "0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,done");
+}
+
+TEST(SpanLog, RuntimeFormatIsCopiedWhenLogged)
+{
+    SpanLog::begin(4096);
+    Serial.captured.clear();
+    Serial.capturing = true;
+
+    hostRingbufHold(true);
+    {
+        std::string fmt = std::string("Characteristic %d.%d updated to %s") + " (built at runtime)\n";
+        SpanLog::printf(fmt.c_str(), 1, 10, "on");
+        fmt.assign(fmt.size(), '%');  // buffer is overwritten and then freed before the log task prints the record
+    }
+    std::string reuse(64, 'x');  // and its memory may be reused
+    hostRingbufHold(false);
+    SpanLog::flush();
+    Serial.capturing = false;
+
+    EXPECT_EQ(Serial.captured, "Characteristic 1.10 updated to on (built at runtime)\n");
+}
@@ -0,0 +1,176 @@
+// Utils::LoopHeap, which schedules the loop() calls of Services that set a loop period, run against a virtual
+// clock with 150 Accessories, plus a benchmark against scanning every Service on every poll
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <climits>
+#include <random>
+#include <vector>
+
+#include "Utils.h"
+
+namespace {
+
+struct service_t
+{
+    uint32_t loopPeriod;
+    unsigned long nextLoop;
+    std::vector<unsigned long> calls;  // times at which loop() was called
+};
+
+typedef std::vector<service_t *> heap_t;
+
+const int nAccessories = 150;
+
+// one Service per Accessory, with periods from 20 ms to about 5 seconds, all first due at time 'start'
+
+std::vector<service_t> makeServices(unsigned long start)
+{
+    std::mt19937 rng(150);
+    std::vector<service_t> services(nAccessories);
+    for (auto &s : services) {
+        s.loopPeriod = 20 + rng() % 5000;
+        s.nextLoop = start;
+    }
+    return (services);
+}
+
+heap_t makeHeap(std::vector<service_t> &services)
+{
+    heap_t heap;
+    for (auto &s : services)
+        heap.push_back(&s);
+    std::make_heap(heap.begin(), heap.end(), Utils::LoopHeap<service_t>::after);
+    return (heap);
+}
+
+// polls every 0-3 ms for 'duration' ms starting at 'start', and checks that the k-th call of every Service happened
+// no earlier than start+k*period and no later than one poll interval after that (so periods never drift)
+
+void runAndCheck(unsigned long start, unsigned long duration)
+{
+    auto services = makeServices(start);
+    auto heap = makeHeap(services);
+    std::mt19937 rng(1);
+
+    for (unsigned long t = start; (long)(t - start) < (long)duration; t += rng() % 4) {
+        Utils::LoopHeap<service_t>::runDue(heap, t, [t](service_t *s) {
+            s->calls.push_back(t);
+            return (true);
+        });
+    }
+
+    for (auto &s : services) {
+        ASSERT_EQ(s.calls.size(), (duration - 1) / s.loopPeriod + 1) << "period " << s.loopPeriod;
+        for (size_t k = 0; k < s.calls.size(); k++) {
+            long late = (long)(s.calls[k] - (start + k * s.loopPeriod));
+            EXPECT_GE(late, 0) << "period " << s.loopPeriod << " call " << k;
+            EXPECT_LE(late, 3) << "period " << s.loopPeriod << " call " << k;
+        }
+    }
+}
+
+}  // namespace
+
+TEST(LoopHeap, KeepsPeriods)
+{
+    runAndCheck(1000, 60000);
+}
+
+TEST(LoopHeap, KeepsPeriodsAcrossMillisWrap)
+{
+    runAndCheck(ULONG_MAX - 30000, 60000);
+}
+
+TEST(LoopHeap, CallsDueServicesInDeadlineOrder)
+{
+    auto services = makeServices(0);
+    for (size_t i = 0; i < services.size(); i++)
+        services[i].nextLoop = (i * 7919) % 1000;  // distinct deadlines in shuffled order
+    auto heap = makeHeap(services);
+
+    std::vector<unsigned long> due;
+    Utils::LoopHeap<service_t>::runDue(heap, 999, [&due](service_t *s) {
+        due.push_back(s->nextLoop);
+        return (true);
+    });
+
+    ASSERT_EQ(due.size(), services.size());
+    EXPECT_TRUE(std::is_sorted(due.begin(), due.end()));
+}
+
+TEST(LoopHeap, FallingBehindDoesNotBurst)
+{
+    service_t s = {10, 100, {}};
+    heap_t heap = {&s};
+    int n = 0;
+    auto run = [&n](service_t *) {
+        n++;
+        return (true);
+    };
+
+    Utils::LoopHeap<service_t>::runDue(heap, 155, run);  // five periods late - loop() is called once...
+    EXPECT_EQ(n, 1);
+    EXPECT_EQ(s.nextLoop, 165u);  // ...and rescheduled one period from now
+
+    Utils::LoopHeap<service_t>::runDue(heap, 164, run);
+    EXPECT_EQ(n, 1);
+    Utils::LoopHeap<service_t>::runDue(heap, 165, run);
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(s.nextLoop, 175u);
+}
+
+TEST(LoopHeap, StopsWhenRunReturnsFalse)
+{
+    auto services = makeServices(0);
+    auto heap = makeHeap(services);
+    int n = 0;
+
+    Utils::LoopHeap<service_t>::runDue(heap, 0, [&n](service_t *) {
+        n++;
+        return (false);  // as when loop() changes a loop period
+    });
+
+    EXPECT_EQ(n, 1);
+    EXPECT_TRUE(std::is_heap(heap.begin(), heap.end(), Utils::LoopHeap<service_t>::after));
+}
+
+// Cost of one poll with 150 periodic Services, when (as with sensors) almost none are due: popping only the due
+// Services from the heap, versus checking the deadline of every Service, as calling loop() on every poll and
+// throttling with millis() inside loop() amounts to.
+
+TEST(LoopHeap, Benchmark)
+{
+    const unsigned long duration = 600000;  // ten minutes of polls, one per millisecond
+
+    auto services = makeServices(0);
+    auto heap = makeHeap(services);
+    unsigned long nCalls = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned long t = 0; t < duration; t++) {
+        Utils::LoopHeap<service_t>::runDue(heap, t, [&nCalls](service_t *) {
+            nCalls++;
+            return (true);
+        });
+    }
+    double tHeap = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    services = makeServices(0);
+    unsigned long nScanned = 0;
+
+    t0 = std::chrono::steady_clock::now();
+    for (unsigned long t = 0; t < duration; t++) {
+        for (auto &s : services) {
+            if ((long)(t - s.nextLoop) >= 0) {
+                s.nextLoop += s.loopPeriod;
+                nScanned++;
+            }
+        }
+    }
+    double tScan = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    EXPECT_EQ(nCalls, nScanned);
+    printf("%d Services, %lu loop() calls in %lu polls:  heap %.1f ns/poll   scan %.1f ns/poll\n", nAccessories,
+           nCalls, duration, tHeap / duration, tScan / duration);
+}
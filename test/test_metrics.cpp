@@ -0,0 +1,145 @@
+// SpanMetrics, which times each HAP request by route and each call to pollTask() into fixed-bucket histograms and
+// serves them at <status-url>/metrics in Prometheus text format
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+#include "Metrics.h"
+
+namespace {
+
+typedef SpanMetrics M;
+
+std::string printed()
+{
+    std::ostringstream out;
+    M::print(out);
+    return (out.str());
+}
+
+bool contains(const std::string &s, const std::string &line)
+{
+    return (s.find(line + "\n") != std::string::npos);
+}
+
+class Metrics : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        for (auto &h : M::requests)
+            h = M::histogram_t();
+        M::pollTime = M::histogram_t();
+    }
+};
+
+}  // namespace
+
+TEST_F(Metrics, RouteOfEachHAPRequest)
+{
+    EXPECT_EQ(M::routeOf("POST /pair-setup HTTP/1.1\r\n"), M::PAIR_SETUP);
+    EXPECT_EQ(M::routeOf("POST /pair-verify HTTP/1.1\r\n"), M::PAIR_VERIFY);
+    EXPECT_EQ(M::routeOf("POST /pairings HTTP/1.1\r\n"), M::PAIRINGS);
+    EXPECT_EQ(M::routeOf("GET /accessories HTTP/1.1\r\n"), M::GET_ACCESSORIES);
+    EXPECT_EQ(M::routeOf("GET /characteristics?id=1.10,1.11&ev=1 HTTP/1.1\r\n"), M::GET_CHARACTERISTICS);
+    EXPECT_EQ(M::routeOf("PUT /characteristics HTTP/1.1\r\n"), M::PUT_CHARACTERISTICS);
+    EXPECT_EQ(M::routeOf("PUT /prepare HTTP/1.1\r\n"), M::PUT_PREPARE);
+}
+
+TEST_F(Metrics, RouteOfOtherRequests)
+{
+    EXPECT_EQ(M::routeOf("GET /status HTTP/1.1\r\n"), M::WEB);
+    EXPECT_EQ(M::routeOf("GET /status/metrics HTTP/1.1\r\n"), M::WEB);
+    EXPECT_EQ(M::routeOf("GET /accessoriesX HTTP/1.1\r\n"), M::WEB);  // prefix of a HAP path is not that route
+    EXPECT_EQ(M::routeOf("POST /pair-setupX HTTP/1.1\r\n"), M::OTHER);
+    EXPECT_EQ(M::routeOf("POST /identify HTTP/1.1\r\n"), M::OTHER);
+    EXPECT_EQ(M::routeOf("PUT /characteristics"), M::OTHER);  // truncated request line
+    EXPECT_EQ(M::routeOf(""), M::OTHER);
+}
+
+TEST_F(Metrics, BucketUpperBoundsAreInclusive)
+{
+    M::histogram_t h;
+    h.add(0);
+    h.add(250);     // first bucket: 0-250
+    h.add(251);     // second bucket: 251-500
+    h.add(500000);  // last bounded bucket
+    h.add(500001);  // unbounded bucket
+    h.add(UINT32_MAX);
+
+    uint32_t expected[M::NUM_BUCKETS] = {2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2};
+    for (int i = 0; i < M::NUM_BUCKETS; i++)
+        EXPECT_EQ(h.buckets[i], expected[i]) << "bucket " << i;
+    EXPECT_EQ(h.count, 6u);
+    EXPECT_EQ(h.sum, 0 + 250 + 251 + 500000 + 500001 + (uint64_t)UINT32_MAX);
+}
+
+TEST_F(Metrics, PercentileIsUpperBoundOfBucketHoldingRank)
+{
+    M::histogram_t h;
+    for (int i = 0; i < 50; i++)
+        h.add(100);  // ranks 1-50 in the 250 us bucket
+    for (int i = 0; i < 40; i++)
+        h.add(3000);  // ranks 51-90 in the 5000 us bucket
+    for (int i = 0; i < 9; i++)
+        h.add(40000);  // ranks 91-99 in the 50000 us bucket
+    h.add(2000000);    // rank 100 in the unbounded bucket
+
+    EXPECT_EQ(h.percentile(1), 250);
+    EXPECT_EQ(h.percentile(50), 250);
+    EXPECT_EQ(h.percentile(51), 5000);
+    EXPECT_EQ(h.percentile(90), 5000);
+    EXPECT_EQ(h.percentile(99), 50000);
+    EXPECT_TRUE(std::isinf(h.percentile(100)));
+}
+
+TEST_F(Metrics, PercentileRankRoundsUp)
+{
+    M::histogram_t h;
+    h.add(100);
+    h.add(100);
+    h.add(800);  // 3 samples: the median is the 2nd, the 90th percentile the 3rd
+
+    EXPECT_EQ(h.percentile(50), 250);
+    EXPECT_EQ(h.percentile(67), 1000);
+    EXPECT_EQ(h.percentile(90), 1000);
+}
+
+TEST_F(Metrics, PercentileOfEmptyHistogramIsNaN)
+{
+    M::histogram_t h;
+    EXPECT_TRUE(std::isnan(h.percentile(50)));
+    EXPECT_TRUE(std::isnan(h.percentile(99)));
+}
+
+TEST_F(Metrics, PrintsNaNQuantilesBeforeFirstPoll)
+{
+    std::string out = printed();
+    EXPECT_TRUE(contains(out, "homespan_poll_duration_microseconds{quantile=\"0.50\"} NaN"));
+    EXPECT_TRUE(contains(out, "homespan_poll_duration_microseconds{quantile=\"0.99\"} NaN"));
+    EXPECT_TRUE(contains(out, "homespan_poll_duration_microseconds_count 0"));
+    EXPECT_EQ(out.find("homespan_request_duration_microseconds_bucket"), std::string::npos);  // no requests yet
+}
+
+TEST_F(Metrics, PrintsQuantilesAndCumulativeBuckets)
+{
+    for (int i = 0; i < 98; i++)
+        M::pollTime.add(200);
+    M::pollTime.add(30000);
+    M::pollTime.add(900000);
+    M::requests[M::PUT_CHARACTERISTICS].add(1200);
+    M::requests[M::PUT_CHARACTERISTICS].add(7000);
+
+    std::string out = printed();
+    EXPECT_TRUE(contains(out, "homespan_poll_duration_microseconds{quantile=\"0.50\"} 250"));
+    EXPECT_TRUE(contains(out, "homespan_poll_duration_microseconds{quantile=\"0.99\"} 50000"));
+    EXPECT_TRUE(contains(out, "homespan_poll_duration_microseconds_count 100"));
+    std::string bucket = "homespan_request_duration_microseconds_bucket{route=\"put_characteristics\",le=";
+    EXPECT_TRUE(contains(out, bucket + "\"1000\"} 0"));
+    EXPECT_TRUE(contains(out, bucket + "\"2500\"} 1"));  // buckets are cumulative
+    EXPECT_TRUE(contains(out, bucket + "\"10000\"} 2"));
+    EXPECT_TRUE(contains(out, bucket + "\"+Inf\"} 2"));
+    EXPECT_TRUE(contains(out, "homespan_request_duration_microseconds_sum{route=\"put_characteristics\"} 8200"));
+}
@@ -0,0 +1,173 @@
+// Utils::PairVerifyPool, which checks out the Curve25519 temporaries each HAP connection needs between the two
+// pair-verify requests, with connections that hold the same members HAPClient does and make the same calls
+// HAPClient::acquireTemp() and HAPClient::releaseTemp() make
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "Utils.h"
+#include "hostmem.h"
+
+namespace {
+
+struct client_t
+{
+    static const int MAX_PAIR_VERIFY = 2;
+    static const uint32_t PAIR_VERIFY_TIMEOUT = 10000;
+
+    struct tempKeys_t  // same layout as HAPClient::tempKeys_t
+    {
+        uint8_t publicCurveKey[32];
+        uint8_t sharedCurveKey[32];
+        uint8_t sessionKey[32];
+        uint8_t iosCurveKey[32];
+        client_t *owner = NULL;
+        uint32_t startTime;
+    };
+
+    static tempKeys_t tempPool[MAX_PAIR_VERIFY];
+    static uint32_t tempFallbacks;
+
+    tempKeys_t *temp = NULL;
+
+    boolean acquireTemp() { return (Utils::PairVerifyPool<client_t>::acquire(this, millis())); }
+    void releaseTemp() { Utils::PairVerifyPool<client_t>::release(this); }
+
+    void startPairVerify()  // M1: acquires temporaries and fills them with keys
+    {
+        ASSERT_TRUE(acquireTemp());
+        memset(temp->sessionKey, 0x5A, sizeof(temp->sessionKey));
+    }
+
+    ~client_t() { releaseTemp(); }
+};
+
+client_t::tempKeys_t client_t::tempPool[MAX_PAIR_VERIFY];
+uint32_t client_t::tempFallbacks = 0;
+
+typedef Utils::PairVerifyPool<client_t> pool_t;
+
+bool wiped(const client_t::tempKeys_t &slot)
+{
+    const uint8_t *b = (const uint8_t *)&slot;
+    for (size_t i = 0; i < sizeof(slot); i++)
+        if (b[i])
+            return (false);
+    return (true);
+}
+
+class PairVerifyPool : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        hostMicros = 0;
+        client_t::tempFallbacks = 0;
+    }
+
+    void TearDown() override
+    {
+        EXPECT_EQ(pool_t::used(), 0);
+        EXPECT_EQ(hostMemLive(HS_MEM_CRYPTO), 0u);
+    }
+};
+
+}  // namespace
+
+TEST_F(PairVerifyPool, SlotsAreWipedAndReused)
+{
+    client_t a, b;
+
+    a.startPairVerify();
+    EXPECT_TRUE(pool_t::inPool(a.temp));
+    EXPECT_EQ(a.temp->owner, &a);
+    client_t::tempKeys_t *slot = a.temp;
+
+    a.releaseTemp();  // M4 complete
+    EXPECT_EQ(a.temp, nullptr);
+    EXPECT_TRUE(wiped(*slot));
+
+    b.startPairVerify();
+    EXPECT_EQ(b.temp, slot);  // first free slot is reused
+    EXPECT_EQ(pool_t::used(), 1);
+}
+
+TEST_F(PairVerifyPool, RestartKeepsSameTemporaries)
+{
+    client_t a;
+
+    a.startPairVerify();
+    client_t::tempKeys_t *slot = a.temp;
+    delay(9000);
+    a.startPairVerify();  // Controller restarts pair-verify on the same connection
+    EXPECT_EQ(a.temp, slot);
+    EXPECT_EQ(a.temp->startTime, 9000u);
+    EXPECT_EQ(pool_t::used(), 1);
+}
+
+TEST_F(PairVerifyPool, ReconnectStormFallsBackToHeap)
+{
+    std::vector<client_t> clients(16);  // MAX_CLIENT_SLOTS connections, all starting pair-verify at once
+
+    for (auto &c : clients)
+        c.startPairVerify();
+
+    EXPECT_EQ(pool_t::used(), 2);  // MAX_PAIR_VERIFY
+    EXPECT_EQ(client_t::tempFallbacks, 14u);
+    EXPECT_EQ(hostMemLive(HS_MEM_CRYPTO), 14 * sizeof(client_t::tempKeys_t));
+
+    for (size_t i = 0; i < clients.size(); i++) {  // every connection keeps its own temporaries
+        EXPECT_EQ(clients[i].temp->owner, &clients[i]);
+        for (size_t j = 0; j < i; j++)
+            EXPECT_NE(clients[i].temp, clients[j].temp);
+    }
+
+    for (auto &c : clients)
+        c.releaseTemp();
+    EXPECT_TRUE(wiped(client_t::tempPool[0]) && wiped(client_t::tempPool[1]));
+}
+
+TEST_F(PairVerifyPool, FreedSlotsAreUsedBeforeHeap)
+{
+    client_t a, b, c, d;
+
+    a.startPairVerify();
+    b.startPairVerify();
+    c.startPairVerify();  // pool is full
+    EXPECT_FALSE(pool_t::inPool(c.temp));
+
+    a.releaseTemp();
+    d.startPairVerify();
+    EXPECT_TRUE(pool_t::inPool(d.temp));
+    EXPECT_EQ(client_t::tempFallbacks, 1u);
+}
+
+TEST_F(PairVerifyPool, AbandonedSlotIsReclaimed)
+{
+    client_t a, b, c;
+
+    a.startPairVerify();
+    b.startPairVerify();
+    client_t::tempKeys_t *slot = a.temp;
+
+    delay(client_t::PAIR_VERIFY_TIMEOUT + 1);  // a's Controller never sent M3
+    b.startPairVerify();                       // b restarted, so its slot is not abandoned
+    c.startPairVerify();
+    EXPECT_EQ(c.temp, slot);
+    EXPECT_EQ(a.temp, nullptr);  // a must start over (and gets a fresh slot or heap temporaries if it does)
+    EXPECT_EQ(client_t::tempFallbacks, 0u);
+
+    a.startPairVerify();
+    EXPECT_FALSE(pool_t::inPool(a.temp));
+}
+
+TEST_F(PairVerifyPool, ClosingConnectionReleasesTemporaries)
+{
+    {
+        client_t a, b, c;
+        a.startPairVerify();
+        b.startPairVerify();
+        c.startPairVerify();
+        EXPECT_GT(hostMemLive(HS_MEM_CRYPTO), 0u);
+    }  // connections closed mid pair-verify; TearDown() checks that nothing is left
+}
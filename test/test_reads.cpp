@@ -0,0 +1,195 @@
+// Utils::ReadRefresh and Utils::TTLTimer, which limit how often a Characteristic's read callback refreshes its value,
+// driven by the virtual millis() clock through the same two paths Span uses: ReadRefresh::requested() for the entries
+// of a GET /characteristics query plan (every read) and ReadRefresh::subscribed() for the background refresh of
+// Span::ReadCallbacks in pollTask() (only while a Controller is subscribed)
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "Utils.h"
+
+namespace {
+
+// Characteristic with the members ReadRefresh uses; its read callback samples a slow sensor
+
+struct chr_t
+{
+    std::vector<int> evList;               // subscribed Controllers
+    void (*readCallback)(chr_t *) = NULL;  // as set by setReadCallback()
+    Utils::TTLTimer readTimer;
+    int samples = 0;                       // number of times the callback sampled the sensor
+
+    static void sample(chr_t *c) { c->samples++; }
+
+    chr_t(uint32_t ttl) { setReadCallback(ttl); }
+
+    void setReadCallback(uint32_t ttl)  // as in SpanCharacteristic::setReadCallback()
+    {
+        readCallback = sample;
+        readTimer.set(ttl);
+    }
+
+    void subscribe() { evList.push_back(1); }
+};
+
+typedef Utils::ReadRefresh<chr_t> refresh_t;
+
+struct entry_t  // stands in for SpanQueryPlan::item_t
+{
+    chr_t *characteristic;
+};
+
+chr_t *entryItem(const entry_t &e) { return (e.characteristic); }
+
+void get(chr_t &c)  // GET /characteristics of a single Characteristic, as in Span::checkReads(plan)
+{
+    std::vector<entry_t> plan = {{&c}};
+    refresh_t::requested(plan, entryItem, millis());
+}
+
+void poll(chr_t &c)  // background refresh in pollTask(), as in Span::checkReads()
+{
+    std::vector<chr_t *> readCallbacks = {&c};
+    refresh_t::subscribed(readCallbacks, millis());
+}
+
+void setMillis(uint32_t ms)
+{
+    hostMicros = (uint64_t)ms * 1000;
+}
+
+}  // namespace
+
+TEST(ReadCallback, RefreshesOnFirstReadThenOncePerTTL)
+{
+    setMillis(5000);
+    chr_t c(1000);
+
+    get(c);
+    EXPECT_EQ(c.samples, 1);
+    delay(999);
+    get(c);
+    EXPECT_EQ(c.samples, 1);  // still fresh
+    delay(1);
+    get(c);
+    EXPECT_EQ(c.samples, 2);  // expired after exactly one TTL
+}
+
+TEST(ReadCallback, BurstOfReadsSamplesOnce)
+{
+    setMillis(0);
+    chr_t c(2000);
+
+    for (int i = 0; i < 100; i++) {  // Home App opening a room issues many reads within a few hundred ms
+        get(c);
+        delay(5);
+    }
+    EXPECT_EQ(c.samples, 1);
+}
+
+TEST(ReadCallback, NoBackgroundRefreshWithoutSubscribers)
+{
+    setMillis(0);
+    chr_t c(100);
+
+    for (int i = 0; i < 10000; i++) {  // ten seconds of polls
+        poll(c);
+        delay(1);
+    }
+    EXPECT_EQ(c.samples, 0);
+
+    get(c);
+    EXPECT_EQ(c.samples, 1);
+}
+
+TEST(ReadCallback, SubscribedRefreshesOncePerTTLWhateverTheReads)
+{
+    setMillis(0);
+    chr_t c(1000);
+    c.subscribe();
+
+    for (int i = 0; i < 10000; i++) {  // ten seconds of polls, with a GET every 7 ms
+        poll(c);
+        if (i % 7 == 0)
+            get(c);
+        delay(1);
+    }
+    EXPECT_EQ(c.samples, 10);
+}
+
+TEST(ReadCallback, BackgroundRefreshOnlyForSubscribed)
+{
+    setMillis(0);
+    chr_t a(100), b(100), c(100);
+    b.subscribe();
+    c.subscribe();
+    c.subscribe();  // two Controllers
+    std::vector<chr_t *> readCallbacks = {&a, &b, &c};
+
+    for (int i = 0; i < 1000; i++) {
+        refresh_t::subscribed(readCallbacks, millis());
+        delay(1);
+    }
+    EXPECT_EQ(a.samples, 0);
+    EXPECT_EQ(b.samples, 10);
+    EXPECT_EQ(c.samples, 10);
+
+    c.evList.clear();  // last Controller unsubscribes
+    for (int i = 0; i < 1000; i++) {
+        refresh_t::subscribed(readCallbacks, millis());
+        delay(1);
+    }
+    EXPECT_EQ(b.samples, 20);
+    EXPECT_EQ(c.samples, 10);
+}
+
+TEST(ReadCallback, RequestSkipsUnresolvedAndCallbackFreeEntries)
+{
+    setMillis(0);
+    chr_t a(0), b(0);
+    b.readCallback = NULL;  // Characteristic in plan without a read callback
+    std::vector<entry_t> plan = {{&a}, {NULL}, {&b}, {&a}};  // NULL is an id that did not resolve
+
+    refresh_t::requested(plan, entryItem, millis());
+    EXPECT_EQ(a.samples, 2);  // listed twice, with a zero TTL
+    EXPECT_EQ(b.samples, 0);
+}
+
+TEST(ReadCallback, ZeroTTLRefreshesOnEveryRead)
+{
+    setMillis(0);
+    chr_t c(0);
+
+    for (int i = 0; i < 5; i++)
+        get(c);
+    EXPECT_EQ(c.samples, 5);
+}
+
+TEST(ReadCallback, SettingCallbackForcesRefresh)
+{
+    setMillis(0);
+    chr_t c(60000);
+
+    get(c);
+    delay(10);
+    get(c);
+    EXPECT_EQ(c.samples, 1);
+
+    c.setReadCallback(60000);
+    get(c);
+    EXPECT_EQ(c.samples, 2);
+}
+
+TEST(ReadCallback, TTLHoldsAcrossMillisWrap)
+{
+    setMillis(UINT32_MAX - 400);  // millis() wraps after about 49.7 days
+    chr_t c(1000);
+
+    get(c);
+    delay(500);  // millis() has wrapped to 99
+    get(c);
+    EXPECT_EQ(c.samples, 1);
+    delay(500);
+    get(c);
+    EXPECT_EQ(c.samples, 2);
+}
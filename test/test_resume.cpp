@@ -0,0 +1,415 @@
+// Pair-resume (HAP Section 7.3.6) through the firmware's PairResume session cache: expiry, single use, eviction of
+// the oldest session, falling back to a full pair-verify, and wiping the sessions of a removed Controller, plus the
+// reconnect latency of a pair-resume against a full pair-verify.
+//
+// HAPClient itself needs the ESP32 networking stack and is not built on the host, so the full pair-verify is replayed
+// from the accessory's steps in postPairVerifyURL(), with OpenSSL standing in for the Curve25519 and Ed25519
+// operations that the firmware takes from libsodium.  The pair-resume side is the firmware's own PairResume::resume(),
+// with HKDF from HKDF.cpp and ChaCha20-Poly1305 from the OpenSSL-backed sodium stub.  The controller's side of each
+// exchange is computed independently, so the tests also check that both ends agree on the resulting Control keys.
+
+#include <gtest/gtest.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <sodium.h>
+#include <chrono>
+#include <vector>
+
+#include "HKDF.h"
+#include "Resume.h"
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+bytes rnd(size_t n)
+{
+    bytes b(n);
+    RAND_bytes(b.data(), n);
+    return (b);
+}
+
+bytes cat(std::initializer_list<bytes> parts)
+{
+    bytes r;
+    for (auto &p : parts)
+        r.insert(r.end(), p.begin(), p.end());
+    return (r);
+}
+
+struct Key
+{
+    EVP_PKEY *pkey = NULL;
+    Key(int type) { pkey = EVP_PKEY_Q_keygen(NULL, NULL, type == EVP_PKEY_X25519 ? "X25519" : "ED25519"); }
+    Key(int type, const bytes &pub) { pkey = EVP_PKEY_new_raw_public_key(type, NULL, pub.data(), pub.size()); }
+    ~Key() { EVP_PKEY_free(pkey); }
+    bytes pub() const
+    {
+        bytes b(32);
+        size_t len = 32;
+        EVP_PKEY_get_raw_public_key(pkey, b.data(), &len);
+        return (b);
+    }
+};
+
+bytes x25519(const Key &mine, const Key &theirs)
+{
+    bytes shared(32);
+    size_t len = 32;
+    EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new(mine.pkey, NULL);
+    EVP_PKEY_derive_init(ctx);
+    EVP_PKEY_derive_set_peer(ctx, theirs.pkey);
+    EVP_PKEY_derive(ctx, shared.data(), &len);
+    EVP_PKEY_CTX_free(ctx);
+    return (shared);
+}
+
+bytes sign(const Key &k, const bytes &msg)
+{
+    bytes sig(64);
+    size_t len = 64;
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_DigestSignInit(ctx, NULL, NULL, NULL, k.pkey);
+    EVP_DigestSign(ctx, sig.data(), &len, msg.data(), msg.size());
+    EVP_MD_CTX_free(ctx);
+    return (sig);
+}
+
+bool verify(const Key &k, const bytes &msg, const bytes &sig)
+{
+    EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+    EVP_DigestVerifyInit(ctx, NULL, NULL, NULL, k.pkey);
+    bool ok = EVP_DigestVerify(ctx, sig.data(), sig.size(), msg.data(), msg.size()) == 1;
+    EVP_MD_CTX_free(ctx);
+    return (ok);
+}
+
+// ChaCha20-Poly1305 (IETF) with HAP's 4 zero bytes + 8-byte nonce; encrypt appends the 16-byte tag
+
+bytes seal(const uint8_t *key, const char *nonce, const bytes &plain)
+{
+    bytes out(plain.size() + 16);
+    int len;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key, (const uint8_t *)nonce);
+    EVP_EncryptUpdate(ctx, out.data(), &len, plain.data(), plain.size());
+    EVP_EncryptFinal_ex(ctx, out.data() + len, &len);
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, 16, out.data() + plain.size());
+    EVP_CIPHER_CTX_free(ctx);
+    return (out);
+}
+
+bool open(const uint8_t *key, const char *nonce, const bytes &sealed, bytes &plain)
+{
+    plain.resize(sealed.size() - 16);
+    int len;
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_DecryptInit_ex(ctx, EVP_chacha20_poly1305(), NULL, key, (const uint8_t *)nonce);
+    EVP_DecryptUpdate(ctx, plain.data(), &len, sealed.data(), plain.size());
+    EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, 16, (void *)(sealed.data() + plain.size()));
+    bool ok = EVP_DecryptFinal_ex(ctx, plain.data() + len, &len) == 1;
+    EVP_CIPHER_CTX_free(ctx);
+    return (ok);
+}
+
+const char PV2[] = "\x00\x00\x00\x00PV-Msg02", PV3[] = "\x00\x00\x00\x00PV-Msg03";
+const char PR1[] = "\x00\x00\x00\x00PR-Msg01", PR2[] = "\x00\x00\x00\x00PR-Msg02";
+
+struct Pairing
+{
+    Key accessoryLTK{EVP_PKEY_ED25519};
+    Key controllerLTK{EVP_PKEY_ED25519};
+    bytes accessoryID = rnd(17), controllerID = rnd(36);
+};
+
+struct Session
+{
+    bytes sharedSecret, sessionID, a2cKey, c2aKey;
+};
+
+double elapsed(std::chrono::steady_clock::time_point t0)
+{
+    return (std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+}
+
+void controlKeys(const bytes &secret, Session &s)
+{
+    s.a2cKey.resize(32);
+    s.c2aKey.resize(32);
+    HKDF::createPair(s.a2cKey.data(), "Control-Read-Encryption-Key", s.c2aKey.data(), "Control-Write-Encryption-Key",
+                     (uint8_t *)secret.data(), 32, "Control-Salt");
+}
+
+// full pair-verify M1-M4; returns accessory-side time in microseconds
+
+double fullVerify(const Pairing &p, Session &acc, Session &ios)
+{
+    Key iosCurve(EVP_PKEY_X25519);
+    Key accCurve(EVP_PKEY_X25519);  // taken from the pool filled by preGenerateKeys(), so not timed
+    double t = 0;
+
+    // M1 -> M2 (accessory)
+
+    auto t0 = std::chrono::steady_clock::now();
+    Key iosCurvePub(EVP_PKEY_X25519, iosCurve.pub());
+    bytes sig = sign(p.accessoryLTK, cat({accCurve.pub(), p.accessoryID, iosCurve.pub()}));
+    bytes shared = x25519(accCurve, iosCurvePub);
+    uint8_t sessionKey[32];
+    HKDF::create(sessionKey, shared.data(), 32, "Pair-Verify-Encrypt-Salt", "Pair-Verify-Encrypt-Info");
+    bytes m2 = seal(sessionKey, PV2, cat({p.accessoryID, sig}));
+    t += elapsed(t0);
+
+    // M2 -> M3 (controller)
+
+    Key accCurvePub(EVP_PKEY_X25519, accCurve.pub());
+    bytes iosShared = x25519(iosCurve, accCurvePub);
+    uint8_t iosSessionKey[32];
+    HKDF::create(iosSessionKey, iosShared.data(), 32, "Pair-Verify-Encrypt-Salt", "Pair-Verify-Encrypt-Info");
+    bytes plain;
+    EXPECT_TRUE(open(iosSessionKey, PV2, m2, plain));
+    bytes m3Sig = sign(p.controllerLTK, cat({iosCurve.pub(), p.controllerID, accCurve.pub()}));
+    bytes m3 = seal(iosSessionKey, PV3, cat({p.controllerID, m3Sig}));
+
+    // M3 -> M4 (accessory)
+
+    t0 = std::chrono::steady_clock::now();
+    EXPECT_TRUE(open(sessionKey, PV3, m3, plain));
+    bytes iosSig(plain.end() - 64, plain.end());
+    EXPECT_TRUE(verify(p.controllerLTK, cat({iosCurve.pub(), p.controllerID, accCurve.pub()}), iosSig));
+    controlKeys(shared, acc);
+    acc.sharedSecret = shared;
+    acc.sessionID.resize(32);
+    HKDF::create(acc.sessionID.data(), shared.data(), 32, "Pair-Verify-ResumeSessionID-Salt",
+                 "Pair-Verify-ResumeSessionID-Info");
+    acc.sessionID.resize(8);
+    t += elapsed(t0);
+
+    ios.sharedSecret = iosShared;
+    ios.sessionID = acc.sessionID;
+    controlKeys(iosShared, ios);
+    return (t);
+}
+
+
+// controller side of pair-resume M1: the Authentication Tag of empty data, keyed from the cached Shared-Secret
+
+struct Request
+{
+    Key iosCurve{EVP_PKEY_X25519};
+    bytes tag;
+
+    Request(const Session &ios)
+    {
+        bytes salt = cat({iosCurve.pub(), ios.sessionID});
+        uint8_t requestKey[32];
+        HKDF::create(requestKey, (uint8_t *)ios.sharedSecret.data(), 32, salt.data(), salt.size(),
+                     "Pair-Resume-Request-Info");
+        tag = seal(requestKey, PR1, bytes());
+    }
+};
+
+// accessory side of pair-resume M1 -> M2, as in HAPClient::pairResume() - returns false if the firmware falls back to
+// a full pair-verify
+
+bool accessoryResume(const Request &req, const bytes &sessionID, const bytes &tag, bytes &newID, bytes &responseTag,
+                     Session &acc)
+{
+    PairResume::session_t *session = PairResume::find(sessionID.data());
+    if (!session)
+        return (false);
+
+    bytes iosKey = req.iosCurve.pub();
+    newID.resize(hap_session_IDBYTES);
+    responseTag.resize(crypto_aead_chacha20poly1305_IETF_ABYTES);
+    acc.sharedSecret.resize(32);
+
+    if (!PairResume::resume(session, iosKey.data(), tag.data(), tag.size(), newID.data(), responseTag.data(),
+                            acc.sharedSecret.data()))
+        return (false);
+
+    acc.sessionID = newID;
+    controlKeys(acc.sharedSecret, acc);
+    return (true);
+}
+
+// controller side of pair-resume M2: checks the accessory's Authentication Tag and derives the new session
+
+void controllerResume(const Request &req, const bytes &newID, const bytes &responseTag, Session &ios)
+{
+    bytes salt = cat({req.iosCurve.pub(), newID});
+    uint8_t responseKey[32];
+    HKDF::create(responseKey, ios.sharedSecret.data(), 32, salt.data(), salt.size(), "Pair-Resume-Response-Info");
+    bytes plain;
+    EXPECT_TRUE(open(responseKey, PR2, responseTag, plain));
+    bytes secret(32);
+    HKDF::create(secret.data(), ios.sharedSecret.data(), 32, salt.data(), salt.size(),
+                 "Pair-Resume-Shared-Secret-Info");
+    ios.sharedSecret = secret;
+    ios.sessionID = newID;
+    controlKeys(secret, ios);
+}
+
+// full pair-verify followed by caching the verified session, as at the end of postPairVerifyURL()
+
+double verifyAndCache(const Pairing &p, Session &acc, Session &ios)
+{
+    double t = fullVerify(p, acc, ios);
+    PairResume::save(acc.sessionID.data(), acc.sharedSecret.data(), p.controllerID.data());
+    return (t);
+}
+
+bool resumes(const Session &ios)  // true if the firmware accepts a correct pair-resume request for ios.sessionID
+{
+    Request req(ios);
+    bytes newID, responseTag;
+    Session acc;
+    return (accessoryResume(req, ios.sessionID, req.tag, newID, responseTag, acc));
+}
+
+class PairResumeTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        PairResume::clear(NULL);
+        hostMicros = 1000000000;
+    }
+};
+
+}  // namespace
+
+TEST_F(PairResumeTest, KeysAgree)
+{
+    Pairing p;
+    Session acc, ios;
+
+    verifyAndCache(p, acc, ios);
+    EXPECT_EQ(acc.a2cKey, ios.a2cKey);
+    EXPECT_EQ(acc.c2aKey, ios.c2aKey);
+
+    for (int i = 0; i < 3; i++) {  // each resume caches a new session ID that can be resumed again
+        bytes oldKey = acc.a2cKey;
+        Request req(ios);
+        bytes newID, responseTag;
+        ASSERT_TRUE(accessoryResume(req, ios.sessionID, req.tag, newID, responseTag, acc));
+        EXPECT_NE(newID, ios.sessionID);
+        controllerResume(req, newID, responseTag, ios);
+        EXPECT_EQ(acc.a2cKey, ios.a2cKey);
+        EXPECT_EQ(acc.c2aKey, ios.c2aKey);
+        EXPECT_NE(acc.a2cKey, oldKey);
+    }
+}
+
+TEST_F(PairResumeTest, SessionCanOnlyBeResumedOnce)
+{
+    Pairing p;
+    Session acc, ios;
+    verifyAndCache(p, acc, ios);
+
+    Request req(ios);
+    bytes newID, responseTag;
+    ASSERT_TRUE(accessoryResume(req, ios.sessionID, req.tag, newID, responseTag, acc));
+    EXPECT_EQ(PairResume::find(ios.sessionID.data()), nullptr);
+    EXPECT_FALSE(accessoryResume(req, ios.sessionID, req.tag, newID, responseTag, acc));  // replayed M1
+    EXPECT_NE(PairResume::find(newID.data()), nullptr);
+}
+
+TEST_F(PairResumeTest, ExpiredSessionFallsBackToVerify)
+{
+    Pairing p;
+    Session acc, ios;
+    verifyAndCache(p, acc, ios);
+
+    delay(PairResume::SESSION_LIFE);
+    EXPECT_NE(PairResume::find(ios.sessionID.data()), nullptr);  // still valid for exactly SESSION_LIFE ms
+    delay(1);
+    EXPECT_FALSE(resumes(ios));
+}
+
+TEST_F(PairResumeTest, BadRequestFallsBackAndKeepsSession)
+{
+    Pairing p;
+    Session acc, ios;
+    verifyAndCache(p, acc, ios);
+
+    Request req(ios);
+    bytes newID, responseTag;
+
+    bytes badTag = req.tag;
+    badTag[0] ^= 1;
+    EXPECT_FALSE(accessoryResume(req, ios.sessionID, badTag, newID, responseTag, acc));
+
+    bytes shortTag(req.tag.begin(), req.tag.end() - 1);
+    EXPECT_FALSE(accessoryResume(req, ios.sessionID, shortTag, newID, responseTag, acc));
+
+    Request other(ios);  // tag computed for a different Curve25519 key than the one sent
+    EXPECT_FALSE(accessoryResume(req, ios.sessionID, other.tag, newID, responseTag, acc));
+
+    Session stranger = ios;  // controller that does not know the Shared-Secret
+    stranger.sharedSecret = rnd(32);
+    Request forged(stranger);
+    EXPECT_FALSE(accessoryResume(forged, ios.sessionID, forged.tag, newID, responseTag, acc));
+
+    EXPECT_TRUE(resumes(ios));  // failed attempts leave the session in the cache
+}
+
+TEST_F(PairResumeTest, OldestSessionIsReplacedWhenFull)
+{
+    Pairing p;
+    std::vector<Session> ios(PairResume::MAX_SESSIONS + 1);
+
+    for (auto &s : ios) {
+        Session acc;
+        verifyAndCache(p, acc, s);
+        delay(1000);
+    }
+
+    EXPECT_EQ(PairResume::find(ios[0].sessionID.data()), nullptr);
+    for (size_t i = 1; i < ios.size(); i++)
+        EXPECT_TRUE(resumes(ios[i])) << "session " << i;
+}
+
+TEST_F(PairResumeTest, RemovingControllerWipesOnlyItsSessions)
+{
+    Pairing alice, bob;
+    Session acc, iosAlice1, iosAlice2, iosBob;
+    verifyAndCache(alice, acc, iosAlice1);
+    verifyAndCache(alice, acc, iosAlice2);
+    verifyAndCache(bob, acc, iosBob);
+
+    PairResume::clear(alice.controllerID.data());  // as in HAPClient::tearDown()
+    EXPECT_FALSE(resumes(iosAlice1));
+    EXPECT_FALSE(resumes(iosAlice2));
+    EXPECT_NE(PairResume::find(iosBob.sessionID.data()), nullptr);
+
+    PairResume::clear(NULL);  // as when all pairings are removed
+    EXPECT_FALSE(resumes(iosBob));
+}
+
+// Accessory-side time of a reconnect.  The pair-verify side is the replay above (with OpenSSL for the Curve25519 and
+// Ed25519 steps), so the comparison shows the cost the firmware avoids, not the exact ESP32 timings.
+
+TEST_F(PairResumeTest, ReconnectLatency)
+{
+    const int nReconnects = 200;
+    Pairing p;
+    Session acc, ios;
+    double tVerify = 0, tResume = 0;
+
+    for (int i = 0; i < nReconnects; i++)
+        tVerify += verifyAndCache(p, acc, ios);
+
+    for (int i = 0; i < nReconnects; i++) {
+        Request req(ios);
+        bytes newID, responseTag;
+        auto t0 = std::chrono::steady_clock::now();
+        ASSERT_TRUE(accessoryResume(req, ios.sessionID, req.tag, newID, responseTag, acc));
+        tResume += elapsed(t0);
+        controllerResume(req, newID, responseTag, ios);
+        ASSERT_EQ(acc.a2cKey, ios.a2cKey);
+    }
+
+    printf("full pair-verify  %8.1f us/reconnect\n", tVerify / nReconnects);
+    printf("pair-resume       %8.1f us/reconnect\n", tResume / nReconnects);
+    EXPECT_LT(tResume, tVerify);
+}
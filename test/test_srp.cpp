@@ -0,0 +1,247 @@
+// SRP-6A (RFC 5054 3072-bit group, SHA-512 as specified by HAP) checked against an independent client-side
+// computation, plus a microbenchmark of the server-side steps.
+//
+// RFC 5054 Appendix B only publishes vectors for the 1024-bit group with SHA-1, so its salt and private keys are
+// re-used here as inputs and the expected values are computed directly from the RFC 5054 formulas with OpenSSL.
+
+#include <gtest/gtest.h>
+#include <openssl/bn.h>
+#include <openssl/sha.h>
+#include <chrono>
+#include <vector>
+
+#include <sodium.h>
+#include <functional>
+
+#include "SRP.h"
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+const char *setupCode = "46637726";  // P = "466-37-726"
+
+bytes hex(const char *s)
+{
+    bytes b(strlen(s) / 2);
+    for (size_t i = 0; i < b.size(); i++)
+        sscanf(s + 2 * i, "%2hhx", &b[i]);
+    return (b);
+}
+
+const bytes rfcSalt = hex("BEB25379D1A8581EB5A727673A2441EE");
+const bytes rfcA = hex("60975527035CF2AD1989806F0407210BC81EDC04E2762A56AFD529DDDA2D4393");
+const bytes rfcB = hex("E487CB59D31AC550471E81F00F6928E01DDA08E974A004F49E61F5D105284D20");
+
+struct Bn
+{
+    BIGNUM *bn = BN_new();
+    Bn() {}
+    Bn(const bytes &b) { BN_bin2bn(b.data(), b.size(), bn); }
+    ~Bn() { BN_free(bn); }
+    bytes pad(size_t len = 384) const
+    {
+        bytes b(len);
+        BN_bn2binpad(bn, b.data(), len);
+        return (b);
+    }
+    bytes raw() const
+    {
+        bytes b(BN_num_bytes(bn));
+        BN_bn2bin(bn, b.data());
+        return (b);
+    }
+};
+
+bytes sha512(const bytes &b)
+{
+    bytes h(64);
+    SHA512(b.data(), b.size(), h.data());
+    return (h);
+}
+
+bytes cat(std::initializer_list<bytes> parts)
+{
+    bytes r;
+    for (auto &p : parts)
+        r.insert(r.end(), p.begin(), p.end());
+    return (r);
+}
+
+bytes str(const char *s) { return (bytes(s, s + strlen(s))); }
+
+// independent client side of the exchange
+
+struct Client
+{
+    BN_CTX *ctx = BN_CTX_new();
+    Bn N, g, k, x, a, A;
+
+    Client(const bytes &salt, const bytes &aPriv)
+    {
+        BN_hex2bn(&N.bn, SRP6A::N3072);
+        BN_set_word(g.bn, 5);
+        bytes kHash = sha512(cat({N.pad(), g.pad()}));
+        BN_bin2bn(kHash.data(), 64, k.bn);
+        bytes xHash = sha512(cat({salt, sha512(str("Pair-Setup:466-37-726"))}));
+        BN_bin2bn(xHash.data(), 64, x.bn);
+        BN_bin2bn(aPriv.data(), aPriv.size(), a.bn);
+        BN_mod_exp(A.bn, g.bn, a.bn, N.bn, ctx);
+    }
+
+    ~Client() { BN_CTX_free(ctx); }
+
+    bytes verifier()
+    {
+        Bn v;
+        BN_mod_exp(v.bn, g.bn, x.bn, N.bn, ctx);
+        return (v.pad());
+    }
+
+    // K = H(PAD((B - k*g^x) ^ (a + u*x) %N))
+
+    bytes sessionKey(const bytes &B)
+    {
+        Bn Bb(B), u(sha512(cat({A.pad(), Bb.pad()}))), gx, kgx, base, ux, e, S;
+        BN_mod_exp(gx.bn, g.bn, x.bn, N.bn, ctx);
+        BN_mod_mul(kgx.bn, k.bn, gx.bn, N.bn, ctx);
+        BN_mod_sub(base.bn, Bb.bn, kgx.bn, N.bn, ctx);
+        BN_mul(ux.bn, u.bn, x.bn, ctx);
+        BN_add(e.bn, a.bn, ux.bn);
+        BN_mod_exp(S.bn, base.bn, e.bn, N.bn, ctx);
+        return (sha512(S.pad()));
+    }
+
+    // M1 = H(H(N) xor H(g) | H(I) | s | A | B | K)
+
+    bytes proof(const bytes &salt, const bytes &B, const bytes &K)
+    {
+        bytes hN = sha512(N.raw()), hg = sha512(g.raw());
+        for (int i = 0; i < 64; i++)
+            hN[i] ^= hg[i];
+        return (sha512(cat({hN, sha512(str("Pair-Setup")), salt, A.raw(), Bn(B).raw(), K})));
+    }
+};
+
+}  // namespace
+
+TEST(SRP, GroupConstants)
+{
+    SRP6A srp;
+    Client client(rfcSalt, rfcA);
+
+    EXPECT_EQ(BN_num_bits(SRP6A::N.bn), 3072);
+    EXPECT_EQ(BN_cmp(SRP6A::g.bn, client.g.bn), 0);
+    EXPECT_EQ(BN_cmp(SRP6A::k.bn, client.k.bn), 0);
+    EXPECT_FALSE(BN_is_zero(SRP6A::_rr.bn));  // Montgomery helper computed once in loadGroup()
+
+    bytes hN = sha512(client.N.raw()), hg = sha512(bytes{5});
+    for (int i = 0; i < 64; i++)
+        hN[i] ^= hg[i];
+    EXPECT_EQ(bytes(SRP6A::hNgI, SRP6A::hNgI + 64), hN);
+    EXPECT_EQ(bytes(SRP6A::hNgI + 64, SRP6A::hNgI + 128), sha512(str("Pair-Setup")));
+}
+
+TEST(SRP, GroupSharedAcrossInstances)
+{
+    SRP6A srp1;
+    BIGNUM *k = SRP6A::k.bn;
+    SRP6A srp2;
+    EXPECT_TRUE(SRP6A::groupLoaded);
+    EXPECT_EQ(SRP6A::k.bn, k);  // second instance did not recompute the group constants
+}
+
+TEST(SRP, VerifyCode)
+{
+    SRP6A srp;
+    Verification vData;
+    Client client(rfcSalt, rfcA);
+
+    hostQueueRandom(rfcSalt.data(), rfcSalt.size());
+    srp.createVerifyCode(setupCode, &vData);
+
+    EXPECT_EQ(bytes(vData.salt, vData.salt + 16), rfcSalt);
+    EXPECT_EQ(bytes(vData.verifyCode, vData.verifyCode + 384), client.verifier());
+}
+
+TEST(SRP, FullExchange)
+{
+    Verification vData;
+    Client client(rfcSalt, rfcA);
+
+    {
+        SRP6A setup;
+        hostQueueRandom(rfcSalt.data(), rfcSalt.size());
+        setup.createVerifyCode(setupCode, &vData);
+    }
+
+    SRP6A srp;
+    bytes B(384), accProof(64);
+
+    hostQueueRandom(rfcB.data(), rfcB.size());
+    srp.createPublicKey(&vData, B.data());
+
+    bytes A = client.A.pad();
+    srp.createSessionKey(A.data(), A.size());
+
+    bytes K = client.sessionKey(B);
+    EXPECT_EQ(bytes(srp.K, srp.K + 64), K);
+
+    bytes M1 = client.proof(rfcSalt, B, K);
+    EXPECT_EQ(srp.verifyClientProof(M1.data()), 1);
+
+    srp.createAccProof(accProof.data());
+    EXPECT_EQ(accProof, sha512(cat({A, M1, K})));
+
+    M1[10] ^= 1;
+    EXPECT_EQ(srp.verifyClientProof(M1.data()), 0);
+}
+
+TEST(SRP, WrongSetupCodeFails)
+{
+    Verification vData;
+    Client client(rfcSalt, rfcA);
+
+    {
+        SRP6A setup;
+        hostQueueRandom(rfcSalt.data(), rfcSalt.size());
+        setup.createVerifyCode("12345678", &vData);
+    }
+
+    SRP6A srp;
+    bytes B(384);
+    srp.createPublicKey(&vData, B.data());
+    bytes A = client.A.pad();
+    srp.createSessionKey(A.data(), A.size());
+
+    bytes K = client.sessionKey(B);
+    EXPECT_NE(bytes(srp.K, srp.K + 64), K);
+    EXPECT_EQ(srp.verifyClientProof(client.proof(rfcSalt, B, K).data()), 0);
+}
+
+// Times each server-side step of pair-setup.  Host timings only show relative costs - on an ESP32-C3 createKeys()
+// (M2) and createSessionKey() (M4) each take several hundred milliseconds.
+
+TEST(SRP, Benchmark)
+{
+    const int nIter = 20;
+    Verification vData;
+    Client client(rfcSalt, rfcA);
+    bytes B(384), A = client.A.pad();
+
+    auto time = [&](const char *label, std::function<void(SRP6A &)> step) {
+        SRP6A srp;
+        srp.createKeys(&vData);
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < nIter; i++)
+            step(srp);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+        printf("%-20s %10.1f us/op\n", label, us / nIter);
+    };
+
+    time("loadGroup (cached)", [](SRP6A &) { SRP6A::loadGroup(); });
+    time("createVerifyCode", [&](SRP6A &srp) { srp.createVerifyCode(setupCode, &vData); });
+    time("createKeys (M2)", [&](SRP6A &srp) { srp.createKeys(&vData); });
+    time("createSessionKey (M4)", [&](SRP6A &srp) { srp.createSessionKey(A.data(), A.size()); });
+    time("verifyClientProof", [&](SRP6A &srp) { srp.verifyClientProof(srp.M1); });
+}
@@ -0,0 +1,327 @@
+// TLV8View (the in-place parser for incoming pairing messages) and TLV8Writer (the arena-backed builder for outgoing
+// responses) checked against TLV8, the original list-based implementation, plus a benchmark of response building
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "TLV8.h"
+
+namespace {
+
+typedef std::vector<uint8_t> bytes;
+
+struct record_t
+{
+    uint8_t tag;
+    bytes val;
+};
+
+// packs records with TLV8 (which splits values longer than 255 bytes into fragments)
+
+bytes packReference(const std::vector<record_t> &records)
+{
+    TLV8 tlv;
+    for (auto &r : records) {
+        if (!tlv.empty() && tlv.back().getTag() == r.tag)
+            tlv.add(0xFF);  // separator, so consecutive records with the same tag are not merged by TLV8::add()
+        tlv.add(r.tag, r.val.size(), r.val.data());
+    }
+    bytes buf(tlv.pack_size());
+    tlv.pack(buf.data());
+    return (buf);
+}
+
+// compares every tag found by TLV8View with the same tag found by TLV8 unpacking a copy of the same buffer
+
+void expectSameAsReference(const bytes &buf)
+{
+    TLV8 ref;
+    bytes refBuf = buf, viewBuf = buf;
+    boolean refOK = buf.size() > 0 && ref.unpack(refBuf.data(), refBuf.size()) == 0;
+
+    TLV8View view;
+    int viewStatus = view.unpack(viewBuf.data(), viewBuf.size());
+
+    if (buf.size() > 0 && !refOK) {  // TLV8 reports a truncated buffer by returning a non-zero unpack phase
+        EXPECT_EQ(viewStatus, -1);
+        return;
+    }
+
+    if (viewStatus == -1) {  // only allowed when there are more records than the view can index
+        EXPECT_GT(ref.size(), 16u);
+        return;
+    }
+
+    for (int tag = 0; tag < 256; tag++) {
+        auto itRef = ref.find(tag);
+        auto itView = view.find(tag);
+        ASSERT_EQ(view.len(itView), ref.len(itRef)) << "tag " << tag;
+        if (itView) {
+            EXPECT_EQ(bytes(itView->get(), itView->get() + itView->getLen()),
+                      bytes(itRef->get(), itRef->get() + itRef->getLen()))
+                << "tag " << tag;
+        }
+    }
+}
+
+bytes pattern(size_t len, uint8_t seed)
+{
+    bytes b(len);
+    for (size_t i = 0; i < len; i++)
+        b[i] = (uint8_t)(seed + i * 7);
+    return (b);
+}
+
+}  // namespace
+
+TEST(TLV8View, PairSetupMessage)
+{
+    bytes buf = packReference({{6, {3}}, {3, pattern(384, 1)}, {4, pattern(64, 2)}});  // State, PublicKey, Proof
+    TLV8View view;
+
+    ASSERT_EQ(view.unpack(buf.data(), buf.size()), 0);
+    EXPECT_EQ(view.size(), 3);
+    EXPECT_EQ(view.find(6)->getVal(), 3u);
+    EXPECT_EQ(view.len(view.find(3)), 384);
+    EXPECT_EQ(bytes(view.find(3)->get(), view.find(3)->get() + 384), pattern(384, 1));
+    EXPECT_EQ(bytes(view.find(4)->get(), view.find(4)->get() + 64), pattern(64, 2));
+    EXPECT_EQ(view.find(9), view.end());
+    EXPECT_EQ(view.len(view.find(9)), -1);
+}
+
+TEST(TLV8View, FragmentedValues)
+{
+    for (size_t len : {254, 255, 256, 510, 511, 765, 1000}) {
+        expectSameAsReference(packReference({{1, pattern(10, 9)}, {5, pattern(len, 3)}, {2, pattern(20, 4)}}));
+        expectSameAsReference(packReference({{5, pattern(len, 3)}, {5, pattern(len + 1, 5)}}));  // separated repeats
+    }
+}
+
+TEST(TLV8View, MergeIsIdempotent)
+{
+    bytes buf = packReference({{5, pattern(600, 3)}, {2, pattern(20, 4)}});
+    TLV8View view;
+
+    ASSERT_EQ(view.unpack(buf.data(), buf.size()), 0);
+    auto it1 = view.find(5);
+    auto it2 = view.find(5);  // second find must not shift the already-merged value again
+    EXPECT_EQ(it1, it2);
+    EXPECT_EQ(bytes(it2->get(), it2->get() + 600), pattern(600, 3));
+    EXPECT_EQ(bytes(view.find(2)->get(), view.find(2)->get() + 20), pattern(20, 4));  // record after merge is intact
+}
+
+TEST(TLV8View, ZeroLengthAndEmpty)
+{
+    bytes buf = {6, 1, 1, 0xFF, 0, 7, 0};
+    TLV8View view;
+
+    ASSERT_EQ(view.unpack(buf.data(), buf.size()), 0);
+    EXPECT_EQ(view.len(view.find(0xFF)), 0);
+    EXPECT_EQ(view.len(view.find(7)), 0);
+    expectSameAsReference(buf);
+
+    ASSERT_EQ(view.unpack(buf.data(), 0), 0);
+    EXPECT_EQ(view.size(), 0);
+}
+
+TEST(TLV8View, Malformed)
+{
+    std::vector<bytes> bad = {
+        {6},                  // header truncated
+        {6, 2, 1},            // value truncated
+        {6, 1, 1, 3},         // second header truncated
+        {3, 255, 1, 2, 3},    // long value truncated
+        {6, 1, 1, 3, 10, 0},  // second value truncated
+    };
+
+    for (auto &b : bad) {
+        TLV8View view;
+        bytes copy = b;
+        EXPECT_EQ(view.unpack(copy.data(), copy.size()), -1);
+        expectSameAsReference(b);
+    }
+
+    bytes full = packReference({{3, pattern(600, 1)}, {4, pattern(64, 2)}});  // truncate a fragmented message
+    for (size_t n = 1; n < full.size(); n += 37)
+        expectSameAsReference(bytes(full.begin(), full.begin() + n));
+}
+
+TEST(TLV8View, TooManyRecords)
+{
+    std::vector<record_t> records;
+    for (int i = 0; i < 17; i++)
+        records.push_back({(uint8_t)(i + 1), {(uint8_t)i}});
+
+    bytes buf = packReference(records);
+    TLV8View view;
+    EXPECT_EQ(view.unpack(buf.data(), buf.size()), -1);
+
+    records.pop_back();
+    buf = packReference(records);
+    EXPECT_EQ(view.unpack(buf.data(), buf.size()), 0);
+}
+
+TEST(TLV8View, RandomMessages)
+{
+    std::mt19937 rng(1234);
+
+    for (int n = 0; n < 500; n++) {
+        std::vector<record_t> records(rng() % 8 + 1);
+        for (auto &r : records) {
+            r.tag = rng() % 12;
+            r.val.resize(rng() % 4 == 0 ? rng() % 900 : rng() % 40);
+            for (auto &v : r.val)
+                v = rng();
+        }
+        expectSameAsReference(packReference(records));
+    }
+}
+
+TEST(TLV8View, RandomBytes)
+{
+    std::mt19937 rng(99);
+
+    for (int n = 0; n < 2000; n++) {
+        bytes buf(rng() % 64 + 1);
+        for (auto &b : buf)
+            b = (rng() % 3 == 0) ? rng() % 8 : rng();  // favor short lengths so some buffers are well-formed
+        expectSameAsReference(buf);
+    }
+}
+
+//////////////////////////////////////
+
+namespace {
+
+// builds the same records with TLV8Writer and TLV8, and checks that the packed output and sizes are identical
+
+void expectWriterMatchesReference(const std::vector<record_t> &records, size_t initialSize = 256)
+{
+    TLV8Writer writer(initialSize);
+    for (auto &r : records) {
+        if (writer.pack_size() > 0 && r.tag == records[&r - records.data() - 1].tag)
+            writer.add(0xFF);  // same separator rule as packReference()
+        writer.add(r.tag, r.val.size(), r.val.data());
+    }
+
+    bytes expected = packReference(records);
+    ASSERT_EQ(writer.pack_size(), expected.size());
+
+    bytes packed(writer.pack_size() + 1, 0xAA);
+    EXPECT_EQ(writer.pack(packed.data()), expected.size());
+    EXPECT_EQ(packed.back(), 0xAA);  // nothing written beyond pack_size()
+    packed.pop_back();
+    EXPECT_EQ(packed, expected);
+
+    std::ostringstream os;
+    writer.osprint(os);
+    EXPECT_EQ(os.str(), std::string(expected.begin(), expected.end()));
+}
+
+}  // namespace
+
+TEST(TLV8Writer, FragmentBoundaries)
+{
+    for (size_t len : {0, 1, 254, 255, 256, 509, 510, 511, 765, 766, 1024})
+        expectWriterMatchesReference({{6, {2}}, {3, pattern(len, 1)}, {4, pattern(3, 2)}});
+}
+
+TEST(TLV8Writer, IntegerValues)
+{
+    for (uint64_t v : {0ull, 1ull, 0xFFull, 0x100ull, 0xFFFFull, 0x10000ull, 0xFFFFFFFFull, 0x100000000ull}) {
+        TLV8Writer writer;
+        TLV8 tlv;
+        writer.add(6, v);
+        tlv.add(6, v);
+        bytes expected(tlv.pack_size()), packed(writer.pack_size());
+        tlv.pack(expected.data());
+        writer.pack(packed.data());
+        EXPECT_EQ(packed, expected) << v;
+    }
+}
+
+TEST(TLV8Writer, RefSurvivesGrowth)
+{
+    TLV8Writer writer(16);  // small arena, so later records force it to be re-allocated
+    auto ref = writer.add(3, 384, NULL);
+    for (int i = 0; i < 384; i++)
+        (*ref)[i] = i;
+    writer.add(4, 2000, pattern(2000, 5).data());
+
+    EXPECT_EQ(ref.getLen(), 384u);
+    for (int i = 0; i < 384; i++)
+        ASSERT_EQ((*ref)[i], (uint8_t)i);
+}
+
+TEST(TLV8Writer, Clear)
+{
+    TLV8Writer writer;
+    writer.add(3, 300, pattern(300, 1).data());
+    writer.clear();
+    EXPECT_EQ(writer.pack_size(), 0u);
+    writer.add(6, 1);
+    bytes packed(writer.pack_size());
+    writer.pack(packed.data());
+    EXPECT_EQ(packed, bytes({6, 1, 1}));
+}
+
+TEST(TLV8Writer, RandomRecords)
+{
+    std::mt19937 rng(77);
+
+    for (int n = 0; n < 300; n++) {
+        std::vector<record_t> records(rng() % 10 + 1);
+        for (auto &r : records) {
+            r.tag = rng() % 10;
+            r.val.resize(rng() % 3 == 0 ? rng() % 1200 : rng() % 30);
+            for (auto &v : r.val)
+                v = rng();
+        }
+        expectWriterMatchesReference(records, rng() % 2 ? 256 : 8);
+    }
+}
+
+// Builds and packs pair-setup M2, M4 and M6 sized responses with TLV8 and with TLV8Writer.  Host timings only show
+// relative costs.
+
+TEST(TLV8Writer, Benchmark)
+{
+    const int nIter = 20000;
+    const bytes publicKey = pattern(384, 1), salt = pattern(16, 2), proof = pattern(64, 3), encrypted = pattern(154, 4);
+
+    struct message_t
+    {
+        const char *name;
+        std::vector<record_t> records;
+    } messages[] = {
+        {"M2 (State, PublicKey, Salt)", {{6, {2}}, {3, publicKey}, {2, salt}}},
+        {"M4 (State, Proof)", {{6, {4}}, {4, proof}}},
+        {"M6 (State, EncryptedData)", {{6, {6}}, {5, encrypted}}},
+    };
+
+    bytes buf(1024);
+    for (auto &m : messages) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < nIter; i++) {
+            TLV8 tlv;
+            for (auto &r : m.records)
+                tlv.add(r.tag, r.val.size(), r.val.data());
+            tlv.pack(buf.data());
+        }
+        double tList = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+        t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < nIter; i++) {
+            TLV8Writer writer;
+            for (auto &r : m.records)
+                writer.add(r.tag, r.val.size(), r.val.data());
+            writer.pack(buf.data());
+        }
+        double tArena = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+
+        printf("%-30s TLV8 %6.2f us   TLV8Writer %6.2f us\n", m.name, tList / nIter, tArena / nIter);
+    }
+}
@@ -0,0 +1,84 @@
+// SpanTrace, which records the duration of instrumented stages into a ring and exports it as Chrome trace JSON, as
+// printed by the 'T' serial command and served at <status-url>/trace.  Built with -DHS_TRACE and a 4-event ring, and
+// timed by the virtual clock, whose cycle counter runs at 160 cycles per microsecond.
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+#include "Trace.h"
+
+namespace {
+
+void stage(const char *name, uint64_t at, uint32_t us)  // a stage that runs for 'us' microseconds starting at 'at'
+{
+    hostMicros = at;
+    HS_TRACE_SCOPE(name);
+    hostMicros += us;
+}
+
+std::string printed()
+{
+    std::ostringstream out;
+    SpanTrace::print(out);
+    return (out.str());
+}
+
+std::string event(const char *name, const char *ts, const char *dur)
+{
+    return (std::string("{\"name\":\"") + name + "\",\"ph\":\"X\",\"ts\":" + ts + ",\"dur\":" + dur +
+            ",\"pid\":1,\"tid\":1}");
+}
+
+std::string trace(const std::string &events, int nEvents, int dropped)
+{
+    return ("{\"traceEvents\":[" + events + "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"events\":" +
+            std::to_string(nEvents) + ",\"dropped\":" + std::to_string(dropped) + "}}");
+}
+
+}  // namespace
+
+TEST(SpanTrace, EmptyTrace)
+{
+    SpanTrace::clear();
+    EXPECT_EQ(printed(), trace("", 0, 0));
+}
+
+TEST(SpanTrace, StagesInOrderRecorded)
+{
+    SpanTrace::clear();
+    stage("decrypt", 1000, 120);
+    {
+        hostMicros = 2000;
+        HS_TRACE_BEGIN(update, "update");
+        hostMicros += 15;
+        HS_TRACE_END(update);
+        hostMicros += 500;  // not part of the stage
+    }
+
+    EXPECT_EQ(printed(), trace(event("decrypt", "1000", "120.0") + "," + event("update", "2000", "15.0"), 2, 0));
+}
+
+TEST(SpanTrace, RingKeepsNewestEvents)
+{
+    SpanTrace::clear();
+    const char *names[] = {"a", "b", "c", "d", "e", "f"};
+    for (int i = 0; i < 6; i++)
+        stage(names[i], 100 * i, 1);
+
+    EXPECT_EQ(printed(), trace(event("c", "200", "1.0") + "," + event("d", "300", "1.0") + "," +
+                                   event("e", "400", "1.0") + "," + event("f", "500", "1.0"),
+                               6, 2));
+}
+
+TEST(SpanTrace, TimestampsDoNotWrapAfter71Minutes)
+{
+    SpanTrace::clear();
+    stage("parse", 0xFFFFFF00ULL, 10);           // just before 32-bit microseconds wrap, 71.6 minutes after boot
+    stage("render", 0x100000010ULL, 10);         // just after
+    stage("write", 30ULL * 86400 * 1000000, 7);  // 30 days after boot
+
+    EXPECT_EQ(printed(), trace(event("parse", "4294967040", "10.0") + "," + event("render", "4294967312", "10.0") +
+                                   "," + event("write", "2592000000000", "7.0"),
+                               3, 0));
+}
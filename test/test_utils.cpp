@@ -0,0 +1,668 @@
+// Utils::PurgeableQueue, used by ~SpanCharacteristic() to drop queued setValAsync() and setValFromISR() updates,
+// including stress tests with many producer tasks and with producer ISRs, Utils::SeqLock, which lets other tasks read
+// Characteristic values while pollTask() stores new ones, PushButton, replaying traces of button edges through the
+// interrupt-queued edge ring, PinToggle, which drives the pins bound with bindPin(), and a soak test of BumpArena,
+// which holds the per-request buffers
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Utils.h"
+#include "hostmem.h"
+
+namespace {
+
+struct item_t
+{
+    int target;    // stands in for the Characteristic pointer
+    int producer;  // producer that queued the item
+    int seq;       // sequence number of item within its producer
+};
+
+std::vector<item_t> drain(Utils::PurgeableQueue &q)
+{
+    std::vector<item_t> items;
+    item_t item;
+    while (q.receive(item))
+        items.push_back(item);
+    return (items);
+}
+
+}  // namespace
+
+TEST(PurgeableQueue, KeepsOtherItemsInOrder)
+{
+    Utils::PurgeableQueue q;
+    EXPECT_FALSE(q);
+    ASSERT_TRUE(q.begin<item_t>(16));
+    EXPECT_TRUE(q);
+
+    for (int i = 0; i < 16; i++) {
+        item_t item = {i % 3, 0, i};
+        EXPECT_TRUE(i % 2 ? q.send(item) : q.sendFromISR(item));
+    }
+    item_t extra = {0, 0, 16};
+    EXPECT_FALSE(q.send(extra));  // queue is full
+    EXPECT_FALSE(q.sendFromISR(extra));
+
+    EXPECT_EQ(q.purge<item_t>([](const item_t &item) { return (item.target == 1); }), 0);  // nothing lost
+
+    auto items = drain(q);
+    ASSERT_EQ(items.size(), 11u);
+    for (size_t i = 1; i < items.size(); i++)
+        EXPECT_LT(items[i - 1].seq, items[i].seq);
+    for (auto &item : items)
+        EXPECT_NE(item.target, 1);
+
+    EXPECT_EQ(q.purge<item_t>([](const item_t &) { return (true); }), 0);  // purging an empty queue is harmless
+    EXPECT_TRUE(drain(q).empty());
+}
+
+// Producer tasks queue updates for their own targets while a consumer applies updates and, as each producer
+// finishes (as a Characteristic would be deleted only after nothing can update it any more), purges that producer's
+// targets.  No purged target may be received after its purge, every other item must be received exactly once, and
+// each producer's items must be received in order.
+
+TEST(PurgeableQueue, ManyProducers)
+{
+    const int nProducers = 8;
+    const int nItems = 20000;
+    const int targetsPerProducer = 4;
+
+    Utils::PurgeableQueue q;
+    q.begin<item_t>(64);
+    std::atomic<int> finished[nProducers];
+    std::vector<int> sent(nProducers * targetsPerProducer, 0);
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < nProducers; p++) {
+        finished[p] = 0;
+        producers.emplace_back([&, p]() {
+            std::mt19937 rng(p);
+            for (int seq = 0; seq < nItems; seq++) {
+                item_t item = {p * targetsPerProducer + (int)(rng() % targetsPerProducer), p, seq};
+                while (!q.send(item))  // queue is full - wait for consumer
+                    std::this_thread::yield();
+                sent[item.target]++;
+            }
+            finished[p] = 1;
+        });
+    }
+
+    std::vector<int> received(nProducers * targetsPerProducer, 0);
+    std::vector<int> lastSeq(nProducers, -1);
+    std::vector<bool> purged(nProducers, false);
+    int nPurged = 0;
+    item_t item;
+
+    while (nPurged < nProducers) {
+        for (int i = 0; i < 8 && q.receive(item); i++) {
+            ASSERT_FALSE(purged[item.producer]) << "item received after its target was purged";
+            ASSERT_GT(item.seq, lastSeq[item.producer]) << "items of producer " << item.producer << " out of order";
+            lastSeq[item.producer] = item.seq;
+            received[item.target]++;
+        }
+
+        ASSERT_EQ(q.purge<item_t>([](const item_t &) { return (false); }), 0);  // a Characteristic with no updates
+
+        for (int p = 0; p < nProducers; p++) {
+            if (finished[p] && !purged[p] && (nPurged < nProducers / 2 || p % 2)) {  // leave some to drain normally
+                ASSERT_EQ(q.purge<item_t>([p](const item_t &i) { return (i.producer == p); }), 0);
+                purged[p] = true;
+                nPurged++;
+            }
+        }
+
+        if (nPurged >= nProducers / 2) {  // producers left unpurged are drained after they finish
+            bool allFinished = true;
+            for (int p = 0; p < nProducers; p++)
+                allFinished = allFinished && finished[p];
+            if (allFinished)
+                break;
+        }
+    }
+
+    for (auto &t : producers)
+        t.join();
+
+    for (auto &i : drain(q)) {
+        ASSERT_FALSE(purged[i.producer]) << "item received after its target was purged";
+        ASSERT_GT(i.seq, lastSeq[i.producer]);
+        lastSeq[i.producer] = i.seq;
+        received[i.target]++;
+    }
+
+    for (int p = 0; p < nProducers; p++) {
+        for (int t = p * targetsPerProducer; t < (p + 1) * targetsPerProducer; t++) {
+            if (purged[p])
+                EXPECT_LE(received[t], sent[t]);
+            else
+                EXPECT_EQ(received[t], sent[t]) << "target " << t;
+        }
+    }
+}
+
+// Producer ISRs (as togglePinISR() and setValFromISR() run, on either core and regardless of the scheduler) fire
+// into a small queue that is full much of the time, while the consumer purges it over and over, dropping the items
+// of one target and keeping all others.  Every item an ISR queued that was not dropped must be received exactly once
+// and in order - an ISR slipping an item in while a purge cycles the queue would place it ahead of older items, or
+// take the room a kept item needs to be sent back.
+
+TEST(PurgeableQueue, IsrProducersDuringPurge)
+{
+    const int nProducers = 4;
+    const int nPurges = 5000;
+    const int dropTarget = 0;
+
+    Utils::PurgeableQueue q;
+    q.begin<item_t>(8);
+    std::atomic<bool> stop(false);
+    std::vector<int> sent(nProducers, 0);  // items queued (and not dropped) by each producer
+    std::vector<std::thread> producers;
+
+    for (int p = 0; p < nProducers; p++) {
+        producers.emplace_back([&, p]() {
+            std::mt19937 rng(p + 35);
+            for (int seq = 0; !stop; seq++) {  // keep firing until the consumer has made all its purges
+                item_t item = {(int)(rng() % 4), p, seq};
+                if (q.sendFromISR(item) && item.target != dropTarget)  // an ISR never waits - a full queue loses it
+                    sent[p]++;
+                std::this_thread::yield();  // until the next interrupt
+            }
+        });
+    }
+
+    std::vector<int> received(nProducers, 0);
+    std::vector<int> lastSeq(nProducers, -1);
+    item_t item;
+
+    auto check = [&](const item_t &i) {
+        ASSERT_NE(i.target, dropTarget) << "dropped item received";
+        ASSERT_GT(i.seq, lastSeq[i.producer]) << "items of producer " << i.producer << " out of order";
+        lastSeq[i.producer] = i.seq;
+        received[i.producer]++;
+    };
+
+    for (int n = 0; n < nPurges; n++) {
+        EXPECT_EQ(q.purge<item_t>([](const item_t &i) { return (i.target == dropTarget); }), 0);
+        if (q.receive(item))
+            check(item);
+    }
+
+    stop = true;
+    for (auto &t : producers)
+        t.join();
+
+    ASSERT_EQ(q.purge<item_t>([](const item_t &i) { return (i.target == dropTarget); }), 0);
+    for (auto &i : drain(q))
+        check(i);
+
+    for (int p = 0; p < nProducers; p++)
+        EXPECT_EQ(received[p], sent[p]) << "producer " << p;
+}
+
+// A writer publishes a payload much larger than one copy can take atomically (every word holds the generation, and
+// the string pointer names it, as a Characteristic's string value would) while reader tasks take snapshots.  The
+// writer yields in the middle of some writes, standing in for a reader on the other core copying the payload while
+// a store is half done.  No snapshot may mix two generations, and each reader must see generations in order.
+
+TEST(SeqLock, ReadersNeverSeeTornValues)
+{
+    const int nReaders = 3;
+    const uint32_t nWrites = 10000;
+    const int nNames = 16;
+
+    struct payload_t
+    {
+        uint64_t words[32];
+        const char *name;
+    };
+
+    char names[nNames][16];
+    for (int i = 0; i < nNames; i++)
+        snprintf(names[i], sizeof(names[i]), "value-%d", i);
+
+    Utils::SeqLock lock;
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    payload_t data = {};
+    data.name = names[0];
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> snapshots(0);
+    std::atomic<int> torn(0);
+    std::atomic<int> backwards(0);
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < nReaders; r++) {
+        readers.emplace_back([&]() {
+            uint64_t last = 0;
+            while (!done) {
+                payload_t snap = lock.read(data);
+                uint64_t gen = snap.words[0];
+                for (auto w : snap.words)
+                    torn += (w != gen);
+                torn += (strcmp(snap.name, names[gen % nNames]) != 0);
+                backwards += (gen < last);
+                last = gen;
+                snapshots++;
+            }
+        });
+    }
+
+    for (uint32_t gen = 1; gen <= nWrites; gen++) {
+        lock.writeBegin(&mux);
+        for (int i = 0; i < 32; i++) {
+            data.words[i] = gen;
+            if (i == 16 && gen % 64 == 0)
+                std::this_thread::yield();
+        }
+        data.name = names[gen % nNames];
+        lock.writeEnd(&mux);
+        if (gen % 8 == 0)
+            std::this_thread::yield();
+    }
+
+    done = true;
+    for (auto &t : readers)
+        t.join();
+
+    EXPECT_EQ(torn, 0);
+    EXPECT_EQ(backwards, 0);
+    EXPECT_GT(snapshots, 0u);
+    EXPECT_EQ(lock.read(data).words[31], nWrites);
+}
+
+// PushButton edge traces.  The pin is driven with hostSetPin(), which calls the edge interrupt handler, while the
+// virtual clock advances.  A button read from edges must classify presses the same way, no matter how rarely
+// triggered() or toggled() is called, as a button polled every millisecond.
+
+namespace {
+
+const int buttonPin = 5;
+
+boolean polledOnLow(int pin)  // same as TRIGGER_ON_LOW, but a custom handler, so PushButton polls the pin
+{
+    return (!digitalRead(pin));
+}
+
+void press(uint32_t ms)  // sets virtual clock to 'ms' and presses button
+{
+    hostMicros = (uint64_t)ms * 1000;
+    hostSetPin(buttonPin, LOW);
+}
+
+void release(uint32_t ms)
+{
+    hostMicros = (uint64_t)ms * 1000;
+    hostSetPin(buttonPin, HIGH);
+}
+
+// appends press type to types, unless it repeats a Long Press
+
+void addType(std::vector<int> &types, int type)
+{
+    if (type != PushButton::LONG || types.empty() || types.back() != PushButton::LONG)
+        types.push_back(type);
+}
+
+// calls triggered() at time 'ms' until it returns false, and returns the press types triggered
+
+std::vector<int> triggersAt(PushButton &pb, uint32_t ms, uint16_t singleTime, uint16_t longTime, uint16_t doubleTime)
+{
+    std::vector<int> types;
+    hostMicros = (uint64_t)ms * 1000;
+    while (pb.triggered(singleTime, longTime, doubleTime))
+        types.push_back(pb.type());
+    return (types);
+}
+
+}  // namespace
+
+TEST(PushButton, LongPressReadLate)
+{
+    hostPinLevel[buttonPin] = HIGH;
+    PushButton pb(buttonPin);
+
+    press(1000);
+    release(3500);  // held for 2.5 seconds, longer than longTime
+
+    EXPECT_EQ(triggersAt(pb, 4000, 5, 2000, 200), std::vector<int>({PushButton::LONG}));  // not SINGLE
+    EXPECT_TRUE(triggersAt(pb, 6000, 5, 2000, 200).empty());
+}
+
+TEST(PushButton, SingleAndDoublePressReadLate)
+{
+    hostPinLevel[buttonPin] = HIGH;
+    PushButton pb(buttonPin);
+
+    press(1000);
+    release(1100);
+    EXPECT_EQ(triggersAt(pb, 2000, 5, 2000, 200), std::vector<int>({PushButton::SINGLE}));
+
+    press(3000);
+    release(3100);
+    press(3200);
+    release(3300);
+    EXPECT_EQ(triggersAt(pb, 5000, 5, 2000, 200), std::vector<int>({PushButton::DOUBLE}));
+}
+
+TEST(PushButton, ActiveHighButtonReadLate)
+{
+    hostPinLevel[buttonPin] = LOW;
+    PushButton pb(buttonPin, PushButton::TRIGGER_ON_HIGH);
+
+    hostMicros = 1000000;  // pressed - pin pulled HIGH
+    hostSetPin(buttonPin, HIGH);
+    hostMicros = 3500000;
+    hostSetPin(buttonPin, LOW);
+    EXPECT_EQ(triggersAt(pb, 4000, 5, 2000, 200), std::vector<int>({PushButton::LONG}));
+
+    hostMicros = 5000000;
+    hostSetPin(buttonPin, HIGH);
+    hostMicros = 5100000;
+    hostSetPin(buttonPin, LOW);
+    EXPECT_EQ(triggersAt(pb, 6000, 5, 2000, 200), std::vector<int>({PushButton::SINGLE}));
+}
+
+TEST(PushButton, ToggleHeldClosedThenOpenedReadLate)
+{
+    hostPinLevel[buttonPin] = HIGH;
+    PushButton pb(buttonPin);
+    std::vector<int> types;
+
+    press(1000);
+    release(1100);  // held CLOSED for longer than toggleTime
+    hostMicros = 2000 * 1000;
+    while (pb.toggled(50))
+        types.push_back(pb.type());
+
+    EXPECT_EQ(types, std::vector<int>({PushButton::CLOSED, PushButton::OPEN}));
+}
+
+// random presses of 20 ms to 3 s, separated by 50 to 800 ms, read from edges by calls spaced up to 400 ms apart
+// (fewer edges than the ring holds), and by a polled button read every millisecond.  A button held down repeats its
+// Long Press every longTime ms only while triggered() keeps being called (a late call reports one Long Press, as when
+// polling late), so consecutive Long Presses are counted once on both sides.
+
+TEST(PushButton, RandomTracesMatchPolling)
+{
+    const uint16_t singleTime = 5, longTime = 1000, doubleTime = 200;
+    std::mt19937 rng(41);
+    int nTypes[3] = {0, 0, 0};
+
+    for (int n = 0; n < 20; n++) {
+        hostMicros = 0;
+        hostPinLevel[buttonPin] = HIGH;
+        PushButton edges(buttonPin);
+        PushButton polled(buttonPin, polledOnLow);
+
+        std::vector<std::pair<uint32_t, int>> trace;  // (time, level) of every edge
+        uint32_t t = 100;
+        for (int i = 0; i < 40; i++) {
+            trace.push_back({t, LOW});
+            t += 20 + rng() % (i % 4 ? 300 : 3000);
+            trace.push_back({t, HIGH});
+            t += 50 + rng() % 750;
+        }
+        uint32_t end = t + 5000;
+
+        std::vector<int> edgeTypes, polledTypes;
+        size_t next = 0;
+        uint32_t nextCall = rng() % 400;
+
+        for (uint32_t ms = 0; ms <= end; ms++) {
+            hostMicros = (uint64_t)ms * 1000;
+            while (next < trace.size() && trace[next].first == ms)
+                hostSetPin(buttonPin, trace[next++].second);
+
+            if (polled.triggered(singleTime, longTime, doubleTime))
+                addType(polledTypes, polled.type());
+
+            if (ms == nextCall || ms == end) {
+                while (edges.triggered(singleTime, longTime, doubleTime))
+                    addType(edgeTypes, edges.type());
+                nextCall = ms + 1 + rng() % 400;
+            }
+        }
+
+        ASSERT_EQ(edgeTypes, polledTypes) << "trace " << n;
+        for (auto type : polledTypes)
+            nTypes[type]++;
+    }
+
+    EXPECT_GT(nTypes[PushButton::SINGLE], 0);  // make sure the traces exercise every press type
+    EXPECT_GT(nTypes[PushButton::DOUBLE], 0);
+    EXPECT_GT(nTypes[PushButton::LONG], 0);
+}
+
+// PinToggle, as bound to a Characteristic by bindPin().  The toggle pin is driven with hostSetPin(), which calls an
+// ISR that queues an update for each accepted edge, as SpanCharacteristic::togglePinISR() does, while the virtual
+// clock advances in microseconds.
+
+namespace {
+
+const int ledPin = 12;     // output pin
+const int switchPin = 13;  // toggle pin
+portMUX_TYPE pinMux = portMUX_INITIALIZER_UNLOCKED;
+
+struct binding_t : PinToggle  // as SpanCharacteristic::pinBinding_t
+{
+    Utils::PurgeableQueue queue;  // updates queued for pollTask(), each holding the toggle count
+    binding_t(boolean initial, uint16_t toggleTime = 5);
+};
+
+void toggleISR(void *arg)  // as SpanCharacteristic::togglePinISR()
+{
+    binding_t *b = (binding_t *)arg;
+    uint32_t n = b->toggles;
+    if (b->edge())
+        b->queue.sendFromISR(++n);
+}
+
+binding_t::binding_t(boolean initial, uint16_t toggleTime)
+{
+    hostPinLevel[switchPin] = HIGH;  // switch is open, and toggle pin pulled up
+    hostPinLevel[ledPin] = !initial;
+    queue.begin<uint32_t>(64);
+    begin(ledPin, switchPin, toggleTime, initial, &pinMux, toggleISR, this);
+}
+
+void setPin(uint64_t us, int level)  // sets virtual clock to 'us' and drives toggle pin
+{
+    hostMicros = us;
+    hostSetPin(switchPin, level);
+}
+
+std::vector<uint32_t> updates(binding_t &b)  // drains queued updates
+{
+    std::vector<uint32_t> u;
+    uint32_t n;
+    while (b.queue.receive(n))
+        u.push_back(n);
+    return (u);
+}
+
+}  // namespace
+
+TEST(PinToggle, OutputStartsAtValueAndFlipsOnEachEdge)
+{
+    binding_t b(true);
+    EXPECT_EQ(hostPinLevel[ledPin], HIGH);
+    EXPECT_EQ(b.lastLevel, HIGH);
+
+    setPin(1000000, LOW);  // rocker switch closed...
+    EXPECT_EQ(hostPinLevel[ledPin], LOW);  // ...drives output before the ISR returns
+    setPin(2000000, HIGH);  // ...and opened again
+    EXPECT_EQ(hostPinLevel[ledPin], HIGH);
+    EXPECT_EQ(b.toggles, 2u);
+    EXPECT_EQ(updates(b), (std::vector<uint32_t>{1, 2}));
+
+    b.end();
+    setPin(3000000, LOW);  // no longer bound
+    EXPECT_EQ(hostPinLevel[ledPin], HIGH);
+    EXPECT_EQ(b.toggles, 2u);
+}
+
+TEST(PinToggle, ContactBounceIsIgnored)
+{
+    binding_t b(false, 5);
+    uint64_t t = 10000000;
+
+    for (int flip = 0; flip < 20; flip++) {  // each flip of the switch bounces 4 times over 1.3 ms before settling
+        int level = flip % 2 ? HIGH : LOW;
+        setPin(t, level);
+        for (uint64_t dt : {200, 450, 900, 1300}) {
+            setPin(t + dt, !level);
+            setPin(t + dt + 50, level);
+        }
+        EXPECT_EQ(hostPinLevel[ledPin], flip % 2 ? LOW : HIGH) << "flip " << flip;
+        t += 300000;
+    }
+    EXPECT_EQ(b.toggles, 20u);
+    EXPECT_EQ(updates(b).size(), 20u);
+
+    setPin(t, LOW);  // edges exactly toggleTime apart are both accepted
+    setPin(t + 5000, HIGH);
+    setPin(t + 9999, LOW);  // but not one less than toggleTime after the last
+    EXPECT_EQ(b.toggles, 22u);
+}
+
+TEST(PinToggle, DriveFromTaskSetsStateForNextEdge)
+{
+    binding_t b(false);
+
+    portENTER_CRITICAL(&pinMux);  // as in SpanCharacteristic::storeValue() for setVal(1)
+    b.drive(true);
+    portEXIT_CRITICAL(&pinMux);
+    EXPECT_EQ(hostPinLevel[ledPin], HIGH);
+
+    setPin(1000000, LOW);
+    EXPECT_FALSE(b.state);
+    EXPECT_EQ(hostPinLevel[ledPin], LOW);
+}
+
+// time from an edge on the toggle pin to the output pin changing is zero on the virtual clock, since the ISR drives
+// the output before it returns; this measures the host time the ISR itself takes, with and without a bounce
+
+TEST(PinToggle, EdgeLatency)
+{
+    const int nEdges = 200000;
+    binding_t b(false);
+    uint64_t t = 1000000;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < nEdges; i++) {
+        setPin(t, i % 2 ? HIGH : LOW);
+        if (i % 32 == 31)
+            updates(b);
+        t += 10000;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    EXPECT_EQ(b.toggles, (uint32_t)nEdges);
+
+    t -= 9000;  // 1 ms after the last accepted edge
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < nEdges; i++)
+        setPin(t, i % 2 ? HIGH : LOW);  // all within toggleTime of the last accepted edge
+    double bounceNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t1).count();
+    EXPECT_EQ(b.toggles, (uint32_t)nEdges);
+
+    printf("accepted edge (output driven, update queued) %8.1f ns\n", ns / nEdges);
+    printf("bounce (ignored)                             %8.1f ns\n", bounceNs / nEdges);
+}
+
+// BumpArena.  Requests are replayed with the mix a busy bridge sees: mostly small GET and PUT requests, some larger
+// ones, and rare very large ones (such as a GET of the whole database).  After a large request the main block may
+// grow, but it must shrink back to its initial size once no request in a full check period of SHRINK_RESETS (64)
+// resets has needed more - at most 128 requests later - so heap held between requests stays stable.
+
+TEST(BumpArena, GrowsThenShrinksBackToInitialSize)
+{
+    BumpArena arena(HS_MEM_NETWORK, 2048);
+
+    arena.alloc(100);
+    arena.reset();
+    EXPECT_EQ(arena.getCapacity(), 2048u);
+    EXPECT_EQ(hostMemLive(HS_MEM_NETWORK), 2048u);
+
+    arena.alloc(3000);
+    arena.alloc(3000);  // overflows main block
+    arena.reset();
+    EXPECT_EQ(arena.getCapacity(), 6144u);  // grown so the same request fits next time
+    EXPECT_EQ(hostMemLive(HS_MEM_NETWORK), 0u);
+    EXPECT_EQ(arena.getOverflows(), 2u);
+
+    for (int i = 0; i < 63; i++) {
+        arena.alloc(500);
+        arena.reset();
+        EXPECT_EQ(arena.getCapacity(), 6144u);
+    }
+    arena.alloc(500);
+    arena.reset();  // 64th small request since growing
+    EXPECT_EQ(arena.getCapacity(), 2048u);
+    EXPECT_EQ(arena.getHighWater(), 6000u);
+    EXPECT_EQ(hostMemLive(HS_MEM_NETWORK), 0u);  // main block is re-allocated on first use
+}
+
+TEST(BumpArena, KeepsSizeThatRecentRequestsNeed)
+{
+    BumpArena arena(HS_MEM_NETWORK, 1024);
+
+    for (int i = 0; i < 1000; i++) {  // a 3000-byte request every 50 requests keeps the main block at 3072 bytes
+        arena.alloc(i % 50 ? 200 : 3000);
+        arena.reset();
+        if (i > 0) {
+            ASSERT_EQ(arena.getCapacity(), 3072u) << "request " << i;
+        }
+    }
+    EXPECT_EQ(arena.getOverflows(), 1u);
+}
+
+TEST(BumpArena, Soak)
+{
+    const int nRequests = 200000;
+    const size_t initialSize = 2048;
+
+    BumpArena arena(HS_MEM_NETWORK, initialSize);
+    std::mt19937 rng(42);
+    int nLarge = 0, nResizes = 0;
+    size_t maxCapacity = 0, maxLive = 0, lastCapacity = initialSize;
+    int sinceLarge = 1000;
+
+    for (int i = 0; i < nRequests; i++) {
+        uint32_t r = rng() % 10000;
+        size_t request = r < 9500 ? 200 + rng() % 1300 : (r < 9990 ? 1500 + rng() % 2500 : 8000 + rng() % 8000);
+        if (request > initialSize) {
+            nLarge++;
+            sinceLarge = 0;
+        }
+
+        for (size_t left = request; left > 0;) {  // request buffers are allocated in a few pieces
+            size_t n = std::min(left, (size_t)(64 + rng() % 1024));
+            memset(arena.alloc(n), 0xA5, n);
+            left -= n;
+        }
+        arena.reset();
+
+        size_t live = hostMemLive(HS_MEM_NETWORK);
+        maxLive = std::max(maxLive, live);
+        ASSERT_LE(live, arena.getCapacity()) << "overflow blocks must be freed on reset()";
+        if (arena.getCapacity() != lastCapacity)
+            nResizes++;
+        lastCapacity = arena.getCapacity();
+        maxCapacity = std::max(maxCapacity, lastCapacity);
+
+        if (++sinceLarge > 128) {  // no large request in the last two check periods
+            ASSERT_EQ(arena.getCapacity(), initialSize) << "request " << i;
+        }
+    }
+
+    EXPECT_LE(nResizes, 2 * nLarge);
+    printf("%d requests (%d larger than %zu bytes): %d resizes, largest main block %zu bytes, final %zu bytes, "
+           "%u overflows\n",
+           nRequests, nLarge, initialSize, nResizes, maxCapacity, arena.getCapacity(), arena.getOverflows());
+}
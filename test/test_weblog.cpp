@@ -0,0 +1,470 @@
+// Utils::LogRing, which holds the Web Log, filled with entries the size of those SpanWebLog::vLog() appends, in a ring
+// sized the way SpanWebLog::init() sizes it, and read back the way the status page (newest first) and the /log
+// stream (oldest first, resuming from a cursor) read it.  The benchmark at the end times LogRing against the
+// vasprintf() and realloc() storage it replaced.
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Utils.h"
+#include "hostmem.h"
+
+namespace {
+
+struct entry_t
+{  // same layout as SpanWebLog::entry_t
+    uint32_t seq;
+    uint32_t upTime;
+    uint32_t clientIP;
+    uint32_t next;
+    uint32_t prev;
+    uint16_t len;
+    char clockTime[26];
+};
+
+typedef Utils::LogRing<entry_t> ring_t;
+
+const uint32_t entrySize = 128;   // DEFAULT_WEBLOG_ENTRY_SIZE
+const uint32_t maxMessage = 256;  // MAX_WEBLOG_MESSAGE
+const uint8_t guard = 0xA5;       // fills the bytes on either side of the ring
+
+// a ring for 'maxEntries', as allocated by SpanWebLog::init(), with guard bytes on either side to catch overruns
+
+struct log_t
+{
+    std::vector<uint8_t> mem;
+    uint32_t size;
+    ring_t ring;
+    std::deque<std::string> appended;  // every message appended (index 0 is seq 1)
+
+    log_t(uint32_t maxEntries) : size(maxEntries * entrySize + sizeof(entry_t) + maxMessage)
+    {
+        mem.assign(size + 128, guard);
+        ring.begin(mem.data() + 64, size, maxEntries);
+    }
+
+    void add(const std::string &msg)
+    {
+        entry_t entry;
+        entry.upTime = appended.size();
+        entry.clientIP = 0x0100A8C0;
+        entry.len = msg.size();
+        entry.clockTime[0] = '\0';
+        ring.append(entry, msg.c_str());
+        appended.push_back(msg);
+        EXPECT_EQ(entry.seq, appended.size());
+    }
+
+    bool guardsIntact()
+    {
+        for (size_t i = 0; i < 64; i++) {
+            if (mem[i] != guard || mem[mem.size() - 1 - i] != guard)
+                return (false);
+        }
+        return (true);
+    }
+
+    // reads every entry from newest to oldest (as the status page does) and checks each against what was appended,
+    // returning the number of entries read
+
+    uint32_t checkNewestFirst()
+    {
+        uint32_t oldestSeq, newestSeq;
+        ring.getRange(oldestSeq, newestSeq);
+        EXPECT_EQ(newestSeq, appended.size());
+
+        ring_t::cursor_t cursor(newestSeq);
+        entry_t entry;
+        char msg[maxMessage];
+        uint32_t n = 0;
+
+        while (ring.read(cursor, entry, msg, sizeof(msg))) {
+            EXPECT_EQ(entry.seq, newestSeq - n);
+            EXPECT_EQ(entry.upTime, entry.seq - 1);
+            EXPECT_EQ(msg, appended[entry.seq - 1]) << "seq " << entry.seq;
+            n++;
+        }
+        EXPECT_EQ(n, newestSeq - oldestSeq + 1);
+        return (n);
+    }
+};
+
+std::string message(std::mt19937 &rng)  // random message of 0 to maxMessage-1 characters
+{
+    static uint32_t count = 0;
+    std::string msg = std::to_string(++count) + ":";
+    msg.resize(rng() % maxMessage, 'a' + count % 26);
+    return (msg);
+}
+
+}  // namespace
+
+TEST(WebLog, EmptyLog)
+{
+    log_t log(10);
+    uint32_t oldestSeq, newestSeq;
+    log.ring.getRange(oldestSeq, newestSeq);
+    EXPECT_GT(oldestSeq, newestSeq);
+
+    ring_t::cursor_t cursor(1);
+    entry_t entry;
+    char msg[maxMessage];
+    EXPECT_FALSE(log.ring.read(cursor, entry, msg, sizeof(msg), false));
+}
+
+TEST(WebLog, KeepsNoMoreThanMaxEntries)
+{
+    log_t log(10);
+    for (int i = 0; i < 100; i++) {
+        log.add("short message " + std::to_string(i));
+        EXPECT_EQ(log.checkNewestFirst(), std::min(i + 1, 10));
+    }
+    EXPECT_TRUE(log.guardsIntact());
+}
+
+TEST(WebLog, LongMessagesEvictOldestToMakeRoom)
+{
+    log_t log(10);  // 1584 bytes - room for 10 short entries, but only 5 entries with 255-character messages
+    for (int i = 0; i < 20; i++)
+        log.add(std::string(255, 'x'));
+    EXPECT_EQ(log.checkNewestFirst(), 5u);
+
+    log.add("short");  // a short entry fits without evicting anything more
+    EXPECT_EQ(log.checkNewestFirst(), 6u);
+    EXPECT_TRUE(log.guardsIntact());
+}
+
+TEST(WebLog, RandomMessagesWrapManyTimes)
+{
+    std::mt19937 rng(49);
+
+    for (uint32_t maxEntries : {1, 2, 5, 20, 50}) {
+        log_t log(maxEntries);
+        uint64_t bytes = 0;
+
+        for (int i = 0; i < 5000; i++) {
+            std::string msg = message(rng);
+            bytes += ring_t::entrySize(msg.size());
+            log.add(msg);
+
+            uint32_t n = log.checkNewestFirst();
+            ASSERT_GE(n, 1u);  // newest entry is always kept
+            ASSERT_LE(n, maxEntries);
+
+            uint32_t live = 0;  // the live entries never take up more than the whole ring
+            for (uint32_t seq = log.appended.size() - n + 1; seq <= log.appended.size(); seq++)
+                live += ring_t::entrySize(log.appended[seq - 1].size());
+            ASSERT_LE(live, log.size);
+
+            // below maxEntries, the last entry evicted was evicted for lack of room: it and the live entries fill the
+            // ring, less at most the unused end of the ring at the wrap and the gap the next entry did not fit into
+
+            if (n < maxEntries && n < log.appended.size()) {
+                uint32_t evicted = ring_t::entrySize(log.appended[log.appended.size() - n - 1].size());
+                ASSERT_GT((int64_t)(live + evicted), (int64_t)log.size - 2 * ring_t::entrySize(maxMessage - 1));
+            }
+        }
+
+        EXPECT_GT(bytes, 100 * (uint64_t)log.size) << "ring wrapped at least 100 times";
+        EXPECT_TRUE(log.guardsIntact()) << "maxEntries " << maxEntries;
+    }
+}
+
+TEST(WebLog, CursorStopsAtEvictedEntries)
+{
+    log_t log(10);
+    for (int i = 0; i < 10; i++)
+        log.add("entry " + std::to_string(i + 1));
+
+    ring_t::cursor_t cursor(10);  // status page starts reading newest first...
+    entry_t entry;
+    char msg[maxMessage];
+    for (int i = 0; i < 3; i++)
+        ASSERT_TRUE(log.ring.read(cursor, entry, msg, sizeof(msg)));
+    EXPECT_EQ(cursor.seq, 7u);
+
+    for (int i = 0; i < 5; i++)  // ...while new entries evict entries 1-5
+        log.add("entry " + std::to_string(i + 11));
+
+    int n = 0;
+    while (log.ring.read(cursor, entry, msg, sizeof(msg))) {
+        EXPECT_EQ(msg, "entry " + std::to_string(entry.seq));
+        n++;
+    }
+    EXPECT_EQ(n, 2);  // entries 7 and 6 - the cursor never reads a slot that was reused
+}
+
+TEST(WebLog, StreamResumesAfterNewEntries)
+{
+    std::mt19937 rng(50);
+    log_t log(20);
+    uint32_t since = 0;  // as in ?since= of GET /log
+    uint32_t received = 0;
+    uint32_t missed = 0;
+
+    for (int round = 0; round < 500; round++) {
+        int nNew = rng() % 30;  // 0-29 new entries between requests, so some requests fall behind
+        for (int i = 0; i < nNew; i++)
+            log.add(message(rng));
+
+        uint32_t oldestSeq, newestSeq;
+        log.ring.getRange(oldestSeq, newestSeq);
+        if (since + 1 < oldestSeq) {  // as in HAPClient::getLogURL()
+            missed += oldestSeq - since - 1;
+            since = oldestSeq - 1;
+        }
+
+        ring_t::cursor_t cursor(since + 1);
+        entry_t entry;
+        char msg[maxMessage];
+        while (cursor.seq <= newestSeq && log.ring.read(cursor, entry, msg, sizeof(msg), false)) {
+            ASSERT_EQ(entry.seq, since + 1);
+            ASSERT_EQ(msg, log.appended[entry.seq - 1]);
+            since = entry.seq;
+            received++;
+        }
+        ASSERT_EQ(since, newestSeq);
+    }
+
+    EXPECT_EQ(received + missed, log.appended.size());
+    EXPECT_GT(missed, 0u);
+}
+
+// GET /log streams at most LOG_STREAM_BATCH (8) entries per pollTask() cycle, as in HAPClient::streamLog(), and other
+// tasks can add entries between batches that evict the entries the stream has yet to send
+
+TEST(WebLog, StreamSkipsEntriesEvictedBetweenBatches)
+{
+    log_t log(20);
+    for (int i = 0; i < 20; i++)
+        log.add("entry " + std::to_string(i + 1));
+
+    ring_t::cursor_t cursor(1);
+    uint32_t logEnd = 20;
+    entry_t entry;
+    char msg[maxMessage];
+
+    for (int i = 0; i < 8; i++)  // first batch
+        ASSERT_TRUE(log.ring.readNewer(cursor, logEnd, entry, msg, sizeof(msg)));
+    EXPECT_EQ(entry.seq, 8u);
+
+    for (int i = 0; i < 15; i++)  // evicts entries 1-15, including 9-15 that were still to be sent
+        log.add("entry " + std::to_string(i + 21));
+
+    std::vector<uint32_t> seqs;
+    while (log.ring.readNewer(cursor, logEnd, entry, msg, sizeof(msg))) {
+        EXPECT_EQ(msg, "entry " + std::to_string(entry.seq));
+        seqs.push_back(entry.seq);
+    }
+    EXPECT_EQ(seqs, std::vector<uint32_t>({16, 17, 18, 19, 20}));  // skips ahead and stops at logEnd
+}
+
+TEST(WebLog, StreamRunsToEndWhileEntriesAreAdded)
+{
+    std::mt19937 rng(52);
+    log_t log(20);
+    uint32_t since = 0;
+    uint32_t skipped = 0;
+
+    for (int round = 0; round < 500; round++) {
+        for (int i = rng() % 10; i > 0; i--)
+            log.add(message(rng));
+
+        uint32_t oldestSeq, newestSeq;  // as in HAPClient::getLogURL()
+        log.ring.getRange(oldestSeq, newestSeq);
+        if (since + 1 < oldestSeq)
+            since = oldestSeq - 1;
+        ring_t::cursor_t cursor(since + 1);
+        uint32_t logEnd = newestSeq;
+        uint32_t last = since;
+
+        for (boolean done = false; !done;) {
+            int n = 0;
+            entry_t entry;
+            char msg[maxMessage];
+            while (n < 8 && log.ring.readNewer(cursor, logEnd, entry, msg, sizeof(msg))) {
+                ASSERT_GT(entry.seq, last);
+                ASSERT_LE(entry.seq, logEnd);
+                ASSERT_EQ(msg, log.appended[entry.seq - 1]);
+                skipped += entry.seq - last - 1;
+                last = entry.seq;
+                n++;
+            }
+            done = (n < 8 || cursor.seq > logEnd);
+
+            for (int i = done ? 0 : rng() % 16; i > 0; i--)  // entries added before the next pollTask() cycle
+                log.add(message(rng));
+        }
+
+        log.ring.getRange(oldestSeq, newestSeq);
+        ASSERT_TRUE(last == logEnd || oldestSeq > logEnd) << "stream ended early at " << last;  // nothing left unsent
+        since = logEnd;
+    }
+
+    EXPECT_GT(skipped, 0u);
+}
+
+TEST(WebLog, MessagesAreTruncatedToReadBuffer)
+{
+    log_t log(4);
+    log.add("0123456789");
+
+    ring_t::cursor_t cursor(1);
+    entry_t entry;
+    char msg[5];
+    ASSERT_TRUE(log.ring.read(cursor, entry, msg, sizeof(msg)));
+    EXPECT_STREQ(msg, "0123");
+    EXPECT_EQ(entry.len, 10);
+}
+
+// Web Log as it was stored before LogRing: an array of maxEntries entries, each holding a message formatted with
+// vasprintf() and copied into its own buffer with hs_realloc(), plus the client IP as a String
+
+struct oldLog_t
+{
+    struct log_t
+    {
+        uint64_t upTime;
+        struct tm clockTime;
+        char *message = NULL;
+        String clientIP;
+    };
+
+    std::vector<log_t> log;
+    uint32_t nEntries = 0;
+    String lastClientIP = "192.168.0.1";
+
+    oldLog_t(uint32_t maxEntries) : log(maxEntries) {}
+
+    ~oldLog_t()
+    {
+        for (auto &entry : log)
+            hs_free(entry.message, HS_MEM_WEBLOG);
+    }
+
+    void vLog(const char *fmt, va_list ap)  // as SpanWebLog::vLog() was, less its LOG0()/LOG1() echo
+    {
+        char *buf;
+        vasprintf(&buf, fmt, ap);
+
+        int index = nEntries % log.size();
+        log[index].upTime = esp_timer_get_time();
+        log[index].clockTime.tm_year = 0;
+        log[index].message = (char *)hs_realloc(log[index].message, strlen(buf) + 1, HS_MEM_WEBLOG);
+        strcpy(log[index].message, buf);
+        log[index].clientIP = lastClientIP;
+        nEntries++;
+
+        free(buf);
+    }
+
+    void add(const char *fmt, ...)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        vLog(fmt, ap);
+        va_end(ap);
+    }
+};
+
+// Web Log as SpanWebLog::vLog() now stores it, less its LOG0()/LOG1() echo and the lock
+
+struct newLog_t : log_t
+{
+    newLog_t(uint32_t maxEntries) : log_t(maxEntries) {}
+
+    void vLog(const char *fmt, va_list ap)
+    {
+        char buf[maxMessage];
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+
+        entry_t entry;
+        entry.upTime = esp_timer_get_time() / 1000000;
+        entry.clientIP = 0x0100A8C0;
+        entry.len = strlen(buf);
+        entry.clockTime[0] = '\0';
+        ring.append(entry, buf);
+    }
+
+    void add(const char *fmt, ...)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        vLog(fmt, ap);
+        va_end(ap);
+    }
+};
+
+// adds nAdd entries with the messages a bridge typically logs, and then reads the whole log newest first (as the
+// status page does) nRead times, once with each way of storing it
+
+TEST(WebLog, Benchmark)
+{
+    const uint32_t maxEntries = 50;
+    const int nAdd = 200000;
+    const int nRead = 2000;
+    const char *names[] = {"Living Room Light", "Garage Door", "Thermostat", "Front Door Lock"};
+
+    auto time = [](std::function<void()> run) {
+        auto t0 = std::chrono::steady_clock::now();
+        run();
+        return (std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count());
+    };
+
+    auto addAll = [&](auto &log) {
+        for (int i = 0; i < nAdd; i++) {
+            if (i % 8 == 7)
+                log.add("Poll Stall: %s blocked for %u ms while processing a long request", "HAP Requests", i % 100);
+            else
+                log.add("%s: value of Characteristic %d.%d updated to %d", names[i % 4], 2 + i % 4, 10 + i % 3, i);
+        }
+    };
+
+    oldLog_t oldLog(maxEntries);
+    newLog_t newLog(maxEntries);
+
+    size_t heapBefore = hostMemLive(HS_MEM_WEBLOG);
+    double oldAddNs = time([&]() { addAll(oldLog); });
+    size_t oldHeap = hostMemLive(HS_MEM_WEBLOG) - heapBefore;
+    double newAddNs = time([&]() { addAll(newLog); });
+
+    char msg[maxMessage];
+    size_t oldChars = 0, newChars = 0;
+
+    double oldReadNs = time([&]() {
+        for (int r = 0; r < nRead; r++) {
+            for (uint32_t i = 0; i < maxEntries; i++) {  // newest first
+                auto &entry = oldLog.log[(oldLog.nEntries - 1 - i) % maxEntries];
+                strncpy(msg, entry.message, sizeof(msg) - 1);
+                msg[sizeof(msg) - 1] = '\0';
+                oldChars += strlen(msg);
+            }
+        }
+    });
+
+    double newReadNs = time([&]() {
+        for (int r = 0; r < nRead; r++) {
+            uint32_t oldestSeq, newestSeq;
+            newLog.ring.getRange(oldestSeq, newestSeq);
+            ring_t::cursor_t cursor(newestSeq);
+            entry_t entry;
+            while (newLog.ring.read(cursor, entry, msg, sizeof(msg)))
+                newChars += entry.len;
+        }
+    });
+
+    EXPECT_EQ(newChars, oldChars);  // both hold the same last maxEntries messages
+    EXPECT_TRUE(newLog.guardsIntact());
+
+    printf("add entry    vasprintf+realloc %8.1f ns   LogRing %8.1f ns\n", oldAddNs / nAdd, newAddNs / nAdd);
+    printf("read entry   vasprintf+realloc %8.1f ns   LogRing %8.1f ns\n", oldReadNs / (nRead * maxEntries),
+           newReadNs / (nRead * maxEntries));
+    printf("messages     vasprintf+realloc %u blocks, %zu bytes, 1 malloc/free per add   LogRing 1 block, %u bytes\n",
+           maxEntries, oldHeap, newLog.size);
+}
@@ -0,0 +1,268 @@
+// Utils::WriteWindow, which times the write-coalescing window of a Service, and Utils::HeldWrites, which holds the
+// writes acknowledged while the window is open, replayed against a slider drag as the Home App sends it.  The
+// Service below makes the same calls into HeldWrites and WriteWindow that Span::updateCharacteristics() and
+// Span::checkWrites() make.
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "Utils.h"
+
+namespace {
+
+struct put_t
+{
+    uint32_t time;  // millis since start of drag
+    int value;      // Brightness sent in PUT /characteristics
+};
+
+// Brightness drag from 0 to 100 and back down to 75: PUTs arrive every 40-140 ms while the finger moves, the same
+// value is sometimes repeated, and the drag pauses for half a second in the middle
+
+const std::vector<put_t> sliderDrag = {
+    {0, 3},     {45, 9},    {92, 16},   {180, 24},  {230, 31},  {281, 39},  {330, 47},  {420, 55},  {465, 62},
+    {511, 70},  {600, 78},  {648, 85},  {690, 91},  {790, 96},  {830, 100}, {880, 100}, {1400, 97}, {1450, 92},
+    {1530, 88}, {1575, 84}, {1620, 81}, {1760, 78}, {1800, 76}, {1845, 75}, {1990, 75},
+};
+
+// Characteristic with the members HeldWrites uses, holding an int value, that counts the work done on its value
+
+struct chr_t
+{
+    int value = 0;              // current value
+    int newValue = 0;           // value passed to update()
+    int heldValue = 0;          // latest value written while window is open
+    boolean writeHeld = false;  // heldValue is waiting for update()
+    uint8_t updateFlag = 0;     // what updated() returns
+    int changes = 0;            // calls to markChanged()
+    int commits = 0;            // values committed - each one stored, marked as changed, and saved to NVS
+    int reverts = 0;            // failed writes reverted
+
+    void uvSet(int &dest, int &src) { dest = src; }
+    boolean uvEqual(int &a, int &b) { return (a == b); }
+    void markChanged() { changes++; }
+
+    void commitNewValue()  // as in SpanCharacteristic::commitNewValue()
+    {
+        value = newValue;
+        markChanged();
+        commits++;
+    }
+
+    void revertNewValue()  // as in SpanCharacteristic::revertNewValue()
+    {
+        newValue = value;
+        markChanged();
+        reverts++;
+    }
+
+    void setVal(int val)  // from the Service's own loop()
+    {
+        value = val;
+        newValue = val;
+    }
+
+    int reported() { return (writeHeld ? heldValue : value); }  // value reported by GET /characteristics
+};
+
+typedef Utils::HeldWrites<chr_t> writes_t;
+
+struct service_t
+{
+    Utils::WriteWindow writeWindow;
+    chr_t chr[2];                                 // Brightness and Hue
+    std::vector<chr_t *> items = {chr, chr + 1};  // as in SpanService::Characteristics
+    boolean fail = false;                         // update() returns false
+    std::vector<int> updates;                     // Brightness newValue seen by each call to update()
+    std::vector<boolean> loopUpdated;             // whether any Characteristic was updated() in each call to loop()
+
+    service_t(uint32_t window) { writeWindow.setLength(window); }
+
+    boolean update()
+    {
+        EXPECT_TRUE(chr[0].updateFlag || chr[1].updateFlag);
+        updates.push_back(chr[0].newValue);
+        return (!fail);
+    }
+
+    // PUT /characteristics writing each val[i] to chr[i], as in Span::updateCharacteristics()
+
+    void put(uint32_t now, std::vector<int> val, boolean writeResponse = false)
+    {
+        for (size_t i = 0; i < val.size(); i++) {
+            chr[i].newValue = val[i];
+            chr[i].updateFlag = writeResponse ? 2 : 1;
+        }
+
+        if (writeWindow.enabled() && !writeResponse) {
+            for (size_t i = 0; i < val.size(); i++)
+                writes_t::hold(&chr[i]);
+            writeWindow.hold(now);
+            return;
+        }
+
+        if (writeWindow.isPending())
+            writes_t::release(items);
+
+        boolean ok = update();
+        for (size_t i = 0; i < val.size(); i++) {
+            if (ok)
+                chr[i].commitNewValue();
+            else
+                chr[i].newValue = chr[i].value;
+            chr[i].updateFlag = 0;
+        }
+
+        if (writeWindow.isPending()) {
+            writes_t::finish(items, ok);
+            writeWindow.finish();
+        }
+    }
+
+    void put(uint32_t now, int brightness) { put(now, std::vector<int>{brightness}); }
+
+    void poll(uint32_t now)  // as in Span::checkWrites(), followed by the Service's loop()
+    {
+        if (writeWindow.due(now)) {
+            writes_t::release(items);
+            if (writes_t::changed(items))
+                writes_t::finish(items, update());
+            else
+                writes_t::discard(items);
+            writeWindow.finish();
+        }
+        loopUpdated.push_back(chr[0].updateFlag || chr[1].updateFlag);
+    }
+};
+
+// replays sliderDrag with one poll per millisecond, calling setVal(setValue) at time setTime if setTime is not 0
+
+void replay(service_t &svc, uint32_t setTime = 0, int setValue = 0)
+{
+    size_t next = 0;
+    for (uint32_t t = 0; t < 3000; t++) {
+        while (next < sliderDrag.size() && sliderDrag[next].time == t) {
+            svc.put(t, sliderDrag[next].value);
+            EXPECT_EQ(svc.chr[0].reported(), sliderDrag[next].value);  // acknowledged value is reported right away
+            next++;
+        }
+        if (setTime && t == setTime)
+            svc.chr[0].setVal(setValue);
+        svc.poll(t);
+    }
+}
+
+}  // namespace
+
+TEST(WriteWindow, WithoutWindowEveryWriteCallsUpdate)
+{
+    service_t svc(0);
+    replay(svc);
+    EXPECT_EQ(svc.updates.size(), sliderDrag.size());
+    EXPECT_EQ(svc.chr[0].value, 75);
+}
+
+TEST(WriteWindow, SliderDragIsCoalesced)
+{
+    for (uint32_t window : {100, 250, 500}) {
+        service_t svc(window);
+        replay(svc);
+
+        EXPECT_EQ(svc.chr[0].value, 75) << "window " << window;  // last write always wins
+        EXPECT_LT(svc.updates.size(), sliderDrag.size() / 2) << "window " << window;
+        for (size_t i = 1; i < svc.updates.size(); i++)
+            EXPECT_NE(svc.updates[i], svc.updates[i - 1]) << "update() called without a change";
+        printf("%3u ms window: %zu PUTs -> %zu calls to update()\n", window, sliderDrag.size(), svc.updates.size());
+    }
+}
+
+TEST(WriteWindow, UpdatedIsFalseOutsideUpdate)
+{
+    service_t svc(250);
+    replay(svc);
+    for (auto u : svc.loopUpdated)
+        ASSERT_FALSE(u);
+}
+
+TEST(WriteWindow, SetValDuringWindowDoesNotLoseAcknowledgedWrite)
+{
+    service_t svc(500);
+    replay(svc, 1900, 40);  // loop() sets Brightness while the final write (75 at 1845 ms) is held
+
+    EXPECT_EQ(svc.chr[0].value, 75);
+    EXPECT_EQ(svc.updates.back(), 75);
+}
+
+TEST(WriteWindow, UnchangedValuesAreNotCommitted)
+{
+    service_t svc(250);
+    svc.chr[0].setVal(50);
+
+    svc.put(0, 60);  // drag away and back again within the window
+    svc.put(100, 50);
+    for (uint32_t t = 0; t < 400; t++)
+        svc.poll(t);
+
+    EXPECT_TRUE(svc.updates.empty());  // update() is skipped...
+    EXPECT_EQ(svc.chr[0].commits, 0);  // ...and so is storing the value, marking it changed, and saving it to NVS
+    EXPECT_EQ(svc.chr[0].changes, 2);  // only the two held writes were reported as changes
+    EXPECT_EQ(svc.chr[0].reported(), 50);
+    EXPECT_EQ(svc.chr[0].updateFlag, 0);
+    EXPECT_FALSE(svc.writeWindow.isPending());
+}
+
+TEST(WriteWindow, FailedUpdateRevertsHeldWrites)
+{
+    service_t svc(250);
+    svc.chr[0].setVal(20);
+    svc.fail = true;
+
+    svc.put(0, 60);
+    EXPECT_EQ(svc.chr[0].reported(), 60);  // acknowledged while held
+    for (uint32_t t = 0; t < 400; t++)
+        svc.poll(t);
+
+    ASSERT_EQ(svc.updates.size(), 1u);
+    EXPECT_EQ(svc.updates[0], 60);
+    EXPECT_EQ(svc.chr[0].reverts, 1);
+    EXPECT_EQ(svc.chr[0].commits, 0);
+    EXPECT_EQ(svc.chr[0].reported(), 20);
+    EXPECT_EQ(svc.chr[0].newValue, 20);
+}
+
+TEST(WriteWindow, WriteResponseReleasesHeldWritesWithoutOverwritingNewerOnes)
+{
+    service_t svc(500);
+
+    svc.put(0, {30, 10});      // Brightness and Hue held
+    svc.put(100, {40});        // Brightness held again
+    svc.put(200, {80}, true);  // write-response needs update() right away, with the held Hue and the newer Brightness
+
+    ASSERT_EQ(svc.updates.size(), 1u);
+    EXPECT_EQ(svc.updates[0], 80);
+    EXPECT_EQ(svc.chr[0].value, 80);
+    EXPECT_EQ(svc.chr[1].value, 10);
+    EXPECT_EQ(svc.chr[0].commits, 1);
+    EXPECT_EQ(svc.chr[1].commits, 1);  // committed by finish()
+    EXPECT_FALSE(svc.chr[0].writeHeld || svc.chr[1].writeHeld);
+    EXPECT_FALSE(svc.writeWindow.isPending());
+
+    for (uint32_t t = 200; t < 1000; t++)  // nothing left for the window to update
+        svc.poll(t);
+    EXPECT_EQ(svc.updates.size(), 1u);
+}
+
+TEST(WriteWindow, ClosesAcrossMillisWrap)
+{
+    Utils::WriteWindow w;
+    w.setLength(300);
+
+    uint32_t start = UINT32_MAX - 100;
+    EXPECT_TRUE(w.hold(start));
+    EXPECT_FALSE(w.hold(start + 50));  // later writes do not extend the window
+    EXPECT_FALSE(w.due(start + 299));
+    EXPECT_TRUE(w.due(start + 300));
+    w.finish();
+    EXPECT_FALSE(w.isPending());
+    EXPECT_FALSE(w.due(start + 1000));
+}